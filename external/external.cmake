@@ -42,4 +42,5 @@ find_package(SPIRV-Tools CONFIG REQUIRED)
 #####################
 if(NOVA_TEST)
 	find_package(GTest MODULE REQUIRED)
+	find_package(benchmark CONFIG REQUIRED)
 endif()
\ No newline at end of file
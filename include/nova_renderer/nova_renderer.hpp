@@ -2,11 +2,16 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "nova_settings.hpp"
 #include "render_engine.hpp"
 #include "renderdoc_app.h"
 
+namespace nova::ttl {
+    class task_scheduler;
+} // namespace nova::ttl
+
 namespace nova::renderer {
     NOVA_EXCEPTION(already_initialized_exception);
     NOVA_EXCEPTION(uninitialized_exception);
@@ -50,6 +55,8 @@ namespace nova::renderer {
 
         [[nodiscard]] render_engine* get_engine() const;
 
+        [[nodiscard]] ttl::task_scheduler* get_task_scheduler() const;
+
         static nova_renderer* initialize(const nova_settings& settings);
 
         static nova_renderer* get_instance();
@@ -58,9 +65,19 @@ namespace nova::renderer {
 
     private:
         nova_settings render_settings;
+        std::unique_ptr<ttl::task_scheduler> task_scheduler;
         std::unique_ptr<render_engine> engine;
 
         RENDERDOC_API_1_3_0* render_doc;
+
+        /*!
+         * \brief The names of the per-worker busy time counters in the trace
+         *
+         * minitrace keeps a pointer to the name of each event rather than a copy, so they have to live as long as the
+         * trace does
+         */
+        std::vector<std::string> worker_busy_counter_names;
+
         static std::unique_ptr<nova_renderer> instance;
     };
 } // namespace nova::renderer
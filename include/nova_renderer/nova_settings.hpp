@@ -83,6 +83,14 @@ namespace nova::renderer {
              * Nova gives meshes one or more allocations from a given buffer.
              */
             uint32_t buffer_part_size = 16 * 1024;
+
+            /*!
+             * \brief The most bytes of data that Nova moves each frame to defragment these buffers
+             *
+             * Bigger numbers reclaim fragmented memory faster, but make each frame's transfer take longer. 0 turns
+             * defragmentation off
+             */
+            uint32_t defragmentation_budget = 1024 * 1024;
         };
 
         /*!
@@ -176,6 +184,19 @@ namespace nova::renderer {
         struct dx12_options {
         } dx12;
 
+        /*!
+         * \brief Options for the task scheduler that runs Nova's work
+         */
+        struct task_options {
+            /*!
+             * \brief If true, each worker thread is pinned to its own CPU, and workers steal work from the CPUs that
+             * share their caches before the ones that don't
+             *
+             * This helps on machines with several sockets or last-level caches. Only supported on Linux
+             */
+            bool pin_workers_to_cores = false;
+        } tasks;
+
         /*!
          * \brief The rendering API to use
          *
@@ -195,6 +216,26 @@ namespace nova::renderer {
          */
         block_allocator_settings index_memory_settings;
 
+        /*!
+         * \brief The size of the buffer that Nova copies all mesh data through on its way to the GPU, in bytes
+         *
+         * Uploads wait for earlier uploads to finish when this buffer is full, so a bigger buffer lets more uploads be in
+         * flight at once. An upload that's bigger than this gets its own staging buffer
+         */
+        uint32_t staging_buffer_size = 64 * 1024 * 1024;
+
+        /*!
+         * \brief The most GPU memory that Nova should use, in bytes. 0 means there's no limit beyond what the driver
+         * reports
+         *
+         * When Nova goes over its budget, it evicts the meshes that it drew least recently and uploads them again when
+         * they're visible. If the driver supports VK_EXT_memory_budget, Nova also stays under the budget that it reports
+         *
+         * Meshes can only be evicted if Nova keeps a copy of their data in CPU memory, so it only keeps copies when
+         * there's a budget
+         */
+        uint64_t gpu_memory_budget = 0;
+
         /*!
          * \brief Registers the given iconfig_change_listener as an Observer
          */
@@ -84,11 +84,22 @@ namespace nova::renderer {
          * The provided mesh data is uploaded to the GPU. The mesh's identifier is returned to you. This is all you
          * need for the operations that a Nova render engine supports
          *
+         * The upload happens in the background: this method returns as soon as the mesh data has been copied out of
+         * `mesh`. Renderables that use the mesh aren't drawn until the upload is done - see `is_mesh_ready`
+         *
          * \param mesh The mesh data to send to the GPU
          * \return The ID of the mesh that was just created
          */
         virtual result<mesh_id_t> add_mesh(const mesh_data& mesh) = 0;
 
+        /*!
+         * \brief Checks if the mesh with the provided ID has finished uploading, so that renderables which use it get drawn
+         *
+         * \param mesh_id The ID of the mesh to check
+         * \return True if the mesh is on the GPU, false if it's still being uploaded or doesn't exist
+         */
+        virtual bool is_mesh_ready(mesh_id_t mesh_id) = 0;
+
         /*!
          * \brief Deletes the mesh with the provided ID from the GPU
          *
@@ -1,5 +1,6 @@
 #include "render_graph_builder.hpp"
 
+#include <algorithm>
 #include <unordered_set>
 
 #include <minitrace/minitrace.h>
@@ -197,15 +198,11 @@ namespace nova::renderer {
                                            std::vector<std::string>& resources_in_order) {
         uint32_t pass_idx = 0;
         for(const auto& pass : passes) {
-            // color attachments
             for(const auto& input : pass.texture_inputs) {
                 auto& tex_range = resource_used_range[input];
 
-                if(pass_idx < tex_range.first_write_pass) {
-                    tex_range.first_write_pass = pass_idx;
-                } else if(pass_idx > tex_range.last_write_pass) {
-                    tex_range.last_write_pass = pass_idx;
-                }
+                tex_range.first_read_pass = std::min(tex_range.first_read_pass, pass_idx);
+                tex_range.last_read_pass = std::max(tex_range.last_read_pass, pass_idx);
 
                 if(std::find(resources_in_order.begin(), resources_in_order.end(), input) == resources_in_order.end()) {
                     resources_in_order.push_back(input);
@@ -216,11 +213,8 @@ namespace nova::renderer {
                 for(const auto& output : pass.texture_outputs) {
                     auto& tex_range = resource_used_range[output.name];
 
-                    if(pass_idx < tex_range.first_write_pass) {
-                        tex_range.first_write_pass = pass_idx;
-                    } else if(pass_idx > tex_range.last_write_pass) {
-                        tex_range.last_write_pass = pass_idx;
-                    }
+                    tex_range.first_write_pass = std::min(tex_range.first_write_pass, pass_idx);
+                    tex_range.last_write_pass = std::max(tex_range.last_write_pass, pass_idx);
 
                     if(std::find(resources_in_order.begin(), resources_in_order.end(), output.name) == resources_in_order.end()) {
                         resources_in_order.push_back(output.name);
@@ -228,6 +222,18 @@ namespace nova::renderer {
                 }
             }
 
+            // Depth tests read the depth texture as well, but a pass always writes it before anything reads it
+            if(pass.depth_texture) {
+                auto& tex_range = resource_used_range[pass.depth_texture->name];
+
+                tex_range.first_write_pass = std::min(tex_range.first_write_pass, pass_idx);
+                tex_range.last_write_pass = std::max(tex_range.last_write_pass, pass_idx);
+
+                if(std::find(resources_in_order.begin(), resources_in_order.end(), pass.depth_texture->name) == resources_in_order.end()) {
+                    resources_in_order.push_back(pass.depth_texture->name);
+                }
+            }
+
             pass_idx++;
         }
     }
@@ -239,28 +245,48 @@ namespace nova::renderer {
         std::unordered_map<std::string, std::string> aliases;
         aliases.reserve(resources_in_order.size());
 
-        for(size_t i = 0; i < resources_in_order.size(); i++) {
-            const auto& to_alias_name = resources_in_order[i];
-            NOVA_LOG(TRACE) << "Determining if we can alias `" << to_alias_name << "`. Does it exist? "
-                            << (textures.find(to_alias_name) != textures.end());
+        // Textures that aren't aliased to anything, in usage order, and every texture that shares each one's memory
+        std::vector<std::string> alias_roots;
+        std::unordered_map<std::string, std::vector<std::string>> alias_groups;
+
+        for(const std::string& to_alias_name : resources_in_order) {
             if(to_alias_name == "Backbuffer" || to_alias_name == "backbuffer") {
                 // Yay special cases!
                 continue;
             }
 
-            const auto& to_alias_format = textures.at(to_alias_name).format;
-
-            // Only try to alias with lower-indexed resources
-            for(size_t j = 0; j < i; j++) {
-                NOVA_LOG(TRACE) << "Trying to alias it with resource at index " << j << " out of " << resources_in_order.size();
-                const std::string& try_alias_name = resources_in_order[j];
-                if(resource_used_range.at(to_alias_name).is_disjoint_with(resource_used_range.at(try_alias_name))) {
-                    // They can be aliased if they have the same format
-                    const auto& try_alias_format = textures.at(try_alias_name).format;
-                    if(to_alias_format == try_alias_format) {
-                        aliases[to_alias_name] = try_alias_name;
-                    }
+            // Only dynamic textures can be aliased
+            const auto to_alias_itr = textures.find(to_alias_name);
+            if(to_alias_itr == textures.end()) {
+                continue;
+            }
+
+            const range& to_alias_range = resource_used_range.at(to_alias_name);
+
+            // Every texture that already shares some memory has to be done with it before this texture can use it
+            bool was_aliased = false;
+            for(const std::string& root_name : alias_roots) {
+                if(textures.at(root_name).format != to_alias_itr->second.format) {
+                    continue;
                 }
+
+                std::vector<std::string>& group = alias_groups.at(root_name);
+                const bool is_disjoint_with_group = std::all_of(group.begin(), group.end(), [&](const std::string& member_name) {
+                    return to_alias_range.is_disjoint_with(resource_used_range.at(member_name));
+                });
+
+                if(is_disjoint_with_group) {
+                    NOVA_LOG(TRACE) << "Aliasing `" << to_alias_name << "` with `" << root_name << "`";
+                    aliases[to_alias_name] = root_name;
+                    group.push_back(to_alias_name);
+                    was_aliased = true;
+                    break;
+                }
+            }
+
+            if(!was_aliased) {
+                alias_roots.push_back(to_alias_name);
+                alias_groups[to_alias_name] = {to_alias_name};
             }
         }
 
@@ -58,7 +58,11 @@ namespace nova::renderer {
      * \param resource_used_range The range of passes where each texture is used
      * \param resources_in_order The dynamic textures in usage order
      *
-     * \return A map from texture name to the name of the texture the first texture can be aliased with
+     * A texture can share memory with a group of other textures if it has the same format as them and its usage range
+     * is disjoint with all of theirs
+     *
+     * \return A map from texture name to the name of the texture whose memory it can share. Textures that keep their own
+     * memory aren't in the map, so following an alias never leads to another alias
      */
     std::unordered_map<std::string, std::string> determine_aliasing_of_textures(
         const std::unordered_map<std::string, texture_resource_data>& textures,
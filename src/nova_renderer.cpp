@@ -1,7 +1,10 @@
 #include "nova_renderer/nova_renderer.hpp"
 
+#include <algorithm>
 #include <array>
+#include <chrono>
 #include <future>
+#include <thread>
 
 #include <glslang/MachineIndependent/Initialize.h>
 #include <minitrace/minitrace.h>
@@ -12,6 +15,7 @@
 #endif
 #include "debugging/renderdoc.hpp"
 #include "render_engine/vulkan/vulkan_render_engine.hpp"
+#include "tasks/task_scheduler.hpp"
 #include "util/logger.hpp"
 
 namespace nova::renderer {
@@ -26,6 +30,19 @@ namespace nova::renderer {
 
         MTR_SCOPE("Init", "nova_renderer::nova_renderer");
 
+        {
+            MTR_SCOPE("Init", "InitTaskScheduler");
+            const uint32_t num_threads = std::max(std::thread::hardware_concurrency(), 1U);
+            const ttl::worker_placement placement = settings.tasks.pin_workers_to_cores ? ttl::worker_placement::PIN_TO_CORES :
+                                                                                            ttl::worker_placement::UNPINNED;
+            task_scheduler = std::make_unique<ttl::task_scheduler>(num_threads, ttl::empty_queue_behavior::SLEEP, placement);
+
+            worker_busy_counter_names.reserve(num_threads);
+            for(uint32_t i = 0; i < num_threads; i++) {
+                worker_busy_counter_names.emplace_back("worker_" + std::to_string(i) + "_busy_ms");
+            }
+        }
+
         if(settings.debug.renderdoc.enabled) {
             MTR_SCOPE("Init", "LoadRenderdoc");
             auto rd_load_result = load_renderdoc(settings.debug.renderdoc.renderdoc_dll_path);
@@ -65,7 +82,7 @@ namespace nova::renderer {
 #endif
             case graphics_api::vulkan:
                 MTR_SCOPE("Init", "InitVulkanRenderEngine");
-                engine = std::make_unique<vulkan_render_engine>(render_settings, render_doc);
+                engine = std::make_unique<vulkan_render_engine>(render_settings, task_scheduler.get(), render_doc);
         }
     }
 
@@ -75,6 +92,36 @@ namespace nova::renderer {
 
     void nova_renderer::execute_frame() const {
         MTR_SCOPE("RenderLoop", "execute_frame");
+
+        // Queue depth per lane, so that background work flooding the pool shows up next to the frames it slows down
+        MTR_COUNTER("Tasks", "frame_critical_queue_depth", task_scheduler->get_queue_depth(ttl::task_priority::FRAME_CRITICAL));
+        MTR_COUNTER("Tasks", "normal_queue_depth", task_scheduler->get_queue_depth(ttl::task_priority::NORMAL));
+        MTR_COUNTER("Tasks", "background_queue_depth", task_scheduler->get_queue_depth(ttl::task_priority::BACKGROUND));
+
+        // The worker counters only ever go up, so the trace shows how fast they climbed from one frame to the next
+        const std::vector<ttl::worker_stats> worker_stats = task_scheduler->get_worker_stats();
+        ttl::worker_stats pool_stats;
+        for(std::size_t i = 0; i < worker_stats.size(); i++) {
+            const ttl::worker_stats& worker = worker_stats[i];
+            pool_stats.tasks_executed += worker.tasks_executed;
+            pool_stats.pops += worker.pops;
+            pool_stats.external_pops += worker.external_pops;
+            pool_stats.steal_attempts += worker.steal_attempts;
+            pool_stats.steals += worker.steals;
+            pool_stats.idle_time += worker.idle_time;
+            pool_stats.max_queue_depth = std::max(pool_stats.max_queue_depth, worker.max_queue_depth);
+
+            const auto busy_ms = std::chrono::duration_cast<std::chrono::milliseconds>(worker.busy_time);
+            MTR_COUNTER("Tasks", worker_busy_counter_names[i].c_str(), busy_ms.count());
+        }
+
+        MTR_COUNTER("Tasks", "tasks_executed", pool_stats.tasks_executed);
+        MTR_COUNTER("Tasks", "pops", pool_stats.pops + pool_stats.external_pops);
+        MTR_COUNTER("Tasks", "steal_attempts", pool_stats.steal_attempts);
+        MTR_COUNTER("Tasks", "steals", pool_stats.steals);
+        MTR_COUNTER("Tasks", "idle_ms", std::chrono::duration_cast<std::chrono::milliseconds>(pool_stats.idle_time).count());
+        MTR_COUNTER("Tasks", "max_queue_depth", pool_stats.max_queue_depth);
+
         engine->render_frame();
 
         mtr_flush();
@@ -92,6 +139,8 @@ namespace nova::renderer {
 
     render_engine* nova_renderer::get_engine() const { return engine.get(); }
 
+    ttl::task_scheduler* nova_renderer::get_task_scheduler() const { return task_scheduler.get(); }
+
     nova_renderer* nova_renderer::get_instance() { return instance.get(); }
 
     nova_renderer* nova_renderer::initialize(const nova_settings& settings) {
@@ -0,0 +1,88 @@
+#include "best_fit_allocator.hpp"
+
+#include <cassert>
+#include <iterator>
+
+namespace nova::renderer {
+    best_fit_allocator::best_fit_allocator(const uint64_t size, const uint64_t granularity)
+        : size(size), granularity(granularity), free_size(0) {
+        assert(granularity > 0);
+
+        if(size > 0) {
+            add_free_range(0, size);
+        }
+    }
+
+    std::optional<best_fit_allocator::range> best_fit_allocator::allocate(const uint64_t size) {
+        const uint64_t rounded_size = (size == 0 ? 1 : (size + granularity - 1) / granularity) * granularity;
+
+        const auto best_fit = free_by_size.lower_bound({rounded_size, 0});
+        if(best_fit == free_by_size.end()) {
+            return {};
+        }
+
+        const auto [range_size, offset] = *best_fit;
+        remove_free_range(free_by_offset.find(offset));
+
+        // Allocate from the start of the range, and give back what's left
+        if(range_size > rounded_size) {
+            add_free_range(offset + rounded_size, range_size - rounded_size);
+        }
+
+        return range{offset, rounded_size};
+    }
+
+    void best_fit_allocator::free(const range& allocation) {
+        uint64_t offset = allocation.offset;
+        uint64_t range_size = allocation.size;
+
+        auto next = free_by_offset.lower_bound(offset);
+        assert(next == free_by_offset.end() || offset + range_size <= next->first);
+
+        if(next != free_by_offset.begin()) {
+            const auto previous = std::prev(next);
+            assert(previous->first + previous->second <= offset);
+
+            if(previous->first + previous->second == offset) {
+                offset = previous->first;
+                range_size += previous->second;
+                remove_free_range(previous);
+            }
+        }
+
+        if(next != free_by_offset.end() && next->first == offset + range_size) {
+            range_size += next->second;
+            remove_free_range(next);
+        }
+
+        add_free_range(offset, range_size);
+    }
+
+    uint64_t best_fit_allocator::get_size() const { return size; }
+
+    uint64_t best_fit_allocator::get_free_size() const { return free_size; }
+
+    uint64_t best_fit_allocator::get_largest_free_range() const { return free_by_size.empty() ? 0 : free_by_size.rbegin()->first; }
+
+    float best_fit_allocator::get_fragmentation() const {
+        if(free_size == 0) {
+            return 0;
+        }
+
+        return 1.0f - static_cast<float>(get_largest_free_range()) / static_cast<float>(free_size);
+    }
+
+    std::size_t best_fit_allocator::get_num_free_ranges() const { return free_by_offset.size(); }
+
+    void best_fit_allocator::add_free_range(const uint64_t offset, const uint64_t range_size) {
+        free_by_offset.emplace(offset, range_size);
+        free_by_size.emplace(range_size, offset);
+        free_size += range_size;
+    }
+
+    void best_fit_allocator::remove_free_range(const std::map<uint64_t, uint64_t>::iterator itr) {
+        free_by_size.erase({itr->second, itr->first});
+        free_size -= itr->second;
+        free_by_offset.erase(itr);
+    }
+} // namespace nova::renderer
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <set>
+#include <utility>
+
+namespace nova::renderer {
+    /*!
+     * \brief Allocates ranges of a linear address space, always from the smallest free range that fits
+     *
+     * Free ranges are indexed twice: by size, to find the best fit in O(log n), and by offset, to find a freed range's
+     * neighbours in O(log n) so it can be merged with them right away. Free ranges are therefore never adjacent to each
+     * other
+     */
+    class best_fit_allocator {
+    public:
+        struct range {
+            uint64_t offset = 0;
+            uint64_t size = 0;
+        };
+
+        /*!
+         * \param size The size of the address space to allocate from
+         * \param granularity Every allocation's size is rounded up to a multiple of this, so every allocation's offset is
+         * a multiple of it as well
+         */
+        explicit best_fit_allocator(uint64_t size, uint64_t granularity = 1);
+
+        /*!
+         * \brief Allocates at least `size` bytes from the smallest free range they fit in
+         *
+         * \return The allocated range, with its size rounded up to the granularity, or an empty optional if no free
+         * range is big enough
+         */
+        [[nodiscard]] std::optional<range> allocate(uint64_t size);
+
+        /*!
+         * \brief Frees a range returned by `allocate`, merging it with any free neighbours
+         */
+        void free(const range& allocation);
+
+        [[nodiscard]] uint64_t get_size() const;
+
+        [[nodiscard]] uint64_t get_free_size() const;
+
+        /*!
+         * \brief Gets the size of the biggest allocation that would succeed right now
+         */
+        [[nodiscard]] uint64_t get_largest_free_range() const;
+
+        /*!
+         * \brief Gets how fragmented the free space is
+         *
+         * \return 0 if all the free space is in one range, approaching 1 as it's split into more and more smaller ranges.
+         * Computed as `1 - largest free range / total free space`
+         */
+        [[nodiscard]] float get_fragmentation() const;
+
+        [[nodiscard]] std::size_t get_num_free_ranges() const;
+
+    private:
+        uint64_t size;
+        uint64_t granularity;
+        uint64_t free_size;
+
+        /*!
+         * \brief Size of each free range, keyed by its offset
+         */
+        std::map<uint64_t, uint64_t> free_by_offset;
+
+        /*!
+         * \brief (size, offset) of each free range, so that the first entry that's at least as big as an allocation is
+         * the best fit
+         */
+        std::set<std::pair<uint64_t, uint64_t>> free_by_size;
+
+        void add_free_range(uint64_t offset, uint64_t range_size);
+
+        void remove_free_range(std::map<uint64_t, uint64_t>::iterator itr);
+    };
+} // namespace nova::renderer
@@ -0,0 +1,28 @@
+#include "bump_allocator.hpp"
+
+#include <cassert>
+
+namespace nova::renderer {
+    bump_allocator::bump_allocator(const uint64_t size) : size(size) {}
+
+    std::optional<uint64_t> bump_allocator::allocate(const uint64_t size, const uint64_t alignment) {
+        assert(alignment > 0);
+
+        uint64_t old_offset = offset.load(std::memory_order_relaxed);
+        uint64_t aligned_offset;
+        do {
+            aligned_offset = (old_offset + alignment - 1) / alignment * alignment;
+            if(aligned_offset > this->size || size > this->size - aligned_offset) {
+                return {};
+            }
+        } while(!offset.compare_exchange_weak(old_offset, aligned_offset + size, std::memory_order_relaxed));
+
+        return aligned_offset;
+    }
+
+    void bump_allocator::reset() { offset.store(0, std::memory_order_relaxed); }
+
+    uint64_t bump_allocator::get_size() const { return size; }
+
+    uint64_t bump_allocator::get_used_size() const { return offset.load(std::memory_order_relaxed); }
+} // namespace nova::renderer
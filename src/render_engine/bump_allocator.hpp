@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <optional>
+
+namespace nova::renderer {
+    /*!
+     * \brief Hands out ranges of a linear address space by bumping an offset forward, until it's reset all at once
+     *
+     * Allocating is a single compare-and-swap on the offset, so any number of threads can allocate at once without
+     * locks. There's no way to free one allocation: reset the whole allocator when everything allocated from it is
+     * dead, such as when the frame that used it has finished
+     */
+    class bump_allocator {
+    public:
+        explicit bump_allocator(uint64_t size);
+
+        bump_allocator(bump_allocator&& other) noexcept = delete;
+        bump_allocator& operator=(bump_allocator&& other) noexcept = delete;
+
+        bump_allocator(const bump_allocator& other) = delete;
+        bump_allocator& operator=(const bump_allocator& other) = delete;
+
+        ~bump_allocator() = default;
+
+        /*!
+         * \brief Allocates `size` bytes, starting at a multiple of `alignment`
+         *
+         * \return The offset of the allocation, or an empty optional if there isn't enough space left
+         */
+        [[nodiscard]] std::optional<uint64_t> allocate(uint64_t size, uint64_t alignment = 1);
+
+        /*!
+         * \brief Makes all the space available again
+         *
+         * Not thread-safe with `allocate`: make sure nothing is allocating when you call it
+         */
+        void reset();
+
+        [[nodiscard]] uint64_t get_size() const;
+
+        /*!
+         * \brief Gets the number of bytes allocated since the last reset, including padding for alignment
+         */
+        [[nodiscard]] uint64_t get_used_size() const;
+
+    private:
+        uint64_t size;
+
+        std::atomic<uint64_t> offset = 0;
+    };
+} // namespace nova::renderer
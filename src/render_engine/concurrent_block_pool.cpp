@@ -0,0 +1,125 @@
+#include "concurrent_block_pool.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+#include "../tasks/task_scheduler.hpp"
+
+namespace nova::renderer {
+    namespace {
+        uint64_t make_head(const concurrent_block_pool::block_index block, const uint32_t tag) {
+            return (static_cast<uint64_t>(tag) << 32) | block;
+        }
+
+        concurrent_block_pool::block_index get_block(const uint64_t head) {
+            return static_cast<concurrent_block_pool::block_index>(head & 0xFFFFFFFF);
+        }
+
+        uint32_t get_tag(const uint64_t head) { return static_cast<uint32_t>(head >> 32); }
+    } // namespace
+
+    concurrent_block_pool::concurrent_block_pool(const uint32_t num_blocks, ttl::task_scheduler* scheduler)
+        : num_blocks(num_blocks),
+          scheduler(scheduler),
+          next_free(std::make_unique<std::atomic<block_index>[]>(num_blocks)),
+          head(make_head(num_blocks > 0 ? 0 : NO_BLOCK, 0)),
+          magazines(scheduler->get_num_threads() + std::size_t{1}) {
+        assert(num_blocks < NO_BLOCK);
+
+        for(uint32_t i = 0; i < num_blocks; i++) {
+            next_free[i].store(i + 1 < num_blocks ? i + 1 : NO_BLOCK, std::memory_order_relaxed);
+        }
+    }
+
+    std::optional<concurrent_block_pool::block_index> concurrent_block_pool::allocate() {
+        magazine& mag = magazines[scheduler->get_current_thread_idx()];
+        if(mag.count == 0) {
+            mag.count = pop(MAGAZINE_SIZE / 2, mag.blocks.data());
+            if(mag.count == 0) {
+                return {};
+            }
+        }
+
+        mag.count--;
+        return mag.blocks[mag.count];
+    }
+
+    uint32_t concurrent_block_pool::allocate(const uint32_t count, block_index* blocks) {
+        magazine& mag = magazines[scheduler->get_current_thread_idx()];
+
+        const uint32_t from_magazine = std::min(count, mag.count);
+        mag.count -= from_magazine;
+        std::copy_n(mag.blocks.begin() + mag.count, from_magazine, blocks);
+
+        uint32_t num_allocated = from_magazine;
+        while(num_allocated < count) {
+            const uint32_t num_popped = pop(count - num_allocated, blocks + num_allocated);
+            if(num_popped == 0) {
+                break;
+            }
+            num_allocated += num_popped;
+        }
+
+        return num_allocated;
+    }
+
+    void concurrent_block_pool::free(const block_index block) {
+        assert(block < num_blocks);
+
+        magazine& mag = magazines[scheduler->get_current_thread_idx()];
+        if(mag.count == MAGAZINE_SIZE) {
+            // Keep half, so that alternating frees and allocations don't hit the stack every time
+            push_all(mag.blocks.data() + MAGAZINE_SIZE / 2, MAGAZINE_SIZE / 2);
+            mag.count = MAGAZINE_SIZE / 2;
+        }
+
+        mag.blocks[mag.count] = block;
+        mag.count++;
+    }
+
+    void concurrent_block_pool::free(const block_index* blocks, const uint32_t count) { push_all(blocks, count); }
+
+    uint32_t concurrent_block_pool::get_num_blocks() const { return num_blocks; }
+
+    void concurrent_block_pool::push(const block_index first, const block_index last) {
+        uint64_t old_head = head.load(std::memory_order_relaxed);
+        uint64_t new_head;
+        do {
+            next_free[last].store(get_block(old_head), std::memory_order_relaxed);
+            new_head = make_head(first, get_tag(old_head) + 1);
+        } while(!head.compare_exchange_weak(old_head, new_head, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    uint32_t concurrent_block_pool::pop(const uint32_t count, block_index* blocks) {
+        uint64_t old_head = head.load(std::memory_order_acquire);
+        while(true) {
+            // Walk down the stack. Another thread may change it while we walk, but every change bumps the tag, so the
+            // compare-and-swap below fails and we try again if anything we read is stale
+            block_index block = get_block(old_head);
+            uint32_t num_popped = 0;
+            while(block != NO_BLOCK && num_popped < count) {
+                blocks[num_popped] = block;
+                num_popped++;
+                block = next_free[block].load(std::memory_order_relaxed);
+            }
+
+            const uint64_t new_head = make_head(block, get_tag(old_head) + 1);
+            if(num_popped == 0 || head.compare_exchange_weak(old_head, new_head, std::memory_order_acquire, std::memory_order_acquire)) {
+                return num_popped;
+            }
+        }
+    }
+
+    void concurrent_block_pool::push_all(const block_index* blocks, const uint32_t count) {
+        if(count == 0) {
+            return;
+        }
+
+        for(uint32_t i = 0; i + 1 < count; i++) {
+            assert(blocks[i] < num_blocks);
+            next_free[blocks[i]].store(blocks[i + 1], std::memory_order_relaxed);
+        }
+
+        push(blocks[0], blocks[count - 1]);
+    }
+} // namespace nova::renderer
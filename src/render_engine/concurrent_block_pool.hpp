@@ -0,0 +1,128 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+namespace nova::ttl {
+    class task_scheduler;
+} // namespace nova::ttl
+
+namespace nova::renderer {
+    /*!
+     * \brief Hands out a fixed number of equally sized blocks, from any number of threads at once, without locks
+     *
+     * Free blocks live on a lock-free stack. Its head is tagged with a counter that changes on every push and pop, so a
+     * thread can't mistake a head that was popped and pushed back for one that never changed. In front of the stack,
+     * each thread keeps a small magazine of blocks that only it touches. Most allocations and frees only touch the
+     * calling thread's magazine; the stack is only used to refill or drain a magazine half a magazine at a time
+     *
+     * Threads are told apart with `ttl::task_scheduler::get_current_thread_idx`, so call this from the scheduler's
+     * workers or from the one outside thread that drives Nova
+     *
+     * Since blocks may sit in other threads' magazines, an allocation can fail while up to
+     * `MAGAZINE_SIZE * (num_threads + 1)` blocks are free
+     */
+    class concurrent_block_pool {
+    public:
+        using block_index = uint32_t;
+
+        /*!
+         * \brief The number of blocks that one thread keeps to itself
+         */
+        static constexpr uint32_t MAGAZINE_SIZE = 32;
+
+        /*!
+         * \param num_blocks The number of blocks to hand out. Blocks are numbered from 0 to `num_blocks - 1`
+         * \param scheduler The scheduler whose threads use this pool
+         */
+        concurrent_block_pool(uint32_t num_blocks, ttl::task_scheduler* scheduler);
+
+        concurrent_block_pool(concurrent_block_pool&& other) noexcept = delete;
+        concurrent_block_pool& operator=(concurrent_block_pool&& other) noexcept = delete;
+
+        concurrent_block_pool(const concurrent_block_pool& other) = delete;
+        concurrent_block_pool& operator=(const concurrent_block_pool& other) = delete;
+
+        ~concurrent_block_pool() = default;
+
+        /*!
+         * \brief Allocates one block
+         *
+         * \return The block, or an empty optional if no free block could be found
+         */
+        [[nodiscard]] std::optional<block_index> allocate();
+
+        /*!
+         * \brief Allocates up to `count` blocks at once
+         *
+         * \param count The number of blocks to allocate
+         * \param blocks Where to write the allocated blocks. Must have room for `count` blocks
+         * \return The number of blocks that were allocated. Less than `count` if the pool ran out
+         */
+        uint32_t allocate(uint32_t count, block_index* blocks);
+
+        /*!
+         * \brief Frees a block, so that it can be allocated again
+         */
+        void free(block_index block);
+
+        /*!
+         * \brief Frees `count` blocks at once
+         *
+         * The blocks go straight back to the shared stack, with one atomic operation for all of them
+         */
+        void free(const block_index* blocks, uint32_t count);
+
+        [[nodiscard]] uint32_t get_num_blocks() const;
+
+    private:
+        static constexpr block_index NO_BLOCK = UINT32_MAX;
+
+        /*!
+         * \brief Blocks that only one thread allocates from and frees to. Each one has its own cache line, so that
+         * threads don't fight over them
+         */
+        struct alignas(64) magazine {
+            uint32_t count = 0;
+            std::array<block_index, MAGAZINE_SIZE> blocks{};
+        };
+
+        uint32_t num_blocks;
+
+        ttl::task_scheduler* scheduler;
+
+        /*!
+         * \brief The block after each free block on the stack
+         */
+        std::unique_ptr<std::atomic<block_index>[]> next_free;
+
+        /*!
+         * \brief The top of the free stack in the low 32 bits, and a tag that changes every time the stack does in the
+         * high 32 bits
+         */
+        alignas(64) std::atomic<uint64_t> head;
+
+        std::vector<magazine> magazines;
+
+        /*!
+         * \brief Pushes a chain of blocks, linked with `next_free`, onto the free stack
+         */
+        void push(block_index first, block_index last);
+
+        /*!
+         * \brief Pops up to `count` blocks off the free stack with a single compare-and-swap
+         *
+         * \return The number of blocks popped
+         */
+        uint32_t pop(uint32_t count, block_index* blocks);
+
+        /*!
+         * \brief Links the blocks together with `next_free` in the order they're given, then pushes them
+         */
+        void push_all(const block_index* blocks, uint32_t count);
+    };
+} // namespace nova::renderer
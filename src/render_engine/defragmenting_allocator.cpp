@@ -0,0 +1,177 @@
+#include "defragmenting_allocator.hpp"
+
+#include <algorithm>
+
+#include "../util/logger.hpp"
+
+namespace nova::renderer {
+    defragmenting_allocator::defragmenting_allocator(const uint64_t size, const uint64_t granularity, const uint32_t max_in_flight_frames)
+        : blocks(size, granularity), granularity(granularity), max_in_flight_frames(max_in_flight_frames) {}
+
+    bool defragmenting_allocator::allocate(const uint64_t size, allocation* alloc) {
+        const std::optional<tlsf_allocator::allocation> block = blocks.allocate(size);
+        if(!block) {
+            return false;
+        }
+
+        alloc->block_id = block->block;
+        alloc->offset = block->offset;
+        alloc->size = block->size;
+
+        set_block_owner(block->block, nullptr);
+
+        return true;
+    }
+
+    void defragmenting_allocator::make_movable(allocation* alloc) {
+        set_block_owner(alloc->block_id, alloc);
+        nothing_could_move = false;
+    }
+
+    void defragmenting_allocator::free(allocation* alloc) {
+        if(alloc->block_id == tlsf_allocator::NO_BLOCK) {
+            NOVA_LOG(ERROR) << "defragmenting_allocator::free: Tried to free an allocation that isn't allocated. Allocator: " << this;
+            return;
+        }
+
+        const auto moving = std::find_if(relocations.begin(), relocations.end(), [&](const relocation& r) { return r.alloc == alloc; });
+        if(moving != relocations.end()) {
+            // The copy may still be reading from the source block and writing to the destination block, so leave both
+            // of them alone until the relocation is published
+            moving->alloc = nullptr;
+
+        } else {
+            set_block_owner(alloc->block_id, nullptr);
+            blocks.free(alloc->block_id);
+            nothing_could_move = false;
+        }
+
+        alloc->block_id = tlsf_allocator::NO_BLOCK;
+        alloc->offset = 0;
+        alloc->size = 0;
+    }
+
+    uint64_t defragmenting_allocator::record_relocations(const uint64_t max_bytes, const copy_recorder& record_copy) {
+        if(!relocations.empty() || nothing_could_move || is_fully_compacted()) {
+            return 0;
+        }
+
+        uint64_t bytes_moved = 0;
+        bool hit_budget = false;
+
+        // Work backwards from the end of the address space, moving allocations into any hole before them that they
+        // fit in
+        for(tlsf_allocator::block_index block = blocks.get_last_block(); block != tlsf_allocator::NO_BLOCK;
+            block = blocks.get_previous_block(block)) {
+            if(max_bytes - bytes_moved < granularity) {
+                // Every allocation is at least one granule, so nothing else fits in the budget
+                hit_budget = true;
+                break;
+            }
+
+            if(blocks.is_free(block) || block_owners[block] == nullptr) {
+                continue;
+            }
+
+            const uint64_t size = blocks.get_block_size(block);
+            const uint64_t offset = blocks.get_block_offset(block);
+            if(bytes_moved + size > max_bytes) {
+                hit_budget = true;
+                continue;
+            }
+
+            const std::optional<tlsf_allocator::allocation> destination = blocks.allocate(size);
+            if(!destination) {
+                continue;
+            }
+
+            if(destination->offset > offset) {
+                // Moving this allocation would only make a new hole further forward
+                blocks.free(destination->block);
+                continue;
+            }
+
+            allocation* alloc = block_owners[block];
+            set_block_owner(block, nullptr);
+            relocations.push_back({alloc, block, destination->block, destination->offset});
+
+            // The source is an allocated block and the destination was a free one, so they never overlap
+            record_copy(offset, destination->offset, size);
+
+            bytes_moved += size;
+        }
+
+        // A scan that was cut short by the budget may have missed something that could move
+        nothing_could_move = bytes_moved == 0 && !hit_budget;
+
+        return bytes_moved;
+    }
+
+    void defragmenting_allocator::advance_frame(const bool recorded_copies_finished) {
+        if(recorded_copies_finished) {
+            publish_relocations();
+        }
+
+        free_retired_blocks();
+
+        frame_count++;
+    }
+
+    uint64_t defragmenting_allocator::get_size() const { return blocks.get_size(); }
+
+    uint64_t defragmenting_allocator::get_used_size() const { return blocks.get_used_size(); }
+
+    bool defragmenting_allocator::is_empty() const {
+        return blocks.get_used_size() == 0 && relocations.empty() && retired_blocks.empty();
+    }
+
+    bool defragmenting_allocator::is_fully_compacted() const {
+        const uint64_t free_size = blocks.get_free_size();
+        if(free_size == 0) {
+            return true;
+        }
+
+        const tlsf_allocator::block_index last = blocks.get_last_block();
+        return blocks.is_free(last) && blocks.get_block_size(last) == free_size;
+    }
+
+    void defragmenting_allocator::set_block_owner(const tlsf_allocator::block_index block, allocation* owner) {
+        if(block_owners.size() <= block) {
+            block_owners.resize(block + 1, nullptr);
+        }
+
+        block_owners[block] = owner;
+    }
+
+    void defragmenting_allocator::publish_relocations() {
+        for(const relocation& moved : relocations) {
+            // Frames that are still in flight may be reading from the old location
+            retired_blocks.push_back({moved.source, frame_count});
+
+            if(moved.alloc != nullptr) {
+                moved.alloc->block_id = moved.destination;
+                moved.alloc->offset = moved.destination_offset;
+                set_block_owner(moved.destination, moved.alloc);
+
+            } else {
+                retired_blocks.push_back({moved.destination, frame_count});
+            }
+        }
+
+        relocations.clear();
+    }
+
+    void defragmenting_allocator::free_retired_blocks() {
+        // Blocks retired `max_in_flight_frames` frames ago aren't used by any frame that could still be in flight
+        if(frame_count < max_in_flight_frames) {
+            return;
+        }
+
+        const uint64_t last_finished_frame = frame_count - max_in_flight_frames;
+        while(!retired_blocks.empty() && retired_blocks.front().frame <= last_finished_frame) {
+            blocks.free(retired_blocks.front().block);
+            retired_blocks.pop_front();
+            nothing_could_move = false;
+        }
+    }
+} // namespace nova::renderer
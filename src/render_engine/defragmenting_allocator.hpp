@@ -0,0 +1,188 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <vector>
+
+#include "tlsf_allocator.hpp"
+
+namespace nova::renderer {
+    /*!
+     * \brief Hands out ranges of a linear address space whose contents can be moved around while they're in use, a
+     * little at a time, to keep the free space in one piece at the end
+     *
+     * Moving happens in three steps. `record_relocations` picks allocations near the end of the address space and
+     * reserves holes nearer the start for them, and reports the copies that would move their data. Once the copies have
+     * finished, `advance_frame` publishes them: each moved allocation now points at its new offset. The block an
+     * allocation moved out of is retired rather than freed, since frames that were recorded before publishing may still
+     * be reading from it, and is only reused once `max_in_flight_frames` more frames have started
+     *
+     * Allocations are identified by handles which the caller owns. The allocator writes an allocation's new offset into
+     * its handle when the allocation moves, so read the offset from the handle whenever you need it rather than keeping
+     * a copy
+     *
+     * Not thread-safe
+     */
+    class defragmenting_allocator {
+    public:
+        /*!
+         * \brief Where an allocation currently lives. Owned by the caller, and must stay at the same address while the
+         * allocation lives
+         */
+        struct allocation {
+            tlsf_allocator::block_index block_id = tlsf_allocator::NO_BLOCK;
+            uint64_t offset = 0;
+            uint64_t size = 0;
+        };
+
+        /*!
+         * \brief Records a copy of `size` bytes from `source_offset` to `destination_offset`. The two ranges never
+         * overlap
+         */
+        using copy_recorder = std::function<void(uint64_t source_offset, uint64_t destination_offset, uint64_t size)>;
+
+        /*!
+         * \param size The size of the address space
+         * \param granularity Every allocation's offset and size are a multiple of this
+         * \param max_in_flight_frames How many frames may still be reading from memory after a later frame has started
+         */
+        defragmenting_allocator(uint64_t size, uint64_t granularity, uint32_t max_in_flight_frames);
+
+        defragmenting_allocator(defragmenting_allocator&& other) noexcept = default;
+        defragmenting_allocator& operator=(defragmenting_allocator&& other) noexcept = default;
+
+        defragmenting_allocator(const defragmenting_allocator& other) = delete;
+        defragmenting_allocator& operator=(const defragmenting_allocator& other) = delete;
+
+        ~defragmenting_allocator() = default;
+
+        /*!
+         * \brief Allocates `size` bytes and points `alloc` at them
+         *
+         * The new allocation isn't moved until it's passed to `make_movable`, so its data can be uploaded without racing
+         * a relocation
+         *
+         * \return False if there's no free block big enough
+         */
+        [[nodiscard]] bool allocate(uint64_t size, allocation* alloc);
+
+        /*!
+         * \brief Lets `record_relocations` move an allocation
+         */
+        void make_movable(allocation* alloc);
+
+        /*!
+         * \brief Frees an allocation
+         *
+         * If the allocation is being relocated, the copy may still be reading and writing its blocks, so both of them
+         * are retired once the relocation is published instead of being freed now
+         */
+        void free(allocation* alloc);
+
+        /*!
+         * \brief Reserves holes near the start of the address space for movable allocations near the end, and reports
+         * the copies that move them
+         *
+         * Does nothing while an earlier batch of relocations hasn't been published, or if nothing could move last time
+         * and nothing has been freed or made movable since
+         *
+         * \param max_bytes The most bytes to move
+         * \param record_copy Called for every copy
+         * \return The number of bytes the copies move
+         */
+        uint64_t record_relocations(uint64_t max_bytes, const copy_recorder& record_copy);
+
+        /*!
+         * \brief Tells the allocator that a new frame is starting
+         *
+         * \param recorded_copies_finished True if the copies from the last `record_relocations` have finished, in which
+         * case the allocations they moved now point at their new offsets
+         */
+        void advance_frame(bool recorded_copies_finished);
+
+        [[nodiscard]] uint64_t get_size() const;
+
+        [[nodiscard]] uint64_t get_used_size() const;
+
+        /*!
+         * \brief Checks if no allocations, relocations, or retired blocks are using any part of the address space
+         */
+        [[nodiscard]] bool is_empty() const;
+
+        /*!
+         * \brief Checks if all the free space is in one block at the end of the address space
+         */
+        [[nodiscard]] bool is_fully_compacted() const;
+
+    private:
+        /*!
+         * \brief An allocation that's being copied to a new block
+         */
+        struct relocation {
+            /*!
+             * \brief The allocation being moved, or `nullptr` if it was freed while the copy was in flight
+             */
+            allocation* alloc;
+            tlsf_allocator::block_index source;
+            tlsf_allocator::block_index destination;
+            uint64_t destination_offset;
+        };
+
+        /*!
+         * \brief A block that was moved out of or freed, which frames that are still in flight may be reading
+         */
+        struct retired_block {
+            tlsf_allocator::block_index block;
+            uint64_t frame;
+        };
+
+        tlsf_allocator blocks;
+
+        uint64_t granularity;
+
+        uint32_t max_in_flight_frames;
+
+        /*!
+         * \brief The number of times `advance_frame` has been called
+         */
+        uint64_t frame_count = 0;
+
+        /*!
+         * \brief The allocation that owns each block, indexed by block index
+         *
+         * Relocating an allocation only changes which block its handle points at. Blocks that are being copied to or
+         * from, and blocks of allocations that haven't been made movable yet, don't have an owner, so they're never
+         * picked for relocation
+         */
+        std::vector<allocation*> block_owners;
+
+        /*!
+         * \brief True if the last scan found no allocation it could move, and no hole has opened up and no allocation
+         * has become movable since, so scanning again would find nothing either
+         */
+        bool nothing_could_move = false;
+
+        /*!
+         * \brief Relocations whose copies have been recorded but haven't been published
+         */
+        std::vector<relocation> relocations;
+
+        /*!
+         * \brief Blocks waiting for the frames in flight to finish before they can be freed, oldest first
+         */
+        std::deque<retired_block> retired_blocks;
+
+        void set_block_owner(tlsf_allocator::block_index block, allocation* owner);
+
+        /*!
+         * \brief Points relocated allocations at their new blocks, and retires the blocks they moved out of
+         */
+        void publish_relocations();
+
+        /*!
+         * \brief Frees retired blocks that no frame in flight can still be reading
+         */
+        void free_retired_blocks();
+    };
+} // namespace nova::renderer
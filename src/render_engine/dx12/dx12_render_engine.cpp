@@ -393,6 +393,11 @@ namespace nova::renderer {
         return result<mesh_id_t>(std::move(id));
     }
 
+    bool dx12_render_engine::is_mesh_ready(mesh_id_t) {
+        // TODO
+        return true;
+    }
+
     void dx12_render_engine::delete_mesh(uint32_t) {
         // TODO
     }
@@ -76,6 +76,8 @@ namespace nova::renderer {
 
         result<mesh_id_t> add_mesh(const mesh_data&) override;
 
+        bool is_mesh_ready(mesh_id_t) override;
+
         void delete_mesh(uint32_t) override;
 
         void render_frame() override;
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <list>
+#include <unordered_map>
+
+namespace nova::renderer {
+    /*!
+     * \brief Keeps a set of keys in the order they were last used, so the least recently used one can be found quickly
+     *
+     * Marking a key as used, removing a key, and finding the least recently used key are all O(1)
+     *
+     * Not thread-safe
+     */
+    template <typename KeyType>
+    class lru_list {
+    public:
+        using iterator = typename std::list<KeyType>::const_iterator;
+
+        /*!
+         * \brief Marks a key as the most recently used one, adding it if it's not already in the list
+         */
+        void touch(const KeyType& key) {
+            if(const auto itr = positions.find(key); itr != positions.end()) {
+                order.splice(order.end(), order, itr->second);
+
+            } else {
+                positions.emplace(key, order.insert(order.end(), key));
+            }
+        }
+
+        /*!
+         * \brief Removes a key from the list, if it's there
+         */
+        void remove(const KeyType& key) {
+            if(const auto itr = positions.find(key); itr != positions.end()) {
+                order.erase(itr->second);
+                positions.erase(itr);
+            }
+        }
+
+        /*!
+         * \brief Removes the key at the iterator, and returns the iterator to the key after it
+         */
+        iterator erase(const iterator itr) {
+            positions.erase(*itr);
+            return order.erase(itr);
+        }
+
+        [[nodiscard]] bool contains(const KeyType& key) const { return positions.find(key) != positions.end(); }
+
+        [[nodiscard]] bool empty() const { return order.empty(); }
+
+        [[nodiscard]] std::size_t size() const { return order.size(); }
+
+        /*!
+         * \brief Iterates from the least recently used key to the most recently used key
+         */
+        [[nodiscard]] iterator begin() const { return order.begin(); }
+
+        [[nodiscard]] iterator end() const { return order.end(); }
+
+    private:
+        /*!
+         * \brief Least recently used key at the front, most recently used key at the back
+         */
+        std::list<KeyType> order;
+
+        std::unordered_map<KeyType, iterator> positions;
+    };
+} // namespace nova::renderer
@@ -0,0 +1,77 @@
+#include "memory_budget.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+namespace nova::renderer {
+    const char* to_string(const memory_category category) {
+        switch(category) {
+            case memory_category::Meshes:
+                return "Meshes";
+            case memory_category::DynamicTextures:
+                return "DynamicTextures";
+            case memory_category::Staging:
+                return "Staging";
+            case memory_category::Uniforms:
+                return "Uniforms";
+            default:
+                return "Unknown";
+        }
+    }
+
+    bool is_device_local(const memory_category category) {
+        return category == memory_category::Meshes || category == memory_category::DynamicTextures;
+    }
+
+    memory_budget::memory_budget(const uint64_t budget) : configured_budget(budget == 0 ? UNLIMITED : budget) {}
+
+    void memory_budget::add(const memory_category category, const uint64_t size) {
+        used[static_cast<std::size_t>(category)].fetch_add(size, std::memory_order_relaxed);
+    }
+
+    void memory_budget::remove(const memory_category category, const uint64_t size) {
+        [[maybe_unused]] const uint64_t old_used = used[static_cast<std::size_t>(category)].fetch_sub(size, std::memory_order_relaxed);
+        assert(old_used >= size);
+    }
+
+    void memory_budget::set_used(const memory_category category, const uint64_t size) {
+        used[static_cast<std::size_t>(category)].store(size, std::memory_order_relaxed);
+    }
+
+    uint64_t memory_budget::get_used(const memory_category category) const {
+        return used[static_cast<std::size_t>(category)].load(std::memory_order_relaxed);
+    }
+
+    uint64_t memory_budget::get_total_used() const {
+        uint64_t total = 0;
+        for(const auto& category_used : used) {
+            total += category_used.load(std::memory_order_relaxed);
+        }
+
+        return total;
+    }
+
+    uint64_t memory_budget::get_device_local_used() const {
+        uint64_t total = 0;
+        for(std::size_t i = 0; i < used.size(); i++) {
+            if(is_device_local(static_cast<memory_category>(i))) {
+                total += used[i].load(std::memory_order_relaxed);
+            }
+        }
+
+        return total;
+    }
+
+    void memory_budget::set_device_budget(const uint64_t budget) { device_budget.store(budget, std::memory_order_relaxed); }
+
+    uint64_t memory_budget::get_budget() const { return std::min(configured_budget, device_budget.load(std::memory_order_relaxed)); }
+
+    bool memory_budget::is_over_budget() const { return get_device_local_used() > get_budget(); }
+
+    uint64_t memory_budget::get_amount_over_budget() const {
+        const uint64_t device_local_used = get_device_local_used();
+        const uint64_t budget = get_budget();
+
+        return device_local_used > budget ? device_local_used - budget : 0;
+    }
+} // namespace nova::renderer
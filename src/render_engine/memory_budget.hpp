@@ -0,0 +1,118 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+
+namespace nova::renderer {
+    /*!
+     * \brief The things that the renderer spends GPU memory on
+     */
+    enum class memory_category {
+        /*!
+         * \brief Device-local vertex and index buffers
+         */
+        Meshes,
+
+        /*!
+         * \brief Device-local render targets
+         */
+        DynamicTextures,
+
+        /*!
+         * \brief Host-visible buffers that uploads copy from
+         */
+        Staging,
+
+        /*!
+         * \brief Host-visible buffers that the CPU writes every frame
+         */
+        Uniforms,
+
+        /*!
+         * \brief Not a real category - the number of categories there are
+         */
+        Count,
+    };
+
+    [[nodiscard]] const char* to_string(memory_category category);
+
+    /*!
+     * \brief Checks if a category's memory is in a device-local heap, and so counts against the budget
+     */
+    [[nodiscard]] bool is_device_local(memory_category category);
+
+    /*!
+     * \brief Keeps track of how much GPU memory the renderer is using for each category of resource, and how much it's
+     * allowed to use
+     *
+     * The budget is the smaller of a budget from the user's settings and a budget reported by the device, such as
+     * through VK_EXT_memory_budget. Either one can be left unlimited. Only device-local memory counts against the
+     * budget: host-visible memory lives in different heaps, so it doesn't take any space that the budget covers
+     *
+     * Adding and removing usage is thread-safe, so any thread that creates or destroys a resource can account for it
+     */
+    class memory_budget {
+    public:
+        static constexpr uint64_t UNLIMITED = std::numeric_limits<uint64_t>::max();
+
+        /*!
+         * \param budget The maximum number of bytes the renderer should use. 0 means there's no limit
+         */
+        explicit memory_budget(uint64_t budget = 0);
+
+        memory_budget(memory_budget&& other) noexcept = delete;
+        memory_budget& operator=(memory_budget&& other) noexcept = delete;
+
+        memory_budget(const memory_budget& other) = delete;
+        memory_budget& operator=(const memory_budget& other) = delete;
+
+        ~memory_budget() = default;
+
+        void add(memory_category category, uint64_t size);
+
+        void remove(memory_category category, uint64_t size);
+
+        /*!
+         * \brief Replaces a category's usage, for categories that are measured rather than added up
+         */
+        void set_used(memory_category category, uint64_t size);
+
+        [[nodiscard]] uint64_t get_used(memory_category category) const;
+
+        [[nodiscard]] uint64_t get_total_used() const;
+
+        /*!
+         * \brief Gets the usage of every device-local category, which is what the budget is compared against
+         */
+        [[nodiscard]] uint64_t get_device_local_used() const;
+
+        /*!
+         * \brief Sets how much memory the device says the renderer can use. Call this whenever the device reports a new
+         * budget, since it changes when other programs allocate or free memory
+         *
+         * \param budget The budget in bytes, or UNLIMITED if the device doesn't report one
+         */
+        void set_device_budget(uint64_t budget);
+
+        /*!
+         * \brief Gets the number of bytes the renderer should stay under, or UNLIMITED if there's no budget
+         */
+        [[nodiscard]] uint64_t get_budget() const;
+
+        [[nodiscard]] bool is_over_budget() const;
+
+        /*!
+         * \brief Gets the number of device-local bytes that need to be freed to get back under the budget
+         */
+        [[nodiscard]] uint64_t get_amount_over_budget() const;
+
+    private:
+        uint64_t configured_budget;
+
+        std::atomic<uint64_t> device_budget = UNLIMITED;
+
+        std::array<std::atomic<uint64_t>, static_cast<std::size_t>(memory_category::Count)> used = {};
+    };
+} // namespace nova::renderer
@@ -0,0 +1,53 @@
+#include "ring_allocator.hpp"
+
+#include <cassert>
+
+namespace nova::renderer {
+    ring_allocator::ring_allocator(const uint64_t size) : size(size) {}
+
+    std::optional<ring_allocator::region> ring_allocator::allocate(const uint64_t size, const uint64_t alignment) {
+        assert(alignment > 0);
+        if(this->size == 0 || size > this->size) {
+            return {};
+        }
+
+        if(entries.empty()) {
+            // Nothing is in use, so start again from the beginning instead of wrapping around a gap that nobody needs
+            head = 0;
+            tail = 0;
+        }
+
+        const uint64_t head_offset = head % this->size;
+        uint64_t offset = (head_offset + alignment - 1) / alignment * alignment;
+        if(offset + size > this->size) {
+            // Skip the rest of the ring rather than splitting the region across the end
+            offset = 0;
+        }
+
+        const uint64_t start = offset >= head_offset ? head + (offset - head_offset) : head + (this->size - head_offset);
+        const uint64_t end = start + size;
+        if(end - tail > this->size) {
+            return {};
+        }
+
+        entries.push_back({end, false});
+        head = end;
+
+        return region{first_id + entries.size() - 1, offset, size};
+    }
+
+    void ring_allocator::free(const region& region) {
+        assert(region.id >= first_id && region.id - first_id < entries.size());
+        entries[region.id - first_id].freed = true;
+
+        while(!entries.empty() && entries.front().freed) {
+            tail = entries.front().end;
+            entries.pop_front();
+            first_id++;
+        }
+    }
+
+    uint64_t ring_allocator::get_size() const { return size; }
+
+    uint64_t ring_allocator::get_used_size() const { return head - tail; }
+} // namespace nova::renderer
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <optional>
+
+namespace nova::renderer {
+    /*!
+     * \brief Hands out ranges of a linear address space in a circle, like a staging buffer that's reused forever
+     *
+     * Allocating bumps the head of the ring forward. Regions may be freed in any order, but space is only reclaimed in
+     * the order it was allocated: the tail of the ring moves past a region once it and every region allocated before it
+     * have been freed. That suits memory that's reused once the GPU is done with it, since the GPU mostly finishes work
+     * in the order it was submitted
+     */
+    class ring_allocator {
+    public:
+        struct region {
+            /*!
+             * \brief Identifies this region when it's freed
+             */
+            uint64_t id = 0;
+            uint64_t offset = 0;
+            uint64_t size = 0;
+        };
+
+        explicit ring_allocator(uint64_t size);
+
+        /*!
+         * \brief Allocates `size` bytes, starting at a multiple of `alignment`
+         *
+         * A region is never split across the end of the ring. If it doesn't fit before the end, it starts at offset 0
+         * and the space it skipped is reclaimed along with it
+         *
+         * \return The new region, or an empty optional if there isn't enough space until more regions are freed
+         */
+        [[nodiscard]] std::optional<region> allocate(uint64_t size, uint64_t alignment = 1);
+
+        /*!
+         * \brief Frees a region returned by `allocate`
+         */
+        void free(const region& region);
+
+        [[nodiscard]] uint64_t get_size() const;
+
+        /*!
+         * \brief Gets the number of bytes between the tail and the head of the ring, including padding and any freed
+         * regions that are waiting on an older region to be freed
+         */
+        [[nodiscard]] uint64_t get_used_size() const;
+
+    private:
+        struct entry {
+            /*!
+             * \brief Where the region ends, counting every byte ever allocated rather than wrapping
+             */
+            uint64_t end;
+            bool freed;
+        };
+
+        uint64_t size;
+
+        /*!
+         * \brief Positions of the head and the tail, counting every byte ever allocated. `head - tail` is the number of
+         * bytes in use, and `position % size` is the offset in the buffer
+         */
+        uint64_t head = 0;
+        uint64_t tail = 0;
+
+        /*!
+         * \brief Every region that hasn't been reclaimed yet, in the order they were allocated
+         */
+        std::deque<entry> entries;
+
+        /*!
+         * \brief The ID of the region at the front of `entries`
+         */
+        uint64_t first_id = 0;
+    };
+} // namespace nova::renderer
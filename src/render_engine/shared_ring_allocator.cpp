@@ -0,0 +1,49 @@
+#include "shared_ring_allocator.hpp"
+
+#include "../tasks/task_scheduler.hpp"
+
+namespace nova::renderer {
+    shared_ring_allocator::shared_ring_allocator(const uint64_t size,
+                                                 ttl::task_scheduler* scheduler,
+                                                 const std::chrono::steady_clock::duration max_wait)
+        : scheduler(scheduler), max_wait(max_wait), ring(size) {}
+
+    std::optional<ring_allocator::region> shared_ring_allocator::allocate(const uint64_t size, const uint64_t alignment) {
+        if(size > ring.get_size()) {
+            return {};
+        }
+
+        std::optional<ring_allocator::region> region = try_allocate(size, alignment);
+        if(region || !scheduler->is_worker_thread() || num_frees.load() == num_frees_at_last_timeout.load()) {
+            return region;
+        }
+
+        const auto deadline = std::chrono::steady_clock::now() + max_wait;
+        scheduler->wait_until([&] {
+            region = try_allocate(size, alignment);
+            return region.has_value() || std::chrono::steady_clock::now() >= deadline;
+        });
+
+        if(!region) {
+            num_frees_at_last_timeout.store(num_frees.load());
+        }
+
+        return region;
+    }
+
+    std::optional<ring_allocator::region> shared_ring_allocator::try_allocate(const uint64_t size, const uint64_t alignment) {
+        std::lock_guard l(ring_mutex);
+        return ring.allocate(size, alignment);
+    }
+
+    void shared_ring_allocator::free(const ring_allocator::region& region) {
+        {
+            std::lock_guard l(ring_mutex);
+            ring.free(region);
+        }
+
+        num_frees++;
+    }
+
+    uint64_t shared_ring_allocator::get_size() const { return ring.get_size(); }
+} // namespace nova::renderer
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <optional>
+
+#include "ring_allocator.hpp"
+
+namespace nova::ttl {
+    class task_scheduler;
+} // namespace nova::ttl
+
+namespace nova::renderer {
+    /*!
+     * \brief A ring_allocator that any number of threads can allocate from and free to, which can wait for space when
+     * the ring is full
+     *
+     * Waiting only helps if something frees space while the caller waits. A thread outside the task scheduler can't run
+     * other tasks while it waits - including, possibly, whatever would free the space - so it never waits. A task waits
+     * at most `max_wait`, and if a wait runs out, later allocations don't wait again until something has been freed.
+     * When an allocation doesn't get any space, the caller should put its data somewhere else, such as a dedicated
+     * buffer
+     */
+    class shared_ring_allocator {
+    public:
+        static constexpr std::chrono::milliseconds DEFAULT_MAX_WAIT{50};
+
+        /*!
+         * \param size The size of the ring, in bytes
+         * \param scheduler The scheduler whose tasks allocate from the ring. Used to run other tasks while waiting
+         * \param max_wait The longest that one allocation waits for space
+         */
+        shared_ring_allocator(uint64_t size, ttl::task_scheduler* scheduler, std::chrono::steady_clock::duration max_wait = DEFAULT_MAX_WAIT);
+
+        shared_ring_allocator(shared_ring_allocator&& other) noexcept = delete;
+        shared_ring_allocator& operator=(shared_ring_allocator&& other) noexcept = delete;
+
+        shared_ring_allocator(const shared_ring_allocator& other) = delete;
+        shared_ring_allocator& operator=(const shared_ring_allocator& other) = delete;
+
+        ~shared_ring_allocator() = default;
+
+        /*!
+         * \brief Allocates `size` bytes, starting at a multiple of `alignment`, waiting for space if that might help
+         *
+         * \return The new region, or an empty optional if the allocation is bigger than the ring or no space became
+         * available
+         */
+        [[nodiscard]] std::optional<ring_allocator::region> allocate(uint64_t size, uint64_t alignment = 1);
+
+        /*!
+         * \brief Allocates `size` bytes if there's space for them right now
+         */
+        [[nodiscard]] std::optional<ring_allocator::region> try_allocate(uint64_t size, uint64_t alignment = 1);
+
+        void free(const ring_allocator::region& region);
+
+        [[nodiscard]] uint64_t get_size() const;
+
+    private:
+        ttl::task_scheduler* scheduler;
+        std::chrono::steady_clock::duration max_wait;
+
+        ring_allocator ring;
+        std::mutex ring_mutex;
+
+        std::atomic<uint64_t> num_frees = 0;
+
+        /*!
+         * \brief The value of `num_frees` when a wait last ran out. If nothing has been freed since, waiting is pointless
+         */
+        std::atomic<uint64_t> num_frees_at_last_timeout = std::numeric_limits<uint64_t>::max();
+    };
+} // namespace nova::renderer
@@ -0,0 +1,264 @@
+#include "tlsf_allocator.hpp"
+
+#include <cassert>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace nova::renderer {
+    namespace {
+        /*!
+         * \brief Gets the index of the most significant set bit of `value`, which must not be zero
+         */
+        uint32_t find_last_set(const uint64_t value) {
+#ifdef _MSC_VER
+            unsigned long index;
+            _BitScanReverse64(&index, value);
+            return static_cast<uint32_t>(index);
+#else
+            return static_cast<uint32_t>(63 - __builtin_clzll(value));
+#endif
+        }
+
+        /*!
+         * \brief Gets the index of the least significant set bit of `value`, which must not be zero
+         */
+        uint32_t find_first_set(const uint64_t value) {
+#ifdef _MSC_VER
+            unsigned long index;
+            _BitScanForward64(&index, value);
+            return static_cast<uint32_t>(index);
+#else
+            return static_cast<uint32_t>(__builtin_ctzll(value));
+#endif
+        }
+    } // namespace
+
+    tlsf_allocator::tlsf_allocator(const uint64_t size, const uint64_t granularity)
+        : size(size - size % granularity), granularity(granularity) {
+        assert(granularity > 0);
+
+        for(auto& free_list : free_lists) {
+            free_list.fill(NO_BLOCK);
+        }
+
+        if(this->size == 0) {
+            return;
+        }
+
+        first_block = new_block();
+        last_block = first_block;
+        blocks[first_block].offset = 0;
+        blocks[first_block].size = this->size;
+        insert_free_block(first_block);
+    }
+
+    std::optional<tlsf_allocator::allocation> tlsf_allocator::allocate(const uint64_t size) {
+        if(size > get_free_size()) {
+            return {};
+        }
+
+        // Every block is a whole number of granules, so that every offset is too
+        const uint64_t needed_size = size == 0 ? granularity : (size + granularity - 1) / granularity * granularity;
+
+        uint32_t fl;
+        uint32_t sl;
+        if(!mapping_search(needed_size, &fl, &sl)) {
+            return {};
+        }
+
+        const block_index found = find_free_block(fl, sl);
+        if(found == NO_BLOCK) {
+            return {};
+        }
+
+        remove_free_block(found);
+
+        // Give the end of the block back to the free lists
+        if(blocks[found].size > needed_size) {
+            const block_index remainder = new_block();
+
+            // new_block may have moved the block nodes, so look the found block up again
+            block& allocated = blocks[found];
+            blocks[remainder].offset = allocated.offset + needed_size;
+            blocks[remainder].size = allocated.size - needed_size;
+            blocks[remainder].prev_physical = found;
+            blocks[remainder].next_physical = allocated.next_physical;
+            if(allocated.next_physical != NO_BLOCK) {
+                blocks[allocated.next_physical].prev_physical = remainder;
+            } else {
+                last_block = remainder;
+            }
+
+            allocated.next_physical = remainder;
+            allocated.size = needed_size;
+
+            insert_free_block(remainder);
+        }
+
+        used_size += needed_size;
+
+        return allocation{found, blocks[found].offset, needed_size};
+    }
+
+    void tlsf_allocator::free(block_index block) {
+        assert(block < blocks.size() && !blocks[block].free);
+
+        used_size -= blocks[block].size;
+
+        const block_index prev = blocks[block].prev_physical;
+        if(prev != NO_BLOCK && blocks[prev].free) {
+            remove_free_block(prev);
+            absorb_next(prev, block);
+            block = prev;
+        }
+
+        const block_index next = blocks[block].next_physical;
+        if(next != NO_BLOCK && blocks[next].free) {
+            remove_free_block(next);
+            absorb_next(block, next);
+        }
+
+        insert_free_block(block);
+    }
+
+    uint64_t tlsf_allocator::get_size() const { return size; }
+
+    uint64_t tlsf_allocator::get_used_size() const { return used_size; }
+
+    uint64_t tlsf_allocator::get_free_size() const { return size - used_size; }
+
+    uint64_t tlsf_allocator::get_block_size(const block_index block) const { return blocks[block].size; }
+
+    uint64_t tlsf_allocator::get_block_offset(const block_index block) const { return blocks[block].offset; }
+
+    bool tlsf_allocator::is_free(const block_index block) const { return blocks[block].free; }
+
+    tlsf_allocator::block_index tlsf_allocator::get_last_block() const { return last_block; }
+
+    tlsf_allocator::block_index tlsf_allocator::get_previous_block(const block_index block) const {
+        return blocks[block].prev_physical;
+    }
+
+    tlsf_allocator::block_index tlsf_allocator::new_block() {
+        if(!unused_blocks.empty()) {
+            const block_index index = unused_blocks.back();
+            unused_blocks.pop_back();
+            blocks[index] = {};
+            return index;
+        }
+
+        blocks.emplace_back();
+        return static_cast<block_index>(blocks.size() - 1);
+    }
+
+    void tlsf_allocator::release_block(const block_index block) { unused_blocks.push_back(block); }
+
+    void tlsf_allocator::mapping_insert(const uint64_t size, uint32_t* fl, uint32_t* sl) {
+        if(size < SMALL_BLOCK_SIZE) {
+            *fl = 0;
+            *sl = static_cast<uint32_t>(size);
+
+        } else {
+            const uint32_t msb = find_last_set(size);
+            *fl = msb - SL_INDEX_LOG2 + 1;
+            *sl = static_cast<uint32_t>(size >> (msb - SL_INDEX_LOG2)) - SL_COUNT;
+        }
+    }
+
+    bool tlsf_allocator::mapping_search(uint64_t size, uint32_t* fl, uint32_t* sl) {
+        if(size >= SMALL_BLOCK_SIZE) {
+            // Round up to the next class boundary, so that every block in the class we land in is big enough
+            const uint64_t round = (uint64_t(1) << (find_last_set(size) - SL_INDEX_LOG2)) - 1;
+            if(size > UINT64_MAX - round) {
+                return false;
+            }
+            size += round;
+        }
+
+        mapping_insert(size, fl, sl);
+        return true;
+    }
+
+    tlsf_allocator::block_index tlsf_allocator::find_free_block(uint32_t fl, uint32_t sl) const {
+        uint32_t sl_map = sl_bitmaps[fl] & (~0U << sl);
+        if(sl_map == 0) {
+            // Nothing in this first-level class is big enough, so take anything from the next non-empty one up
+            if(fl + 1 >= FL_COUNT) {
+                return NO_BLOCK;
+            }
+
+            const uint64_t fl_map = fl_bitmap & (~uint64_t(0) << (fl + 1));
+            if(fl_map == 0) {
+                return NO_BLOCK;
+            }
+
+            fl = find_first_set(fl_map);
+            sl_map = sl_bitmaps[fl];
+        }
+
+        sl = find_first_set(sl_map);
+        return free_lists[fl][sl];
+    }
+
+    void tlsf_allocator::insert_free_block(const block_index block) {
+        uint32_t fl;
+        uint32_t sl;
+        mapping_insert(blocks[block].size, &fl, &sl);
+
+        const block_index old_head = free_lists[fl][sl];
+        blocks[block].free = true;
+        blocks[block].prev_free = NO_BLOCK;
+        blocks[block].next_free = old_head;
+        if(old_head != NO_BLOCK) {
+            blocks[old_head].prev_free = block;
+        }
+
+        free_lists[fl][sl] = block;
+        fl_bitmap |= uint64_t(1) << fl;
+        sl_bitmaps[fl] |= 1U << sl;
+    }
+
+    void tlsf_allocator::remove_free_block(const block_index block) {
+        uint32_t fl;
+        uint32_t sl;
+        mapping_insert(blocks[block].size, &fl, &sl);
+
+        const block_index prev = blocks[block].prev_free;
+        const block_index next = blocks[block].next_free;
+        if(prev != NO_BLOCK) {
+            blocks[prev].next_free = next;
+        } else {
+            free_lists[fl][sl] = next;
+        }
+        if(next != NO_BLOCK) {
+            blocks[next].prev_free = prev;
+        }
+
+        if(free_lists[fl][sl] == NO_BLOCK) {
+            sl_bitmaps[fl] &= ~(1U << sl);
+            if(sl_bitmaps[fl] == 0) {
+                fl_bitmap &= ~(uint64_t(1) << fl);
+            }
+        }
+
+        blocks[block].free = false;
+        blocks[block].prev_free = NO_BLOCK;
+        blocks[block].next_free = NO_BLOCK;
+    }
+
+    void tlsf_allocator::absorb_next(const block_index block, const block_index next) {
+        blocks[block].size += blocks[next].size;
+
+        const block_index after = blocks[next].next_physical;
+        blocks[block].next_physical = after;
+        if(after != NO_BLOCK) {
+            blocks[after].prev_physical = block;
+        } else {
+            last_block = block;
+        }
+
+        release_block(next);
+    }
+} // namespace nova::renderer
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace nova::renderer {
+    /*!
+     * \brief Hands out ranges of a linear address space, like a buffer, with constant-time allocation and free
+     *
+     * This is a two-level segregated-fit (TLSF) allocator. Free blocks are kept in one list per size class. The first
+     * level of classes are powers of two, and each of those is split into `SL_COUNT` linear second-level classes. A
+     * bitmap per level says which classes have any free blocks, so finding a big enough free block is a couple of bit
+     * scans rather than a walk over every block. Blocks also know their physical neighbours, so a freed block is merged
+     * with free neighbours straight away
+     *
+     * The allocator only does the bookkeeping - it never touches the memory it manages. Block nodes are kept in a
+     * vector and recycled, so the allocator doesn't hit the heap once it has seen its peak number of blocks
+     */
+    class tlsf_allocator {
+    public:
+        /*!
+         * \brief Identifies a block of the allocator. Indices are reused after the block is freed
+         */
+        using block_index = uint32_t;
+
+        static constexpr block_index NO_BLOCK = UINT32_MAX;
+
+        struct allocation {
+            block_index block = NO_BLOCK;
+            uint64_t offset = 0;
+            uint64_t size = 0;
+        };
+
+        /*!
+         * \brief Creates an allocator for `size` bytes
+         *
+         * \param size The number of bytes to manage
+         * \param granularity Allocation sizes are rounded up to a multiple of this, so every offset the allocator hands
+         * out is a multiple of it too
+         */
+        explicit tlsf_allocator(uint64_t size, uint64_t granularity = 1);
+
+        tlsf_allocator(tlsf_allocator&& other) noexcept = default;
+        tlsf_allocator& operator=(tlsf_allocator&& other) noexcept = default;
+
+        tlsf_allocator(const tlsf_allocator& other) = delete;
+        tlsf_allocator& operator=(const tlsf_allocator& other) = delete;
+
+        ~tlsf_allocator() = default;
+
+        /*!
+         * \brief Allocates `size` bytes
+         *
+         * \return The new allocation, or an empty optional if there's no free block big enough
+         */
+        [[nodiscard]] std::optional<allocation> allocate(uint64_t size);
+
+        /*!
+         * \brief Frees a block returned by `allocate`, merging it with any free neighbours
+         */
+        void free(block_index block);
+
+        [[nodiscard]] uint64_t get_size() const;
+
+        /*!
+         * \brief Gets the number of bytes in allocated blocks, including what rounding to the granularity added
+         */
+        [[nodiscard]] uint64_t get_used_size() const;
+
+        [[nodiscard]] uint64_t get_free_size() const;
+
+        /*!
+         * \brief Gets the size of an allocated block
+         */
+        [[nodiscard]] uint64_t get_block_size(block_index block) const;
+
+        /*!
+         * \brief Gets the offset of an allocated block
+         */
+        [[nodiscard]] uint64_t get_block_offset(block_index block) const;
+
+        [[nodiscard]] bool is_free(block_index block) const;
+
+        /*!
+         * \brief Gets the block at the end of the address space, which may be free
+         */
+        [[nodiscard]] block_index get_last_block() const;
+
+        /*!
+         * \brief Gets the block just before `block` in the address space, or NO_BLOCK if `block` is at offset 0
+         */
+        [[nodiscard]] block_index get_previous_block(block_index block) const;
+
+    private:
+        /*!
+         * \brief log2 of the number of second-level classes per first-level class
+         */
+        static constexpr uint32_t SL_INDEX_LOG2 = 5;
+        static constexpr uint32_t SL_COUNT = 1 << SL_INDEX_LOG2;
+
+        /*!
+         * \brief Blocks smaller than this all go in the first first-level class, one byte per second-level class
+         */
+        static constexpr uint64_t SMALL_BLOCK_SIZE = SL_COUNT;
+
+        /*!
+         * \brief Enough first-level classes to hold any 64-bit size
+         */
+        static constexpr uint32_t FL_COUNT = 64 - SL_INDEX_LOG2 + 1;
+
+        struct block {
+            uint64_t offset = 0;
+            uint64_t size = 0;
+
+            block_index prev_physical = NO_BLOCK;
+            block_index next_physical = NO_BLOCK;
+
+            block_index prev_free = NO_BLOCK;
+            block_index next_free = NO_BLOCK;
+
+            bool free = false;
+        };
+
+        uint64_t size;
+        uint64_t granularity;
+        uint64_t used_size = 0;
+
+        std::vector<block> blocks;
+        std::vector<block_index> unused_blocks;
+
+        /*!
+         * \brief The block at offset 0
+         */
+        block_index first_block = NO_BLOCK;
+
+        /*!
+         * \brief The block that ends at `size`
+         */
+        block_index last_block = NO_BLOCK;
+
+        /*!
+         * \brief Bit N is set if first-level class N has any free blocks
+         */
+        uint64_t fl_bitmap = 0;
+
+        /*!
+         * \brief Bit M of element N is set if second-level class M of first-level class N has any free blocks
+         */
+        std::array<uint32_t, FL_COUNT> sl_bitmaps{};
+
+        std::array<std::array<block_index, SL_COUNT>, FL_COUNT> free_lists;
+
+        [[nodiscard]] block_index new_block();
+
+        void release_block(block_index block);
+
+        /*!
+         * \brief Gets the size class that a free block of `size` bytes belongs in
+         */
+        static void mapping_insert(uint64_t size, uint32_t* fl, uint32_t* sl);
+
+        /*!
+         * \brief Gets the smallest size class whose blocks are all at least `size` bytes
+         *
+         * \return False if there is no such class
+         */
+        static bool mapping_search(uint64_t size, uint32_t* fl, uint32_t* sl);
+
+        /*!
+         * \brief Finds a free block in the class `fl`, `sl` or any larger class
+         */
+        [[nodiscard]] block_index find_free_block(uint32_t fl, uint32_t sl) const;
+
+        void insert_free_block(block_index block);
+
+        void remove_free_block(block_index block);
+
+        /*!
+         * \brief Merges `next` into `block`. `next` must be the physical neighbour after `block`, and neither may be in a
+         * free list
+         */
+        void absorb_next(block_index block, block_index next);
+    };
+} // namespace nova::renderer
@@ -1,29 +1,21 @@
 #pragma once
 
+#include <memory>
 #include <string>
-#include <vector>
 
 #include "nova_renderer/util/result.hpp"
 
+#include "../best_fit_allocator.hpp"
 #include "cached_buffer.hpp"
 #include "vulkan.hpp"
 
 namespace nova::renderer {
-    /*!
-     * \brief A chunk of a buffer
-     *
-     * This class can be added to a lit to mark the free areas in a buffer
-     */
-    struct auto_buffer_chunk {
-        VkDeviceSize offset;
-        VkDeviceSize range;
-    };
-
     /*!
      * \brief A buffer that can be allocated from
      *
-     * This buffer will attempt to automatically allocate space for you. It does not handle fragmentation at all since
-     * the intended use case is a buffer with lots of things that are the same size
+     * This buffer will attempt to automatically allocate space for you. Each allocation comes from the smallest free
+     * chunk it fits in, and freed chunks are merged with their free neighbours, so buffers with allocations of many
+     * different sizes don't fragment too badly. `get_fragmentation` tells you how badly they do
      *
      * A buffer allocated through this class is set up to move data from the CPU to the GPU. If that isn't the case in
      * the future then future DethRaid will have some work to do
@@ -38,23 +30,23 @@ namespace nova::renderer {
          * \param device The Vulkan device this buffer is tied to
          * \param allocator The allocator to allocate this buffer from
          * \param create_info Information about creating the buffer
-         * \param alignment The minimum size of an allocation from this buffer
+         * \param alignment The alignment of allocations from this buffer. Every allocation's size is rounded up to a
+         * multiple of this
          */
         auto_buffer(const std::string& name, VkDevice device, VmaAllocator allocator, VkBufferCreateInfo& create_info, uint64_t alignment);
 
         auto_buffer(const auto_buffer& other) = delete;
         auto_buffer& operator=(const auto_buffer& other) = delete;
 
-        auto_buffer(auto_buffer&& old) noexcept;
-        auto_buffer& operator=(auto_buffer&& old) noexcept;
+        auto_buffer(auto_buffer&& old) noexcept = default;
+        auto_buffer& operator=(auto_buffer&& old) noexcept = default;
 
         ~auto_buffer() override = default;
 
         /*!
          * \brief Allocates a chunk of the underlying buffer for your personal user
          *
-         * This method will give you the first free chunk it has, nothing else. If that leads to lots of fragmentation
-         * then I'll deal with that later
+         * Takes O(log n) time in the number of free chunks
          *
          * \param size The size, in bytes, of the space that you need
          * \return A representation of the allocation that's ready for use in a descriptor set
@@ -68,9 +60,18 @@ namespace nova::renderer {
          */
         void free_allocation(const VkDescriptorBufferInfo& to_free);
 
+        /*!
+         * \brief Gets how fragmented this buffer's free space is, from 0 (all in one chunk) towards 1 (lots of small
+         * chunks)
+         */
+        [[nodiscard]] float get_fragmentation() const;
+
+        [[nodiscard]] VkDeviceSize get_free_size() const;
+
     private:
-        std::vector<auto_buffer_chunk> chunks;
+        /*!
+         * \brief Keeps track of the free space. In a unique_ptr so that a default-constructed buffer doesn't need one
+         */
+        std::unique_ptr<best_fit_allocator> free_space;
     };
-
-    VkDeviceSize space_between(const auto_buffer_chunk& first, const auto_buffer_chunk& last);
 } // namespace nova::renderer
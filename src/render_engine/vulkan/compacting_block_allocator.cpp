@@ -1,5 +1,8 @@
 #include "compacting_block_allocator.hpp"
 
+#include <algorithm>
+#include <iterator>
+
 #include "nova_renderer/render_engine.hpp"
 
 #include "../../util/logger.hpp"
@@ -8,56 +11,57 @@
 namespace nova::renderer {
     uint32_t compacting_block_allocator::block_allocator_buffer::next_id = 0;
 
-    compacting_block_allocator::block_allocator_buffer::block_allocator_buffer(const VkDeviceSize size, VmaAllocator allocator)
-        : allocator(allocator), id(next_id++), size(size) {
-        VmaAllocationCreateInfo allocate_info = {};
-        allocate_info.flags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
-        allocate_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
-
-        VkBufferCreateInfo buffer_info = {};
-        buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-        buffer_info.size = size;
-        buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
-
-        NOVA_CHECK_RESULT(vmaCreateBuffer(allocator, &buffer_info, &allocate_info, &buffer, &vma_allocation, &vma_allocation_info));
-
-        // Setup the first block.
-        // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
-        head = new block_t();
-        head->size = size;
-        head->offset = 0;
-        head->prev = nullptr;
-        head->next = nullptr;
-        head->free = true;
+    compacting_block_allocator::block_allocator_buffer::block_allocator_buffer(const VkDeviceSize size,
+                                                                               const VkDeviceSize granularity,
+                                                                               const uint32_t max_in_flight_frames,
+                                                                               VmaAllocator allocator,
+                                                                               const uint32_t graphics_queue_idx,
+                                                                               const uint32_t copy_queue_idx)
+        : space(size, granularity, max_in_flight_frames),
+          allocator(allocator),
+          graphics_queue_idx(graphics_queue_idx),
+          copy_queue_idx(copy_queue_idx),
+          id(next_id++) {
+        create_buffer();
     }
 
     compacting_block_allocator::block_allocator_buffer::block_allocator_buffer(block_allocator_buffer&& other) noexcept
-        : head(other.head),
+        : space(std::move(other.space)),
+          allocations(std::move(other.allocations)),
+          free_allocations(std::move(other.free_allocations)),
           allocator(other.allocator),
+          graphics_queue_idx(other.graphics_queue_idx),
+          copy_queue_idx(other.copy_queue_idx),
           id(other.id),
-          next_block_id(other.next_block_id),
           buffer(other.buffer),
           vma_allocation(other.vma_allocation),
-          vma_allocation_info(other.vma_allocation_info),
-          size(other.size),
-          allocated(other.allocated) {
+          vma_allocation_info(other.vma_allocation_info) {
         other.buffer = VK_NULL_HANDLE;
+
+        for(allocation_info& allocation : allocations) {
+            allocation.block = this;
+        }
     }
 
     compacting_block_allocator::block_allocator_buffer& compacting_block_allocator::block_allocator_buffer::operator=(
         block_allocator_buffer&& other) noexcept {
-        head = other.head;
+        space = std::move(other.space);
+        allocations = std::move(other.allocations);
+        free_allocations = std::move(other.free_allocations);
         id = other.id;
-        next_block_id = other.next_block_id;
         buffer = other.buffer;
         vma_allocation = other.vma_allocation;
         vma_allocation_info = other.vma_allocation_info;
-        size = other.size;
-        allocated = other.allocated;
         allocator = other.allocator;
+        graphics_queue_idx = other.graphics_queue_idx;
+        copy_queue_idx = other.copy_queue_idx;
 
         other.buffer = VK_NULL_HANDLE;
 
+        for(allocation_info& allocation : allocations) {
+            allocation.block = this;
+        }
+
         return *this;
     }
 
@@ -67,253 +71,208 @@ namespace nova::renderer {
         }
 
         vmaDestroyBuffer(allocator, buffer, vma_allocation);
-
-        block_t* prev = nullptr;
-        block_t* current = head;
-        while(true) {
-            if(current->next == nullptr) {
-                // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
-                delete current;
-                break;
-            }
-            prev = current;
-            current = current->next;
-            // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
-            delete prev;
-        }
-
-        head = nullptr;
     }
 
     compacting_block_allocator::allocation_info* compacting_block_allocator::block_allocator_buffer::allocate(
         const VkDeviceSize needed_size) {
-        return allocate_internal(needed_size, true);
-    }
-
-    void compacting_block_allocator::block_allocator_buffer::free(allocation_info* alloc) {
-        block_t* current = nullptr;
-        for(current = head; current != nullptr; current = current->next) {
-            if(current->id == alloc->block_id) {
-                break;
-            }
+        allocation_info* allocation;
+        if(!free_allocations.empty()) {
+            allocation = free_allocations.back();
+            free_allocations.pop_back();
+        } else {
+            allocation = &allocations.emplace_back();
         }
 
-        if(current == nullptr) {
-            NOVA_LOG(ERROR) << "compacting_block_allocator::block_allocator_buffer::free: Tried to free an unknown allocation. AllocatorL "
-                            << this << " block ID: " << alloc->block_id;
-            return;
+        if(!space.allocate(needed_size, allocation)) {
+            free_allocations.push_back(allocation);
+            return nullptr;
         }
 
-        current->free = true;
-
-        if((current->prev != nullptr) && current->prev->free) {
-            block_t* prev = current->prev;
-
-            prev->next = current->next;
-            if(current->next != nullptr) {
-                current->next->prev = prev;
-            }
-
-            prev->size += current->size;
-
-            // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
-            delete current;
-            current = prev;
+        if(buffer == VK_NULL_HANDLE) {
+            create_buffer();
         }
 
-        if((current->next != nullptr) && current->next->free) {
-            block_t* next = current->next;
-
-            if(next->next != nullptr) {
-                next->next->prev = current;
-            }
+        allocation->block = this;
 
-            current->next = next->next;
+        return allocation;
+    }
 
-            current->size += next->size;
+    void compacting_block_allocator::block_allocator_buffer::make_movable(allocation_info* alloc) { space.make_movable(alloc); }
 
-            // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
-            delete next;
+    void compacting_block_allocator::block_allocator_buffer::free(allocation_info* alloc) {
+        if(alloc->block != this) {
+            NOVA_LOG(ERROR) << "compacting_block_allocator::block_allocator_buffer::free: Tried to free an allocation from another buffer. "
+                            << "Allocator: " << this << " block ID: " << alloc->block_id;
+            return;
         }
 
-        allocated -= alloc->size;
+        space.free(alloc);
+        free_allocations.push_back(alloc);
     }
 
     VkBuffer compacting_block_allocator::block_allocator_buffer::get_buffer() const { return buffer; }
 
-    compacting_block_allocator::allocation_info* compacting_block_allocator::block_allocator_buffer::allocate_internal(
-        VkDeviceSize needed_size, bool can_compact) {
-        const VkDeviceSize free_size = needed_size - allocated;
-        if(free_size < needed_size) {
-            return nullptr;
-        }
-
-        block_t* best_fit = nullptr;
-
-        VkDeviceSize padding = 0;
-        VkDeviceSize offset = 0;
-        VkDeviceSize aligned_size = 0;
-
-        for(block_t* current = head; current != nullptr; current = current->next) {
-            if(!current->free) {
-                continue;
-            }
-
-            if(needed_size > current->size) {
-                continue;
-            }
-
-            offset = current->offset;
+    bool compacting_block_allocator::block_allocator_buffer::is_released() const { return buffer == VK_NULL_HANDLE; }
 
-            padding = offset - current->offset;
-            aligned_size = padding + needed_size;
+    VkDeviceSize compacting_block_allocator::block_allocator_buffer::record_relocations(VkCommandBuffer cmds,
+                                                                                        const VkDeviceSize max_bytes) {
+        std::vector<VkBufferCopy> copies;
+        const auto record_copy = [&](const uint64_t source_offset, const uint64_t destination_offset, const uint64_t size) {
+            VkBufferCopy copy = {};
+            copy.srcOffset = source_offset;
+            copy.dstOffset = destination_offset;
+            copy.size = size;
+            copies.push_back(copy);
+        };
 
-            if(needed_size > current->size) {
-                continue;
-            }
+        const VkDeviceSize bytes_moved = space.record_relocations(max_bytes, record_copy);
 
-            if(aligned_size + allocated >= size) {
-                return nullptr;
-            }
-
-            best_fit = current;
-            break;
+        if(!copies.empty()) {
+            vkCmdCopyBuffer(cmds, buffer, buffer, static_cast<uint32_t>(copies.size()), copies.data());
         }
 
-        if(best_fit == nullptr) {
-            if(can_compact) {
-                compact_all_memory();
-                return allocate_internal(needed_size, false);
-            }
-            return nullptr;
-        }
-
-        if(best_fit->size > needed_size) {
-            // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
-            auto* chunk = new block_t;
-            block_t* next = best_fit->next;
-
-            chunk->id = next_block_id++;
-            chunk->prev = best_fit;
-            best_fit->next = chunk;
+        return bytes_moved;
+    }
 
-            chunk->next = next;
-            if(next != nullptr) {
-                next->prev = chunk;
-            }
+    void compacting_block_allocator::block_allocator_buffer::create_buffer() {
+        VmaAllocationCreateInfo allocate_info = {};
+        allocate_info.flags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
+        allocate_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
 
-            chunk->size = best_fit->size - aligned_size;
-            chunk->offset = offset + needed_size;
-            chunk->free = true;
+        VkBufferCreateInfo buffer_info = {};
+        buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        buffer_info.size = space.get_size();
+        buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+                            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+
+        // The copy queue writes to parts of the buffer while the graphics queue reads from other parts, so both queue
+        // families need to be able to use it without transferring ownership of the whole buffer back and forth
+        const uint32_t queue_family_indices[] = {graphics_queue_idx, copy_queue_idx};
+        if(graphics_queue_idx != copy_queue_idx) {
+            buffer_info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+            buffer_info.queueFamilyIndexCount = 2;
+            buffer_info.pQueueFamilyIndices = queue_family_indices;
         }
 
-        best_fit->free = false;
-        best_fit->size = needed_size;
-
-        allocated += aligned_size;
-
-        // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
-        auto* allocation = new allocation_info;
-
-        allocation->size = best_fit->size;
-        allocation->block_id = best_fit->id;
-        allocation->offset = offset;
-        allocation->block = this;
+        NOVA_CHECK_RESULT(vmaCreateBuffer(allocator, &buffer_info, &allocate_info, &buffer, &vma_allocation, &vma_allocation_info));
+    }
 
-        return allocation;
+    void compacting_block_allocator::block_allocator_buffer::release() {
+        vmaDestroyBuffer(allocator, buffer, vma_allocation);
+        buffer = VK_NULL_HANDLE;
+        vma_allocation = {};
+        vma_allocation_info = {};
     }
 
-    void compacting_block_allocator::block_allocator_buffer::compact_all_memory() {
-        // Look for free blocks. If any are found, close them up
+    compacting_block_allocator::compacting_block_allocator(const nova_settings::block_allocator_settings& settings,
+                                                           const VkDeviceSize granularity,
+                                                           const uint32_t max_in_flight_frames,
+                                                           VmaAllocator vma_allocator,
+                                                           const uint32_t graphics_queue_idx,
+                                                           const uint32_t copy_queue_idx)
+        : settings(settings),
+          granularity(granularity),
+          max_in_flight_frames(max_in_flight_frames),
+          vma_allocator(vma_allocator),
+          graphics_queue_idx(graphics_queue_idx),
+          copy_queue_idx(copy_queue_idx) {
+
+        pools.emplace_back(settings.new_buffer_size, granularity, max_in_flight_frames, vma_allocator, graphics_queue_idx, copy_queue_idx);
+    }
 
-        void* write_ptr;
-        vmaMapMemory(allocator, vma_allocation, &write_ptr);
+    compacting_block_allocator::allocation_info* compacting_block_allocator::allocate(const VkDeviceSize size) {
+        std::lock_guard l(pools_mutex);
+        // First try to allocate from an existing pool, then from a pool whose memory was released
+        for(const bool released : {false, true}) {
+            for(block_allocator_buffer& buffer : pools) {
+                if(buffer.is_released() != released) {
+                    continue;
+                }
 
-        VkDeviceSize amount_compacted = 0;
+                allocation_info* allocation = buffer.allocate(size);
+                if(allocation != nullptr) {
+                    return allocation;
+                }
+            }
+        }
 
-        block_t* current = nullptr;
-        for(current = head; current != nullptr;) {
-            if(current->free && current->next != nullptr) {
-                // Free block! Now we need to move things back
+        // Make the new buffer in place, so the allocation points at the buffer's final address
+        block_allocator_buffer& new_buffer = pools.emplace_back(settings.new_buffer_size,
+                                                                granularity,
+                                                                max_in_flight_frames,
+                                                                vma_allocator,
+                                                                graphics_queue_idx,
+                                                                copy_queue_idx);
+        return new_buffer.allocate(size);
+    }
 
-                // Don't read from memory that's free
-                amount_compacted += current->size;
-            } else {
-                if(amount_compacted > 0) {
-                    // The write and read pointers are different, which means that we need to move the current
-                    // allocation back to fill the empty space
+    void compacting_block_allocator::make_movable(allocation_info* allocation) {
+        std::lock_guard l(pools_mutex);
+        allocation->block->make_movable(allocation);
+    }
 
-                    uint8_t* dst = reinterpret_cast<uint8_t*>(write_ptr) + amount_compacted;
+    void compacting_block_allocator::free(allocation_info* allocation) {
+        std::lock_guard l(pools_mutex);
+        allocation->block->free(allocation);
+    }
 
-                    std::memcpy(write_ptr, dst, current->size);
-                    current->offset -= amount_compacted;
-                }
+    VkDeviceSize compacting_block_allocator::record_defragmentation(VkCommandBuffer cmds) {
+        std::lock_guard l(pools_mutex);
 
-                write_ptr = reinterpret_cast<uint8_t*>(write_ptr) + current->size;
-            }
-            if(current->next != nullptr) {
-                current = current->next;
-            } else {
+        VkDeviceSize bytes_moved = 0;
+        for(block_allocator_buffer& buffer : pools) {
+            if(settings.defragmentation_budget - bytes_moved < granularity) {
                 break;
             }
-        }
 
-        if(amount_compacted > 0) {
-            // Create a free block at the end - after iterating through the list of blocks, we are at the end
-            // e.g. current == end
-
-            // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
-            auto* const end_block = new block_t;
-            end_block->id = next_block_id;
-            next_block_id++;
-            end_block->size = amount_compacted;
-            end_block->offset = current->offset + current->size;
-            end_block->prev = current;
-            current->next = end_block;
+            bytes_moved += buffer.record_relocations(cmds, settings.defragmentation_budget - bytes_moved);
         }
-    }
 
-    compacting_block_allocator::compacting_block_allocator(const nova_settings::block_allocator_settings& settings,
-                                                           VmaAllocator vma_allocator,
-                                                           const uint32_t graphics_queue_idx,
-                                                           const uint32_t copy_queue_idx)
-        : settings(settings), vma_allocator(vma_allocator), graphics_queue_idx(graphics_queue_idx), copy_queue_idx(copy_queue_idx) {
-
-        pools.emplace_back(block_allocator_buffer{settings.new_buffer_size, vma_allocator});
+        return bytes_moved;
     }
 
-    compacting_block_allocator::allocation_info* compacting_block_allocator::allocate(const VkDeviceSize size) {
+    void compacting_block_allocator::advance_frame(const bool recorded_copies_finished) {
         std::lock_guard l(pools_mutex);
-        // First try to allocate from an existing pool
+
         for(block_allocator_buffer& buffer : pools) {
-            allocation_info* allocation = buffer.allocate(size);
-            if(allocation != nullptr) {
-                return allocation;
-            }
+            buffer.space.advance_frame(recorded_copies_finished);
         }
+    }
 
-        block_allocator_buffer new_buffer(settings.new_buffer_size, vma_allocator);
-        allocation_info* allocation = new_buffer.allocate(size);
-        pools.emplace_back(std::move(new_buffer));
+    void compacting_block_allocator::release_empty_buffers() {
+        std::lock_guard l(pools_mutex);
 
-        return allocation;
+        // Keep the first buffer around, so that adding a mesh after everything was freed doesn't have to make a buffer
+        for(auto itr = std::next(pools.begin()); itr != pools.end(); ++itr) {
+            if(!itr->is_released() && itr->space.is_empty()) {
+                itr->release();
+            }
+        }
     }
 
-    void compacting_block_allocator::free(allocation_info* allocation) {
+    VkDeviceSize compacting_block_allocator::get_allocated_size() {
         std::lock_guard l(pools_mutex);
-        allocation->block->free(allocation);
+
+        const auto num_allocated = std::count_if(pools.begin(), pools.end(), [](const block_allocator_buffer& buffer) {
+            return !buffer.is_released();
+        });
+        return static_cast<VkDeviceSize>(num_allocated) * settings.new_buffer_size;
     }
 
     void compacting_block_allocator::add_barriers_before_data_upload(VkCommandBuffer cmds) const {
         std::vector<VkBufferMemoryBarrier> barriers;
         barriers.reserve(pools.size());
         for(const block_allocator_buffer& pool : pools) {
+            if(pool.is_released()) {
+                continue;
+            }
+
             VkBufferMemoryBarrier barrier = {};
             barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
-            barrier.srcAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
-            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-            barrier.srcQueueFamilyIndex = graphics_queue_idx;
-            barrier.dstQueueFamilyIndex = copy_queue_idx;
+            barrier.srcAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
             barrier.buffer = pool.buffer;
             barrier.offset = 0;
             barrier.size = settings.new_buffer_size;
@@ -327,7 +286,7 @@ namespace nova::renderer {
                              VK_DEPENDENCY_BY_REGION_BIT,
                              0,
                              nullptr,
-                             static_cast<uint32_t>(pools.size()),
+                             static_cast<uint32_t>(barriers.size()),
                              barriers.data(),
                              0,
                              nullptr);
@@ -337,12 +296,16 @@ namespace nova::renderer {
         std::vector<VkBufferMemoryBarrier> barriers;
         barriers.reserve(pools.size());
         for(const block_allocator_buffer& pool : pools) {
+            if(pool.is_released()) {
+                continue;
+            }
+
             VkBufferMemoryBarrier barrier = {};
             barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
             barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-            barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
-            barrier.srcQueueFamilyIndex = copy_queue_idx;
-            barrier.dstQueueFamilyIndex = graphics_queue_idx;
+            barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
             barrier.buffer = pool.buffer;
             barrier.offset = 0;
             barrier.size = settings.new_buffer_size;
@@ -356,7 +319,7 @@ namespace nova::renderer {
                              VK_DEPENDENCY_BY_REGION_BIT,
                              0,
                              nullptr,
-                             static_cast<uint32_t>(pools.size()),
+                             static_cast<uint32_t>(barriers.size()),
                              barriers.data(),
                              0,
                              nullptr);
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <deque>
 #include <mutex>
 #include <vector>
 
@@ -7,6 +8,7 @@
 #include "nova_renderer/util/utils.hpp"
 
 #include "../../util/vma_usage.hpp"
+#include "../defragmenting_allocator.hpp"
 #include "vulkan.hpp"
 
 namespace ftl {
@@ -28,26 +30,43 @@ namespace nova::renderer {
      *  - Store mesh data in a single buffer to facilitate indirect rendering
      *  - Prioritize using less memory over runtime. Typical usage scenario for a game is loading a lot of resources
      *      when a new level is loaded, but not constantly loading more. Allocation speed isn't the primary concern
+     *  - That said, a world made of chunks can have tens of thousands of meshes that come and go as the player moves,
+     *      so allocating and freeing must not get slower as the number of allocations grows
      *
      * Adapted from https://www.fasterthan.life/blog/2017/7/13/i-am-graphics-and-so-can-you-part-4- - I've changed it
      * to ration out parts of a buffer instead of allocating buffers from VkMemoryPools. I've also given it the ability
-     * to compact allocations. If an allocation is requested and the total free space in the buffer is greater than or
-     * equal to the size of the allocation, but there's no big enough contiguous blocks, memory will be moved to make
-     * enough contiguous space
+     * to defragment its buffers
+     *
+     * Each buffer's space is managed by a defragmenting_allocator, which uses a tlsf_allocator, so allocating and freeing
+     * take constant time
+     *
+     * Defragmentation happens on the GPU, a little at a time. Every frame, `record_defragmentation` records copies that
+     * move up to `block_allocator_settings::defragmentation_budget` bytes of allocations from the end of a buffer into
+     * holes nearer the start. Once those copies have finished, `advance_frame` points the moved allocations at their new
+     * offsets, and the space they moved out of is freed once no frame in flight can still be reading from it. Because
+     * of that, callers should hold on to the allocation_info pointer and read its offset when they record a draw,
+     * rather than keeping a copy of the offset
      */
     class compacting_block_allocator {
     public:
         class block_allocator_buffer;
 
-        struct allocation_info {
+        /*!
+         * \brief An allocation from a block_allocator_buffer
+         *
+         * These are owned by the buffer they came from and stay at the same address for as long as the allocation lives,
+         * even when defragmentation moves the allocation's data. They're reused once they've been freed, so don't hold on
+         * to one after passing it to `free`
+         */
+        struct allocation_info : defragmenting_allocator::allocation {
             block_allocator_buffer* block = nullptr;
-            uint32_t block_id = 0;
-            VkDeviceSize offset = 0;
-            VkDeviceSize size = 0;
         };
 
         /*!
          * \brief A buffer that memory can be allocated from
+         *
+         * Which parts of the buffer are used, and which allocations are being moved, is up to a defragmenting_allocator.
+         * This class gives it a VkBuffer to live in and records its copies
          */
         class block_allocator_buffer {
             friend class compacting_block_allocator;
@@ -55,8 +74,20 @@ namespace nova::renderer {
         public:
             /*!
              * \brief Initializes a new block_allocator_buffer
+             *
+             * \param size The size of the VkBuffer to allocate from
+             * \param granularity Every allocation's offset and size are a multiple of this
+             * \param max_in_flight_frames How many frames the GPU may be working on at once
+             * \param allocator The VMA allocator to create the VkBuffer with
+             * \param graphics_queue_idx The index of the queue family which reads from the buffer
+             * \param copy_queue_idx The index of the queue family which writes to the buffer
              */
-            block_allocator_buffer(VkDeviceSize size, VmaAllocator allocator);
+            block_allocator_buffer(VkDeviceSize size,
+                                   VkDeviceSize granularity,
+                                   uint32_t max_in_flight_frames,
+                                   VmaAllocator allocator,
+                                   uint32_t graphics_queue_idx,
+                                   uint32_t copy_queue_idx);
 
             block_allocator_buffer(const block_allocator_buffer& other) = delete;
             block_allocator_buffer(block_allocator_buffer&& other) noexcept;
@@ -69,9 +100,7 @@ namespace nova::renderer {
             /*!
              * \brief Allocates memory from this buffer
              *
-             * If there's enough space in a single block, memory is allocated from that block. If there is not, but
-             * there is enough total free space, the allocations in this buffer are compacted before allocating the
-             * desired memory. If there is not enough space in this buffer, the method returns false
+             * The new allocation won't be moved by defragmentation until it's passed to `make_movable`
              *
              * \param needed_size The size of the allocation that we need
              * \return A pointer to the newly-created allocation, or `nullptr` if the allocation couldn't be made
@@ -79,49 +108,72 @@ namespace nova::renderer {
             allocation_info* allocate(VkDeviceSize needed_size);
 
             /*!
-             * \brief Frees the provided allocation
-             *
-             * If the allocation is next to an existing free allocation, it is merged with that one. If it's not next
-             * to a free allocation,
+             * \brief Frees the provided allocation. The allocation_info is reused by a later allocation
              */
             void free(allocation_info* alloc);
 
+            /*!
+             * \brief Lets defragmentation move the provided allocation
+             */
+            void make_movable(allocation_info* alloc);
+
             [[nodiscard]] VkBuffer get_buffer() const;
 
+            /*!
+             * \brief Checks if this buffer's VkBuffer has been destroyed because nothing was using it
+             */
+            [[nodiscard]] bool is_released() const;
+
         private:
-            // The pool is a simple linked list of allocated blocks.
-            // If a block and its neighbor are free, then they are merged
-            // back together in one block.
-            //
-            // Critical note: The linked list is kept sorted
-            struct block_t {
-                uint32_t id = 0;
-                VkDeviceSize size = 0;
-                VkDeviceSize offset = 0;
-                block_t* prev = nullptr;
-                block_t* next = nullptr;
-                bool free = true;
-            };
-            block_t* head;
+            defragmenting_allocator space;
+
+            /*!
+             * \brief Storage for the allocation handles. A deque never moves its elements when it grows, so handles stay
+             * valid
+             */
+            std::deque<allocation_info> allocations;
+            std::vector<allocation_info*> free_allocations;
 
             VmaAllocator allocator;
+            uint32_t graphics_queue_idx;
+            uint32_t copy_queue_idx;
 
             static uint32_t next_id;
             uint32_t id;
 
-            uint32_t next_block_id = 0;
             VkBuffer buffer = VK_NULL_HANDLE;
             VmaAllocation vma_allocation{};
             VmaAllocationInfo vma_allocation_info{};
-            VkDeviceSize size;
-            VkDeviceSize allocated = 0;
 
-            allocation_info* allocate_internal(VkDeviceSize needed_size, bool can_compact);
+            /*!
+             * \brief Records copies that move allocations from the end of this buffer into holes nearer the start
+             *
+             * \param cmds The command buffer to record the copies into
+             * \param max_bytes The most bytes to copy
+             * \return The number of bytes the recorded copies move
+             */
+            VkDeviceSize record_relocations(VkCommandBuffer cmds, VkDeviceSize max_bytes);
 
-            void compact_all_memory();
+            void create_buffer();
+
+            /*!
+             * \brief Destroys the VkBuffer, giving its memory back to the device. `allocate` creates a new one
+             */
+            void release();
         };
 
+        /*!
+         * \param settings How big to make each buffer and how much to defragment each frame
+         * \param granularity Every allocation's offset and size are a multiple of this, e.g. the size of one vertex
+         * \param max_in_flight_frames How many frames the GPU may be working on at once. Memory that an allocation
+         * moved out of is kept for this many frames
+         * \param vma_allocator The VMA allocator to create buffers with
+         * \param graphics_queue_idx The index of the queue family which reads mesh data
+         * \param copy_queue_idx The index of the queue family which uploads mesh data
+         */
         compacting_block_allocator(const nova_settings::block_allocator_settings& settings,
+                                   VkDeviceSize granularity,
+                                   uint32_t max_in_flight_frames,
                                    VmaAllocator vma_allocator,
                                    uint32_t graphics_queue_idx,
                                    uint32_t copy_queue_idx);
@@ -130,15 +182,22 @@ namespace nova::renderer {
          * \brief Allocates memory of the requested size and gives that to you
          *
          * If there's a large enough block of memory in an existing VkBuffer, that block is used
-         * If there's enough total space in an existing VkBuffer, but no blocks are large enough, then the allocations
-         * from that VkBuffer are compacted before allocating the memory you requested
          * If there is not enough room in any existing buffers, a new VkBuffer is created and your memory is allocated
          * from that
          *
+         * Defragmentation won't move the new allocation until you pass it to `make_movable`, so you can upload its data
+         * without racing a relocation
+         *
          * \param size The size, in bytes, of the allocation you want
+         * \return The new allocation, or `nullptr` if `size` is bigger than a whole buffer
          */
         allocation_info* allocate(VkDeviceSize size);
 
+        /*!
+         * \brief Lets defragmentation move an allocation. Call this once the allocation's data has been uploaded
+         */
+        void make_movable(allocation_info* allocation);
+
         /*!
          * \brief Frees a specific allocation
          *
@@ -146,6 +205,44 @@ namespace nova::renderer {
          */
         void free(allocation_info* allocation);
 
+        /*!
+         * \brief Records copies that defragment the buffers, moving at most
+         * `block_allocator_settings::defragmentation_budget` bytes
+         *
+         * Submit `cmds` to the copy queue. The copies don't need any barriers against the graphics queue: they only
+         * read from blocks that nothing writes to, and only write to blocks that nothing reads from until `advance_frame`
+         * publishes them. The first graphics submission that's recorded after publishing must wait for the copies on the
+         * device, e.g. on a semaphore that they signal, so that the copied data is visible to its vertex input
+         *
+         * \param cmds The command buffer to record the copies into
+         * \return The number of bytes the copies will move
+         */
+        VkDeviceSize record_defragmentation(VkCommandBuffer cmds);
+
+        /*!
+         * \brief Tells the allocator that a new frame is starting
+         *
+         * Call this once per frame, at the frame boundary. If the copies from the last `record_defragmentation` have
+         * finished executing, the allocations they moved now point at their new offsets, so that draws recorded from now
+         * on read from the new location
+         *
+         * \param recorded_copies_finished True if the GPU has finished executing the command buffer passed to the last
+         * call to `record_defragmentation`
+         */
+        void advance_frame(bool recorded_copies_finished);
+
+        /*!
+         * \brief Gives the memory of every buffer that nothing is using back to the device, except for the first buffer
+         *
+         * Only call this when the GPU can't be using any freed allocations, e.g. after `advance_frame`
+         */
+        void release_empty_buffers();
+
+        /*!
+         * \brief Gets the number of bytes of device memory that the buffers use, whether or not they're allocated from
+         */
+        [[nodiscard]] VkDeviceSize get_allocated_size();
+
         /*!
          * \brief Adds barriers to the provided command buffer to ensure that reading vertex data has finished before transfers
          *
@@ -161,10 +258,16 @@ namespace nova::renderer {
         void add_barriers_after_data_upload(VkCommandBuffer cmds) const;
 
     private:
-        std::vector<block_allocator_buffer> pools;
+        /*!
+         * \brief All the buffers. This is a deque so that adding a buffer doesn't move the others, since allocations
+         * point to the buffer they came from
+         */
+        std::deque<block_allocator_buffer> pools;
         std::mutex pools_mutex;
 
         const nova_settings::block_allocator_settings settings;
+        VkDeviceSize granularity;
+        uint32_t max_in_flight_frames;
         VmaAllocator vma_allocator;
         uint32_t graphics_queue_idx;
         uint32_t copy_queue_idx;
@@ -1,30 +1,34 @@
 #pragma once
 
 #include <cstdint>
+#include <memory>
+#include <optional>
 
+#include "../concurrent_block_pool.hpp"
 #include "cached_buffer.hpp"
 
 namespace nova::renderer {
     /*!
      * \brief Allocates fixed-size blocks from a uniform buffer
      *
-     * Blocks are an index into the underlying VkBuffer. This tells you where in the VkBuffer you should put your data
+     * Blocks are an index into the underlying VkBuffer. Use `get_block_offset` to find where in the VkBuffer you should
+     * put your data
+     *
+     * Allocating and freeing blocks is thread-safe and lock-free, so tasks that record draws in parallel can each
+     * carve out their own per-draw uniforms. See `concurrent_block_pool` for how
      *
      * Usage notes:
      * The destructor assumes that every allocation has been returned to the pool. If there are active allocations at
      * the time the `fixed_size_block_allocator` is destroyed, they will become invalid and their memory may be reused.
      * Be careful.
      *
-     * \tparam BlockSize The size, in bytes, of one block
+     * \tparam BlockSize The size, in bytes, of one block. Should be a multiple of the device's uniform buffer offset
+     * alignment
      */
     template <uint32_t BlockSize>
     class fixed_size_buffer_allocator : public cached_buffer {
     public:
-        struct block {
-            uint32_t index = 0;
-
-            block* next = nullptr;
-        };
+        using block = concurrent_block_pool::block_index;
 
         /*!
          * \brief Allocates the uniform buffer and sets up block allocation info
@@ -35,67 +39,54 @@ namespace nova::renderer {
          * \param create_info the VkBufferCreateInfo for the uniform buffer you want to create
          * \param alignment The alignment, in bytes, of the uniform buffer. This can be gotten from your
          * VkPhysicalDeviceProperties struct
+         * \param scheduler The scheduler whose threads allocate blocks
          */
-        fixed_size_buffer_allocator(
-            const std::string& name, VkDevice device, VmaAllocator allocator, VkBufferCreateInfo& create_info, const uint64_t alignment)
+        fixed_size_buffer_allocator(const std::string& name,
+                                    VkDevice device,
+                                    VmaAllocator allocator,
+                                    VkBufferCreateInfo& create_info,
+                                    const uint64_t alignment,
+                                    ttl::task_scheduler* scheduler)
             : cached_buffer(name, device, allocator, create_info, alignment),
-              num_blocks(static_cast<uint32_t>(create_info.size) / BlockSize),
-              blocks(new block[num_blocks]),
-              first_block(blocks) {
-
-            for(uint32_t i = 0; i < num_blocks; i++) {
-                blocks[i].index = i;
-                if(i < num_blocks - 1) {
-                    blocks[i].next = &blocks[i + 1];
-                } else {
-                    blocks[i].next = nullptr;
-                }
-            }
-        }
+              blocks(std::make_unique<concurrent_block_pool>(static_cast<uint32_t>(create_info.size / BlockSize), scheduler)) {}
 
         fixed_size_buffer_allocator(const fixed_size_buffer_allocator& other) = delete;
         fixed_size_buffer_allocator& operator=(const fixed_size_buffer_allocator& other) = delete;
 
-        fixed_size_buffer_allocator(fixed_size_buffer_allocator&& old) noexcept
-            : cached_buffer(std::forward(old)), blocks(old.blocks), num_blocks(old.num_blocks) {
-            old.blocks = nullptr;
-        }
-        fixed_size_buffer_allocator& operator=(fixed_size_buffer_allocator&& old) noexcept {
-            cached_buffer::operator=(std::forward<cached_buffer>(old));
-            blocks = old.blocks;
-            num_blocks = old.num_blocks;
-            old.blocks = nullptr;
-
-            return *this;
-        }
+        fixed_size_buffer_allocator(fixed_size_buffer_allocator&& old) noexcept = default;
+        fixed_size_buffer_allocator& operator=(fixed_size_buffer_allocator&& old) noexcept = default;
 
-        virtual ~fixed_size_buffer_allocator() {
-            if(first_block != nullptr) {
-                delete[] first_block;
-            }
-        }
+        ~fixed_size_buffer_allocator() override = default;
 
         /*!
          * \brief Allocates a single block from the buffer
          *
-         * \return The newly allocated block
+         * \return The newly allocated block, or an empty optional if the buffer is full
          */
-        block* allocate_block() {
-            block* ret_val = blocks;
-            blocks = blocks->next;
+        std::optional<block> allocate_block() { return blocks->allocate(); }
 
-            return ret_val;
-        }
+        /*!
+         * \brief Allocates up to `count` blocks from the buffer at once
+         *
+         * \return The number of blocks written to `out_blocks`
+         */
+        uint32_t allocate_blocks(const uint32_t count, block* out_blocks) { return blocks->allocate(count, out_blocks); }
+
+        void free_block(const block freed_block) { blocks->free(freed_block); }
 
-        void free_block(block* freed_block) {
-            freed_block->next = blocks;
-            blocks = freed_block;
+        void free_blocks(const block* freed_blocks, const uint32_t count) { blocks->free(freed_blocks, count); }
+
+        /*!
+         * \brief Gets where in the buffer a block starts, in bytes
+         */
+        [[nodiscard]] static VkDeviceSize get_block_offset(const block allocated_block) {
+            return static_cast<VkDeviceSize>(allocated_block) * BlockSize;
         }
 
     private:
-        uint32_t num_blocks;
-
-        block* blocks;
-        block* first_block;
+        /*!
+         * \brief The pool's in a unique_ptr so that moving the allocator doesn't move the atomics inside it
+         */
+        std::unique_ptr<concurrent_block_pool> blocks;
     };
 } // namespace nova::renderer
@@ -0,0 +1,57 @@
+#include "per_frame_buffer.hpp"
+
+#include "vulkan_utils.hpp"
+
+namespace nova::renderer {
+    per_frame_buffer::per_frame_buffer(const VkDeviceSize region_size,
+                                       const uint32_t num_regions,
+                                       const VkBufferUsageFlags usage,
+                                       const VkDeviceSize region_alignment,
+                                       VmaAllocator vma_allocator)
+        : vma_allocator(vma_allocator), region_size((region_size + region_alignment - 1) / region_alignment * region_alignment) {
+
+        VkBufferCreateInfo buffer_create = {};
+        buffer_create.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        buffer_create.size = this->region_size * num_regions;
+        buffer_create.usage = usage;
+        buffer_create.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        VmaAllocationCreateInfo alloc_create = {};
+        alloc_create.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+        alloc_create.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+        alloc_create.requiredFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+        NOVA_CHECK_RESULT(vmaCreateBuffer(vma_allocator, &buffer_create, &alloc_create, &buffer, &vma_allocation, &vma_allocation_info));
+
+        regions.reserve(num_regions);
+        for(uint32_t i = 0; i < num_regions; i++) {
+            regions.emplace_back(std::make_unique<bump_allocator>(this->region_size));
+        }
+    }
+
+    per_frame_buffer::~per_frame_buffer() { vmaDestroyBuffer(vma_allocator, buffer, vma_allocation); }
+
+    void per_frame_buffer::begin_frame(const uint32_t frame_idx) {
+        current_region = frame_idx;
+        regions.at(current_region)->reset();
+    }
+
+    std::optional<per_frame_buffer::allocation> per_frame_buffer::allocate(const VkDeviceSize size, const VkDeviceSize alignment) {
+        const std::optional<uint64_t> offset_in_region = regions[current_region]->allocate(size, alignment);
+        if(!offset_in_region) {
+            return {};
+        }
+
+        allocation alloc;
+        alloc.offset = region_size * current_region + *offset_in_region;
+        alloc.mapped_data = static_cast<uint8_t*>(vma_allocation_info.pMappedData) + alloc.offset;
+
+        return alloc;
+    }
+
+    VkBuffer per_frame_buffer::get_buffer() const { return buffer; }
+
+    VkDeviceSize per_frame_buffer::get_size() const { return vma_allocation_info.size; }
+
+    VkDeviceSize per_frame_buffer::get_used_size() const { return regions[current_region]->get_used_size(); }
+} // namespace nova::renderer
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "../../util/vma_usage.hpp"
+#include "../bump_allocator.hpp"
+#include "vulkan.hpp"
+
+namespace nova::renderer {
+    /*!
+     * \brief A persistently mapped buffer for data that only lives for one frame, such as model matrices, per-draw
+     * constants, and indirect draw commands
+     *
+     * The buffer is split into one region for each frame that can be in flight. Each frame allocates from its own
+     * region, so the CPU never writes to memory that the GPU may still be reading for an earlier frame. Once a frame's
+     * fence has signalled, `begin_frame` throws away everything that was allocated from its region
+     *
+     * Allocating is lock-free, so tasks that record draws in parallel can all allocate from the buffer. The memory is
+     * host-coherent, so there's nothing to flush
+     */
+    class per_frame_buffer {
+    public:
+        struct allocation {
+            /*!
+             * \brief Where the allocation starts, from the start of the whole buffer
+             */
+            VkDeviceSize offset = 0;
+
+            /*!
+             * \brief Host pointer to the start of the allocation. Write the data for this frame here
+             */
+            void* mapped_data = nullptr;
+        };
+
+        /*!
+         * \param region_size The number of bytes that each frame can allocate
+         * \param num_regions The number of frames that can be in flight at once
+         * \param usage How the buffer will be used
+         * \param region_alignment Each region starts at a multiple of this. Use the biggest offset alignment that the
+         * buffer's usages need
+         * \param vma_allocator The allocator to create the buffer with
+         */
+        per_frame_buffer(VkDeviceSize region_size,
+                         uint32_t num_regions,
+                         VkBufferUsageFlags usage,
+                         VkDeviceSize region_alignment,
+                         VmaAllocator vma_allocator);
+
+        per_frame_buffer(per_frame_buffer&& other) noexcept = delete;
+        per_frame_buffer& operator=(per_frame_buffer&& other) noexcept = delete;
+
+        per_frame_buffer(const per_frame_buffer& other) = delete;
+        per_frame_buffer& operator=(const per_frame_buffer& other) = delete;
+
+        ~per_frame_buffer();
+
+        /*!
+         * \brief Starts allocating from the region for the given frame, throwing away everything that was allocated
+         * from it before
+         *
+         * \pre The GPU has finished the last frame that used this region
+         */
+        void begin_frame(uint32_t frame_idx);
+
+        /*!
+         * \brief Allocates `size` bytes from the current frame's region, starting at a multiple of `alignment`
+         *
+         * `alignment` must divide the region alignment that the buffer was created with
+         *
+         * \return The allocation, or an empty optional if the current frame's region is full
+         */
+        [[nodiscard]] std::optional<allocation> allocate(VkDeviceSize size, VkDeviceSize alignment);
+
+        /*!
+         * \brief Allocates space for `count` objects of type T, aligned to `sizeof(T)` so that the offset of each object
+         * divided by `sizeof(T)` is its index in the whole buffer
+         */
+        template <typename T>
+        [[nodiscard]] std::optional<allocation> allocate_array(const uint32_t count) {
+            return allocate(sizeof(T) * count, sizeof(T));
+        }
+
+        [[nodiscard]] VkBuffer get_buffer() const;
+
+        /*!
+         * \brief Gets the size of the whole buffer, with every frame's region
+         */
+        [[nodiscard]] VkDeviceSize get_size() const;
+
+        /*!
+         * \brief Gets the number of bytes that the current frame has allocated
+         */
+        [[nodiscard]] VkDeviceSize get_used_size() const;
+
+    private:
+        VmaAllocator vma_allocator;
+
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VmaAllocation vma_allocation = VK_NULL_HANDLE;
+        VmaAllocationInfo vma_allocation_info = {};
+
+        VkDeviceSize region_size;
+
+        /*!
+         * \brief One allocator for each region. In unique_ptrs because the allocators can't be moved
+         */
+        std::vector<std::unique_ptr<bump_allocator>> regions;
+        uint32_t current_region = 0;
+    };
+} // namespace nova::renderer
@@ -0,0 +1,98 @@
+#include "staging_ring_buffer.hpp"
+
+#include "../../util/logger.hpp"
+#include "vulkan_utils.hpp"
+
+namespace nova::renderer {
+    namespace {
+        /*!
+         * \brief Creates a host-coherent, persistently mapped buffer to copy data from
+         */
+        void create_staging_buffer(VmaAllocator vma_allocator,
+                                   const VkDeviceSize size,
+                                   VkBuffer* buffer,
+                                   VmaAllocation* allocation,
+                                   VmaAllocationInfo* allocation_info) {
+            VkBufferCreateInfo buffer_create = {};
+            buffer_create.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+            buffer_create.size = size;
+            buffer_create.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+            buffer_create.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+            // Coherent memory, so that uploads don't need to flush what they wrote
+            VmaAllocationCreateInfo alloc_create = {};
+            alloc_create.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+            alloc_create.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+            alloc_create.requiredFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+            NOVA_CHECK_RESULT(vmaCreateBuffer(vma_allocator, &buffer_create, &alloc_create, buffer, allocation, allocation_info));
+        }
+    } // namespace
+
+    staging_ring_buffer::staging_ring_buffer(const VkDeviceSize size, VmaAllocator vma_allocator, ttl::task_scheduler* scheduler)
+        : vma_allocator(vma_allocator), ring(size, scheduler) {
+        create_staging_buffer(vma_allocator, size, &buffer, &vma_allocation, &vma_allocation_info);
+    }
+
+    staging_ring_buffer::~staging_ring_buffer() { vmaDestroyBuffer(vma_allocator, buffer, vma_allocation); }
+
+    staging_ring_buffer::allocation staging_ring_buffer::allocate(const VkDeviceSize size) {
+        if(const std::optional<ring_allocator::region> region = ring.allocate(size, ALIGNMENT)) {
+            return make_ring_allocation(*region, size);
+        }
+
+        return allocate_dedicated(size);
+    }
+
+    std::optional<staging_ring_buffer::allocation> staging_ring_buffer::try_allocate(const VkDeviceSize size) {
+        if(size > ring.get_size()) {
+            return allocate_dedicated(size);
+        }
+
+        const std::optional<ring_allocator::region> region = ring.try_allocate(size, ALIGNMENT);
+        if(!region) {
+            return {};
+        }
+
+        return make_ring_allocation(*region, size);
+    }
+
+    void staging_ring_buffer::free(const allocation& alloc) {
+        if(alloc.region) {
+            ring.free(*alloc.region);
+
+        } else {
+            vmaDestroyBuffer(vma_allocator, alloc.buffer, alloc.dedicated_allocation);
+        }
+    }
+
+    uint64_t staging_ring_buffer::get_num_dedicated_allocations() const { return num_dedicated_allocations.load(); }
+
+    staging_ring_buffer::allocation staging_ring_buffer::allocate_dedicated(const VkDeviceSize size) {
+        NOVA_LOG(DEBUG) << "Upload of " << size << " bytes doesn't fit in the " << ring.get_size()
+                        << " byte staging buffer, giving it its own staging buffer";
+
+        allocation alloc;
+        VmaAllocationInfo allocation_info = {};
+        create_staging_buffer(vma_allocator, size, &alloc.buffer, &alloc.dedicated_allocation, &allocation_info);
+
+        alloc.size = size;
+        alloc.mapped_data = allocation_info.pMappedData;
+
+        num_dedicated_allocations++;
+
+        return alloc;
+    }
+
+    staging_ring_buffer::allocation staging_ring_buffer::make_ring_allocation(const ring_allocator::region& region,
+                                                                              const VkDeviceSize size) const {
+        allocation alloc;
+        alloc.buffer = buffer;
+        alloc.offset = region.offset;
+        alloc.size = size;
+        alloc.mapped_data = static_cast<uint8_t*>(vma_allocation_info.pMappedData) + region.offset;
+        alloc.region = region;
+
+        return alloc;
+    }
+} // namespace nova::renderer
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <atomic>
+#include <optional>
+
+#include "../../util/vma_usage.hpp"
+#include "../shared_ring_allocator.hpp"
+#include "vulkan.hpp"
+
+namespace nova::renderer {
+    /*!
+     * \brief One persistently mapped buffer that every upload copies its data through
+     *
+     * Uploads take a piece of the ring, write their data to it, record a copy from it, and give it back once the copy
+     * has finished executing. Space is reused in the order it was handed out, so as long as uploads finish roughly in
+     * order, loading thousands of meshes doesn't create a single staging buffer
+     *
+     * If an upload doesn't fit right now, a task waits a little while for earlier uploads to finish, running other
+     * tasks in the meantime. Only render_frame gives space back, so an upload that still doesn't fit - or that comes
+     * from a thread that can't run other tasks, or that is bigger than the whole ring - gets a dedicated staging buffer
+     * instead of waiting for a frame that might never come
+     *
+     * All methods are thread-safe
+     */
+    class staging_ring_buffer {
+    public:
+        /*!
+         * \brief Space in the staging buffer for one upload
+         */
+        struct allocation {
+            /*!
+             * \brief The buffer to copy from
+             */
+            VkBuffer buffer = VK_NULL_HANDLE;
+
+            /*!
+             * \brief Where this allocation starts in `buffer`
+             */
+            VkDeviceSize offset = 0;
+
+            VkDeviceSize size = 0;
+
+            /*!
+             * \brief Host pointer to the start of this allocation. Write the data to upload here
+             */
+            void* mapped_data = nullptr;
+
+            /*!
+             * \brief The allocation's space in the ring, or an empty optional if this allocation has a dedicated buffer
+             */
+            std::optional<ring_allocator::region> region;
+
+            VmaAllocation dedicated_allocation = VK_NULL_HANDLE;
+        };
+
+        /*!
+         * \param size The size of the ring, in bytes
+         * \param vma_allocator The allocator to create the ring and any dedicated buffers with
+         * \param scheduler The scheduler whose tasks call `allocate`. Used to run other tasks while waiting for space
+         */
+        staging_ring_buffer(VkDeviceSize size, VmaAllocator vma_allocator, ttl::task_scheduler* scheduler);
+
+        staging_ring_buffer(staging_ring_buffer&& other) noexcept = delete;
+        staging_ring_buffer& operator=(staging_ring_buffer&& other) noexcept = delete;
+
+        staging_ring_buffer(const staging_ring_buffer& other) = delete;
+        staging_ring_buffer& operator=(const staging_ring_buffer& other) = delete;
+
+        ~staging_ring_buffer();
+
+        /*!
+         * \brief Gets `size` bytes of staging memory, from the ring if it has space or a dedicated buffer if it doesn't
+         */
+        [[nodiscard]] allocation allocate(VkDeviceSize size);
+
+        /*!
+         * \brief Gets `size` bytes of staging memory if the ring has space for them right now
+         *
+         * \return The allocation, or an empty optional if the ring is full
+         */
+        [[nodiscard]] std::optional<allocation> try_allocate(VkDeviceSize size);
+
+        /*!
+         * \brief Returns an allocation's space to the ring. Only call this once the GPU has finished copying from it
+         */
+        void free(const allocation& alloc);
+
+        /*!
+         * \brief Gets the number of uploads which didn't fit in the ring and got a dedicated buffer
+         */
+        [[nodiscard]] uint64_t get_num_dedicated_allocations() const;
+
+    private:
+        /*!
+         * \brief Allocations start at a multiple of this, so that any upload can use its offset as a copy source
+         */
+        static constexpr VkDeviceSize ALIGNMENT = 16;
+
+        VmaAllocator vma_allocator;
+
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VmaAllocation vma_allocation = VK_NULL_HANDLE;
+        VmaAllocationInfo vma_allocation_info = {};
+
+        shared_ring_allocator ring;
+
+        std::atomic<uint64_t> num_dedicated_allocations = 0;
+
+        [[nodiscard]] allocation allocate_dedicated(VkDeviceSize size);
+
+        [[nodiscard]] allocation make_ring_allocation(const ring_allocator::region& region, VkDeviceSize size) const;
+    };
+} // namespace nova::renderer
@@ -16,6 +16,7 @@
 
 #include "../../loading/shaderpack/render_graph_builder.hpp"
 #include "../../loading/shaderpack/shaderpack_loading.hpp"
+#include "../../tasks/task_scheduler.hpp"
 #include "../../util/logger.hpp"
 
 // TODO: Move windowing out of render engine folders
@@ -32,10 +33,12 @@ namespace nova::renderer {
     std::shared_ptr<iwindow> vulkan_render_engine::get_window() const { return window; }
 
     VkCommandPool vulkan_render_engine::get_command_buffer_pool_for_current_thread(uint32_t queue_index) {
-        return command_pools_by_thread_idx.at(0).at(queue_index);
+        return command_pools_by_thread_idx.at(scheduler->get_current_thread_idx()).at(queue_index);
     }
 
-    VkDescriptorPool vulkan_render_engine::get_descriptor_pool_for_current_thread() { return descriptor_pools_by_thread_idx.at(0); }
+    VkDescriptorPool vulkan_render_engine::get_descriptor_pool_for_current_thread() {
+        return descriptor_pools_by_thread_idx.at(scheduler->get_current_thread_idx());
+    }
 
     std::pair<std::vector<VkAttachmentDescription>, std::vector<VkAttachmentReference>> vulkan_render_engine::to_vk_attachment_info(
         std::vector<std::string>& attachment_names) {
@@ -102,11 +105,14 @@ namespace nova::renderer {
     }
 
     void vulkan_render_engine::destroy_dynamic_resources() {
+        // Aliased textures share an allocation, so each allocation is freed once all its textures are destroyed
+        std::unordered_map<VmaAllocation, VkDeviceSize> texture_allocations;
         for(auto itr = std::begin(textures); itr != std::end(textures);) {
             const vk_texture& tex = itr->second;
             if(tex.is_dynamic) {
                 vkDestroyImageView(device, tex.image_view, nullptr);
-                vmaDestroyImage(vma_allocator, tex.image, tex.allocation);
+                vkDestroyImage(device, tex.image, nullptr);
+                texture_allocations.emplace(tex.allocation, tex.vma_info.size);
 
                 itr = textures.erase(itr);
             } else {
@@ -114,6 +120,12 @@ namespace nova::renderer {
             }
         }
 
+        for(const auto& [allocation, size] : texture_allocations) {
+            vmaFreeMemory(vma_allocator, allocation);
+            gpu_memory->remove(memory_category::DynamicTextures, size);
+        }
+        aliased_textures_by_first_pass.clear();
+
         for(auto itr = std::begin(buffers); itr != std::end(buffers);) {
             const vk_buffer& buf = itr->second;
             if(buf.is_dynamic) {
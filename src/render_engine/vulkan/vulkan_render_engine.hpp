@@ -1,7 +1,10 @@
 #pragma once
 
 #include <condition_variable>
+#include <memory>
 #include <mutex>
+#include <optional>
+#include <unordered_set>
 
 #include "nova_renderer/render_engine.hpp"
 #include "nova_renderer/renderables.hpp"
@@ -32,8 +35,12 @@
 #include <spirv_cross/spirv_glsl.hpp>
 
 #include "../../util/vma_usage.hpp"
+#include "../lru_list.hpp"
+#include "../memory_budget.hpp"
 #include "auto_allocating_buffer.hpp"
 #include "compacting_block_allocator.hpp"
+#include "per_frame_buffer.hpp"
+#include "staging_ring_buffer.hpp"
 #include "swapchain.hpp"
 
 namespace nova::ttl {
@@ -124,6 +131,15 @@ namespace nova::renderer {
          */
         std::vector<VkImageMemoryBarrier> write_texture_barriers;
 
+        /*!
+         * \brief Barriers for the aliased textures that this pass is the first to use each frame
+         *
+         * An aliased texture shares its memory with other textures, so its contents are gone by the time this pass uses
+         * it. Each barrier waits for the last pass that used the memory, and transitions the texture from
+         * VK_IMAGE_LAYOUT_UNDEFINED to the layout this pass needs
+         */
+        std::vector<VkImageMemoryBarrier> aliasing_barriers;
+
         std::optional<VkImageMemoryBarrier> depth_buffer_barrier;
 
         bool writes_to_backbuffer = false;
@@ -150,21 +166,78 @@ namespace nova::renderer {
         std::string name;
     };
 
-    struct mesh_staging_buffer_upload_command {
-        vk_buffer staging_buffer;
-        uint32_t mesh_id{};
-        uint32_t indices_offset{};
-        uint32_t model_matrix_offset{};
-    };
 
+    /*!
+     * \brief A mesh whose vertices and indices live in the shared mesh buffers
+     *
+     * Read the allocations' offsets when recording a draw, not before: defragmentation may move them between frames
+     */
     struct vk_mesh {
-        vk_buffer index_buffer = {};
-        vk_buffer vertex_buffer = {};
+        compacting_block_allocator::allocation_info* vertex_memory = nullptr;
+        compacting_block_allocator::allocation_info* index_memory = nullptr;
 
         uint32_t num_indices = 0;
         std::size_t num_vertices = 0;
 
         mesh_id_t id;
+
+        /*!
+         * \brief True once the copies of this mesh's data have been submitted, so that any frame recorded from now on
+         * can draw it
+         */
+        bool is_ready = false;
+
+        /*!
+         * \brief False while the mesh has been evicted from GPU memory to stay under the memory budget. An evicted mesh
+         * has no allocations, and is uploaded again from `data` the next time it's visible
+         */
+        bool is_resident = true;
+
+        /*!
+         * \brief The last frame that drew this mesh, or that uploaded it if nothing has drawn it since
+         */
+        uint32_t last_used_frame = 0;
+
+        /*!
+         * \brief The mesh's vertices and indices, kept in CPU memory so that the mesh can be uploaded again after being
+         * evicted. Empty if there's no memory budget, since then the mesh is never evicted
+         */
+        std::shared_ptr<const mesh_data> data;
+    };
+
+    /*!
+     * \brief A mesh whose data is in the staging buffer, waiting to be copied to the mesh buffers
+     */
+    struct mesh_upload {
+        mesh_id_t mesh_id{};
+        staging_ring_buffer::allocation staging;
+
+        compacting_block_allocator::allocation_info* vertex_memory = nullptr;
+        compacting_block_allocator::allocation_info* index_memory = nullptr;
+
+        uint32_t vertex_size = 0;
+        uint32_t index_size = 0;
+    };
+
+    /*!
+     * \brief All the mesh uploads that one frame submitted, and what to clean up once that frame has finished
+     */
+    struct mesh_upload_batch {
+        VkCommandBuffer cmds{};
+
+        /*!
+         * \brief Signalled when this batch's copies are done. The frame that submitted the batch waits on it before
+         * reading vertices
+         */
+        VkSemaphore copies_done{};
+
+        std::vector<mesh_upload> uploads;
+
+        /*!
+         * \brief Meshes that were deleted before this frame started. Their memory is freed once the frame, and every
+         * frame before it, is done with it
+         */
+        std::vector<vk_mesh> deleted_meshes;
     };
 
     struct vk_gpu_info {
@@ -217,7 +290,7 @@ namespace nova::renderer {
         VkQueue copy_queue{};
 #pragma endregion
 
-        vulkan_render_engine(nova_settings& settings, RENDERDOC_API_1_3_0* renderdoc);
+        vulkan_render_engine(nova_settings& settings, ttl::task_scheduler* task_scheduler, RENDERDOC_API_1_3_0* renderdoc);
 
         vulkan_render_engine(vulkan_render_engine&& other) = delete;
         vulkan_render_engine& operator=(vulkan_render_engine&& other) noexcept = delete;
@@ -227,8 +300,6 @@ namespace nova::renderer {
 
         ~vulkan_render_engine() override;
 
-        void flush_model_matrix_buffer();
-
         void render_frame() override;
 
         std::shared_ptr<iwindow> get_window() const override;
@@ -243,11 +314,15 @@ namespace nova::renderer {
 
         result<mesh_id_t> add_mesh(const mesh_data& input_mesh) override;
 
+        bool is_mesh_ready(mesh_id_t mesh_id) override;
+
         void delete_mesh(uint32_t mesh_id) override;
 
         /*!
-         * \brief Retrieves the command pool for the current thread, or creates a new one if there is nothing or the
-         * current thread
+         * \brief Retrieves the command pool for the current thread
+         *
+         * Every worker thread in the task scheduler has its own command pools, and so does the thread outside the
+         * scheduler that drives Nova. Looking up the pools is a thread-local read and an array index
          *
          * \param queue_index the index of the queue we need to get a command pool for
          *
@@ -281,10 +356,25 @@ namespace nova::renderer {
 #pragma region Globals
         RENDERDOC_API_1_3_0* renderdoc;
 
+        /*!
+         * \brief The task scheduler that Nova runs its tasks on. Used to find the index of the calling thread
+         */
+        ttl::task_scheduler* scheduler;
+
         VkInstance vk_instance{};
 
         VmaAllocator vma_allocator{};
 
+        /*!
+         * \brief How much GPU memory Nova uses for each kind of resource, and how much it's allowed to use
+         */
+        std::unique_ptr<memory_budget> gpu_memory;
+
+        /*!
+         * \brief Whether VK_EXT_memory_budget is enabled, so the driver can tell Nova how much memory it can use
+         */
+        bool supports_memory_budget = false;
+
         std::vector<VkSemaphore> render_finished_semaphores;
         std::vector<VkSemaphore> image_available_semaphores;
 
@@ -301,6 +391,9 @@ namespace nova::renderer {
 
         /*!
          * \brief Thread-local command pools so multiple tasks don't try to use the same command pools at the same time
+         *
+         * Indexed by `ttl::task_scheduler::get_current_thread_idx`, so there's one entry for each worker thread plus
+         * one for the external thread
          */
         std::vector<std::unordered_map<uint32_t, VkCommandPool>> command_pools_by_thread_idx;
 
@@ -349,6 +442,13 @@ namespace nova::renderer {
         void create_device();
         void create_memory_allocator();
 
+        /*!
+         * \brief Asks the driver how much device-local memory Nova can use, if VK_EXT_memory_budget is enabled
+         *
+         * The answer changes as other programs allocate memory, so call this every frame
+         */
+        void update_device_memory_budget();
+
         void create_global_sync_objects();
 #pragma endregion
 
@@ -366,6 +466,11 @@ namespace nova::renderer {
         std::unordered_map<std::string, vk_render_pass> render_passes;
         std::vector<std::string> render_passes_by_order;
 
+        /*!
+         * \brief The aliased dynamic textures that each render pass is the first to use each frame, keyed by pass name
+         */
+        std::unordered_map<std::string, std::vector<std::string>> aliased_textures_by_first_pass;
+
         std::unordered_map<std::string, material_data> materials;
 
         /*!
@@ -422,9 +527,13 @@ namespace nova::renderer {
 
         /*!
          * \brief Adds an entry to the dynamic textures for each entry in texture_data
+         *
+         * Textures which the render graph never uses at the same time share memory
+         *
          * \param texture_datas All the texture_datas that you want to create a dynamic texture for
+         * \param passes All the render passes, in the order they're executed
          */
-        void create_textures(const std::vector<texture_resource_data>& texture_datas);
+        void create_textures(const std::vector<texture_resource_data>& texture_datas, const std::vector<render_pass_data>& passes);
 
         /*!
          * \brief Creates descriptor set layouts for all the descriptor set bindings
@@ -445,6 +554,8 @@ namespace nova::renderer {
 
         void create_barriers_for_renderpass(vk_render_pass& pass);
 
+        void create_aliasing_barriers_for_renderpass(vk_render_pass& pass);
+
         /*!
          * \brief Looks at all the renderpasses and generates barriers for resources that are written to in one pass
          * and read from in a downstream pass
@@ -520,6 +631,140 @@ namespace nova::renderer {
         std::mutex meshes_mutex;
         std::atomic<uint32_t> next_mesh_id = 0;
 
+        /*!
+         * \brief The vertex data of every mesh, so that meshes can be drawn without binding new vertex buffers
+         */
+        std::unique_ptr<compacting_block_allocator> vertex_memory;
+
+        /*!
+         * \brief The index data of every mesh, so that meshes can be drawn without binding new index buffers
+         */
+        std::unique_ptr<compacting_block_allocator> index_memory;
+
+        /*!
+         * \brief The buffer that all mesh data is copied through on its way to `vertex_memory` and `index_memory`
+         */
+        std::unique_ptr<staging_ring_buffer> staging_buffer;
+
+        /*!
+         * \brief Meshes that `add_mesh` has staged but that no frame has submitted the copies for yet
+         */
+        std::vector<mesh_upload> pending_mesh_uploads;
+        std::mutex pending_mesh_uploads_mutex;
+
+        /*!
+         * \brief One batch of mesh uploads for each in-flight frame, indexed by `current_swapchain_image`
+         *
+         * Guarded by `meshes_mutex`
+         */
+        std::vector<mesh_upload_batch> mesh_upload_batches;
+
+        /*!
+         * \brief Meshes that have been deleted since the last frame started. Guarded by `meshes_mutex`
+         */
+        std::vector<vk_mesh> deleted_meshes;
+
+        /*!
+         * \brief The size of the allocations of every deleted or evicted mesh which hasn't been freed yet. Guarded by
+         * `meshes_mutex`
+         */
+        VkDeviceSize mesh_memory_being_freed = 0;
+
+        /*!
+         * \brief Command pool for `mesh_defragmentation_cmds` and the mesh upload batches' command buffers. Only the
+         * thread that renders frames uses it
+         */
+        VkCommandPool mesh_defragmentation_command_pool{};
+        VkCommandBuffer mesh_defragmentation_cmds{};
+
+        /*!
+         * \brief Signalled when the last defragmentation copies have finished
+         */
+        VkFence mesh_defragmentation_fence{};
+        bool mesh_defragmentation_in_flight = false;
+
+        /*!
+         * \brief Signalled along with `mesh_defragmentation_fence`. The frame that publishes the copies waits on it
+         * before reading vertices, so that the copied data is visible to its draws
+         */
+        VkSemaphore mesh_defragmentation_done{};
+
+        /*!
+         * \brief The semaphore that each in-flight frame waited on for defragmentation, indexed by
+         * `current_swapchain_image`. It can be signalled again once that frame has finished
+         */
+        std::vector<VkSemaphore> mesh_defragmentation_semaphores_waited;
+
+        /*!
+         * \brief Semaphores that no frame in flight is waiting on, for the next defragmentation copies to signal
+         */
+        std::vector<VkSemaphore> free_mesh_defragmentation_semaphores;
+
+        /*!
+         * \brief Meshes that were evicted, but that a frame wanted to draw. Guarded by `meshes_mutex`
+         */
+        std::unordered_set<mesh_id_t> meshes_to_reupload;
+
+        /*!
+         * \brief Every mesh that's resident, ready, and has a copy of its data to upload again, from the one drawn least
+         * recently to the one drawn most recently. Guarded by `meshes_mutex`
+         */
+        lru_list<mesh_id_t> meshes_by_last_use;
+
+        void create_mesh_memory();
+
+        /*!
+         * \brief Allocates space for a mesh in the mesh buffers and copies its data into the staging buffer
+         *
+         * \param mesh The mesh to stage. Its allocations are filled in
+         * \param data The mesh's vertices and indices
+         * \param use_dedicated_staging Whether to give the mesh its own staging buffer if the staging buffer is full.
+         * When false, the mesh isn't staged at all if there's no space
+         *
+         * \return The upload to submit with the next frame, or an empty optional if there wasn't enough space
+         */
+        std::optional<mesh_upload> stage_mesh(vk_mesh& mesh, const mesh_data& data, bool use_dedicated_staging);
+
+        /*!
+         * \brief Uploads the evicted meshes that the last frame wanted to draw, then evicts the least recently drawn
+         * meshes until the renderer is back under its memory budget
+         *
+         * Only meshes that no in-flight frame has drawn can be evicted. Their memory is freed once every frame that
+         * could have used it has finished
+         *
+         * Must be called once per frame, after waiting on the frame's fence and before `upload_pending_meshes`
+         */
+        void manage_mesh_residency();
+
+        /*!
+         * \brief Publishes the last frame's mesh defragmentation if it's done, then starts this frame's
+         *
+         * Must be called once per frame, after waiting on the frame's fence
+         *
+         * \return The semaphore that this frame's rendering must wait on before reading vertices, or VK_NULL_HANDLE if
+         * nothing was published
+         */
+        VkSemaphore defragment_mesh_memory();
+
+        /*!
+         * \brief Cleans up after the uploads that the current frame's previous use submitted, then submits the copies
+         * of every mesh that's been added since the last frame
+         *
+         * Must be called once per frame, after waiting on the frame's fence
+         *
+         * \return The semaphore that this frame's rendering must wait on before reading vertices, or VK_NULL_HANDLE if
+         * no copies were submitted
+         */
+        VkSemaphore upload_pending_meshes();
+
+        /*!
+         * \brief Tells `gpu_memory` how much device memory the mesh buffers use
+         *
+         * Meshes are counted by the buffers that hold them rather than by their allocations, since that's what the
+         * device sees. Call this whenever the mesh buffers might have been created or released
+         */
+        void update_mesh_memory_usage();
+
         /*!
          * \brief Validates that the sizes in `options` are properly aligned
          *
@@ -547,12 +792,12 @@ namespace nova::renderer {
 
 #pragma region Rendering
         /*!
-         * \brief A buffer to hold model matrices for all render objects
+         * \brief Data that's written each frame and only used by that frame, such as model matrices
          *
-         * Nova puts all the model matrices for all the objects into a single buffer, then indexes into that from
-         * shaders. This allows Nova to make heavy use of instanced rendering
+         * Nova puts all the model matrices for all the objects into this buffer, then indexes into that from shaders
+         * with `gl_InstanceIndex`. This allows Nova to make heavy use of instanced rendering
          */
-        vk_buffer model_matrix_buffer;
+        std::unique_ptr<per_frame_buffer> transient_data;
 
         /*!
          * \brief The data that's constant for the whole frame
@@ -568,19 +813,6 @@ namespace nova::renderer {
         std::mutex rendering_mutex;
         std::condition_variable rendering_cv;
 
-        /*!
-         * \brief The index in the model matrix buffer for write a model matrix to
-         *
-         * When Nova generates drawcalls, it writes model matrices to a single buffer. This variable keeps track of the
-         * current write position
-         *
-         * This will need to be reworked a lot for multithreaded rendering. The current plan for multithreaded
-         * rendering is to make each material's drawcalls a separate async task. This means that each task will have to
-         * be given a separate piece of the model matrix buffer. This variable will still be used at a high level, but
-         * each task will need a local index into the model matrix buffer
-         */
-        uint32_t cur_model_matrix_idx = 0;
-
         void create_builtin_uniform_buffers();
 
         /*!
@@ -628,6 +860,8 @@ namespace nova::renderer {
          * \param cmd_buffer_done_fence The fence to signal when the command buffer has finished executing
          * \param wait_semaphores Any semaphores that the command buffer needs to wait on
          * \param signal_semaphores The semaphores to signal when the command buffer is done
+         * \param wait_stages The stage that waits on each of `wait_semaphores`. Defaults to the color attachment output
+         * stage for every semaphore
          *
          * \pre cmds is a fully recorded command buffer
          */
@@ -635,7 +869,8 @@ namespace nova::renderer {
                              VkQueue queue,
                              VkFence cmd_buffer_done_fence = {},
                              const std::vector<VkSemaphore>& wait_semaphores = {},
-                             const std::vector<VkSemaphore>& signal_semaphores = {});
+                             const std::vector<VkSemaphore>& signal_semaphores = {},
+                             const std::vector<VkPipelineStageFlags>& wait_stages = {});
 #pragma endregion
 
         PFN_vkCreateDebugUtilsMessengerEXT vkCreateDebugUtilsMessengerEXT;
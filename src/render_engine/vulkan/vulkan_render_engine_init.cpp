@@ -1,7 +1,9 @@
+#include <cstring>
 #include <set>
 
 #include <fmt/format.h>
 
+#include "../../tasks/task_scheduler.hpp"
 #include "../../util/logger.hpp"
 #include "swapchain.hpp"
 #include "vulkan.hpp"
@@ -9,8 +11,10 @@
 #include "vulkan_utils.hpp"
 
 namespace nova::renderer {
-    vulkan_render_engine::vulkan_render_engine(nova_settings& settings, RENDERDOC_API_1_3_0* renderdoc)
-        : render_engine(settings), renderdoc(renderdoc) {
+    vulkan_render_engine::vulkan_render_engine(nova_settings& settings,
+                                               ttl::task_scheduler* task_scheduler,
+                                               RENDERDOC_API_1_3_0* renderdoc)
+        : render_engine(settings), renderdoc(renderdoc), scheduler(task_scheduler) {
         NOVA_LOG(INFO) << "Initializing Vulkan rendering";
 
         validate_mesh_options(settings.vertex_memory_settings);
@@ -107,6 +111,7 @@ namespace nova::renderer {
         NOVA_LOG(DEBUG) << "Using " << max_in_flight_frames << " swapchain images";
 
         create_memory_allocator();
+        create_mesh_memory();
 
         create_global_sync_objects();
         create_per_thread_descriptor_pools();
@@ -260,9 +265,25 @@ namespace nova::renderer {
         device_create_info.queueCreateInfoCount = static_cast<uint32_t>(queue_create_infos.size());
         device_create_info.pQueueCreateInfos = queue_create_infos.data();
         device_create_info.pEnabledFeatures = &physical_device_features;
-        device_create_info.enabledExtensionCount = 1;
-        const char* swapchain_extension = VK_KHR_SWAPCHAIN_EXTENSION_NAME;
-        device_create_info.ppEnabledExtensionNames = &swapchain_extension;
+
+        std::vector<const char*> enabled_extension_names = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+
+        // Optional: lets Nova stay under the memory budget that the driver reports
+        uint32_t extension_count;
+        NOVA_CHECK_RESULT(vkEnumerateDeviceExtensionProperties(gpu.phys_device, nullptr, &extension_count, nullptr));
+        std::vector<VkExtensionProperties> device_extensions(extension_count);
+        NOVA_CHECK_RESULT(vkEnumerateDeviceExtensionProperties(gpu.phys_device, nullptr, &extension_count, device_extensions.data()));
+        for(const VkExtensionProperties& extension : device_extensions) {
+            if(std::strcmp(extension.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0) {
+                enabled_extension_names.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+                supports_memory_budget = true;
+                break;
+            }
+        }
+        NOVA_LOG(DEBUG) << "VK_EXT_memory_budget is " << (supports_memory_budget ? "" : "not ") << "supported";
+
+        device_create_info.enabledExtensionCount = static_cast<uint32_t>(enabled_extension_names.size());
+        device_create_info.ppEnabledExtensionNames = enabled_extension_names.data();
         device_create_info.enabledLayerCount = static_cast<uint32_t>(enabled_layer_names.size());
         if(!enabled_layer_names.empty()) {
             device_create_info.ppEnabledLayerNames = enabled_layer_names.data();
@@ -293,7 +314,8 @@ namespace nova::renderer {
     }
 
     void vulkan_render_engine::create_per_thread_command_pools() {
-        const uint32_t num_threads = 1;
+        // One set of pools for each worker, plus one for the external thread
+        const uint32_t num_threads = scheduler->get_num_threads() + 1;
         command_pools_by_thread_idx.reserve(num_threads);
 
         for(uint32_t i = 0; i < num_threads; i++) {
@@ -348,6 +370,86 @@ namespace nova::renderer {
         allocator_create_info.device = device;
 
         NOVA_CHECK_RESULT(vmaCreateAllocator(&allocator_create_info, &vma_allocator));
+
+        gpu_memory = std::make_unique<memory_budget>(settings.gpu_memory_budget);
+        update_device_memory_budget();
+        if(gpu_memory->get_budget() != memory_budget::UNLIMITED) {
+            NOVA_LOG(INFO) << "Nova may use up to " << gpu_memory->get_budget() / (1024 * 1024) << " MB of GPU memory";
+        }
+    }
+
+    void vulkan_render_engine::update_device_memory_budget() {
+        if(!supports_memory_budget) {
+            return;
+        }
+
+        VkPhysicalDeviceMemoryBudgetPropertiesEXT budget_properties = {};
+        budget_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+        VkPhysicalDeviceMemoryProperties2 memory_properties = {};
+        memory_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+        memory_properties.pNext = &budget_properties;
+        vkGetPhysicalDeviceMemoryProperties2(gpu.phys_device, &memory_properties);
+
+        // Meshes and dynamic textures live in device-local memory. Each heap's budget is how much this process can use
+        // in total, so it's compared against everything Nova has allocated in those heaps
+        uint64_t device_local_budget = 0;
+        for(uint32_t i = 0; i < memory_properties.memoryProperties.memoryHeapCount; i++) {
+            if((memory_properties.memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0) {
+                device_local_budget += budget_properties.heapBudget[i];
+            }
+        }
+
+        gpu_memory->set_device_budget(device_local_budget);
+    }
+
+    void vulkan_render_engine::create_mesh_memory() {
+        vertex_memory = std::make_unique<compacting_block_allocator>(settings.vertex_memory_settings,
+                                                                     sizeof(full_vertex),
+                                                                     max_in_flight_frames,
+                                                                     vma_allocator,
+                                                                     graphics_family_index,
+                                                                     transfer_family_index);
+
+        index_memory = std::make_unique<compacting_block_allocator>(settings.index_memory_settings,
+                                                                    sizeof(uint32_t),
+                                                                    max_in_flight_frames,
+                                                                    vma_allocator,
+                                                                    graphics_family_index,
+                                                                    transfer_family_index);
+
+        update_mesh_memory_usage();
+
+        VkCommandPoolCreateInfo pool_create_info = {};
+        pool_create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        pool_create_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        pool_create_info.queueFamilyIndex = transfer_family_index;
+        NOVA_CHECK_RESULT(vkCreateCommandPool(device, &pool_create_info, nullptr, &mesh_defragmentation_command_pool));
+
+        VkCommandBufferAllocateInfo cmd_alloc = {};
+        cmd_alloc.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        cmd_alloc.commandPool = mesh_defragmentation_command_pool;
+        cmd_alloc.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        cmd_alloc.commandBufferCount = 1;
+        NOVA_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmd_alloc, &mesh_defragmentation_cmds));
+
+        VkFenceCreateInfo fence_info = {};
+        fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        NOVA_CHECK_RESULT(vkCreateFence(device, &fence_info, nullptr, &mesh_defragmentation_fence));
+
+        staging_buffer = std::make_unique<staging_ring_buffer>(settings.staging_buffer_size, vma_allocator, scheduler);
+        gpu_memory->add(memory_category::Staging, settings.staging_buffer_size);
+
+        VkSemaphoreCreateInfo semaphore_info = {};
+        semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+        mesh_defragmentation_semaphores_waited.resize(max_in_flight_frames, VK_NULL_HANDLE);
+
+        mesh_upload_batches.resize(max_in_flight_frames);
+        for(mesh_upload_batch& batch : mesh_upload_batches) {
+            NOVA_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmd_alloc, &batch.cmds));
+            NOVA_CHECK_RESULT(vkCreateSemaphore(device, &semaphore_info, nullptr, &batch.copies_done));
+        }
     }
 
     void vulkan_render_engine::create_global_sync_objects() {
@@ -372,7 +474,8 @@ namespace nova::renderer {
     }
 
     void vulkan_render_engine::create_per_thread_descriptor_pools() {
-        const uint32_t num_threads = 1;
+        // One pool for each worker, plus one for the external thread
+        const uint32_t num_threads = scheduler->get_num_threads() + 1;
         descriptor_pools_by_thread_idx.reserve(num_threads);
 
         for(uint32_t i = 0; i < num_threads; i++) {
@@ -1,137 +1,351 @@
+#include <algorithm>
+#include <cstring>
+
+#include <fmt/format.h>
+
 #include "vulkan_render_engine.hpp"
 #include "vulkan_utils.hpp"
 
+#include "../../util/logger.hpp"
+
 namespace nova::renderer {
-    result<mesh_id_t> vulkan_render_engine::add_mesh(const mesh_data& input_mesh) {
-        const auto vertex_size = static_cast<uint32_t>(input_mesh.vertex_data.size() * sizeof(full_vertex));
-        const auto index_size = static_cast<uint32_t>(input_mesh.indices.size() * sizeof(uint32_t));
+    namespace {
+        VkDeviceSize get_mesh_memory_size(const vk_mesh& mesh) { return mesh.vertex_memory->size + mesh.index_memory->size; }
+    } // namespace
 
+    result<mesh_id_t> vulkan_render_engine::add_mesh(const mesh_data& input_mesh) {
         vk_mesh mesh;
         mesh.num_vertices = input_mesh.vertex_data.size();
         mesh.num_indices = static_cast<uint32_t>(input_mesh.indices.size());
+        mesh.id = next_mesh_id.fetch_add(1);
 
-        // TODO: staging buffer pool
-        vk_buffer vertex_data_staging_buffer;
-        vk_buffer index_data_staging_buffer;
+        // Without a memory budget nothing is ever evicted, so there's no need to keep a copy to upload again
+        if(gpu_memory->get_budget() != memory_budget::UNLIMITED) {
+            mesh.data = std::make_shared<const mesh_data>(input_mesh);
+        }
+
+        // If the staging buffer is full this waits briefly for space, then gives the mesh its own staging buffer. Only
+        // render_frame gives space back, so waiting any longer could wait forever
+        const std::optional<mesh_upload> upload = stage_mesh(mesh, input_mesh, true);
+        if(!upload) {
+            return result<mesh_id_t>(nova_error(fmt::format(fmt("Mesh with {:d} vertices and {:d} indices doesn't fit in one mesh buffer. "
+                                                                "Increase new_buffer_size in the mesh memory settings"),
+                                                            mesh.num_vertices,
+                                                            mesh.num_indices)));
+        }
 
         {
-            VkBufferCreateInfo vertex_create = {};
-            vertex_create.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-            vertex_create.size = vertex_size;
-            vertex_create.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
-            vertex_create.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            std::lock_guard l(meshes_mutex);
+            meshes.emplace(mesh.id, mesh);
+        }
 
-            VmaAllocationCreateInfo vertex_alloc_info = {};
-            vertex_alloc_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+        // The next frame copies the mesh to the mesh buffers, along with every other mesh added since the last frame
+        {
+            std::lock_guard l(pending_mesh_uploads_mutex);
+            pending_mesh_uploads.push_back(*upload);
+        }
+
+        return result<mesh_id_t>(mesh.id);
+    }
 
-            vmaCreateBuffer(vma_allocator,
-                            &vertex_create,
-                            &vertex_alloc_info,
-                            &mesh.vertex_buffer.buffer,
-                            &mesh.vertex_buffer.allocation,
-                            &mesh.vertex_buffer.alloc_info);
+    std::optional<mesh_upload> vulkan_render_engine::stage_mesh(vk_mesh& mesh, const mesh_data& data, const bool use_dedicated_staging) {
+        const auto vertex_size = static_cast<uint32_t>(data.vertex_data.size() * sizeof(full_vertex));
+        const auto index_size = static_cast<uint32_t>(data.indices.size() * sizeof(uint32_t));
 
-            vertex_create.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-            vertex_alloc_info.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
-            vertex_alloc_info.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+        mesh.vertex_memory = vertex_memory->allocate(vertex_size);
+        mesh.index_memory = index_memory->allocate(index_size);
 
-            vmaCreateBuffer(vma_allocator,
-                            &vertex_create,
-                            &vertex_alloc_info,
-                            &vertex_data_staging_buffer.buffer,
-                            &vertex_data_staging_buffer.allocation,
-                            &vertex_data_staging_buffer.alloc_info);
+        std::optional<staging_ring_buffer::allocation> staging;
+        if(mesh.vertex_memory != nullptr && mesh.index_memory != nullptr) {
+            staging = use_dedicated_staging ? staging_buffer->allocate(vertex_size + index_size) :
+                                               staging_buffer->try_allocate(vertex_size + index_size);
+        }
 
-            std::memcpy(vertex_data_staging_buffer.alloc_info.pMappedData, input_mesh.vertex_data.data(), vertex_size);
+        if(!staging) {
+            if(mesh.vertex_memory != nullptr) {
+                vertex_memory->free(mesh.vertex_memory);
+                mesh.vertex_memory = nullptr;
+            }
+            if(mesh.index_memory != nullptr) {
+                index_memory->free(mesh.index_memory);
+                mesh.index_memory = nullptr;
+            }
+
+            return {};
         }
 
-        {
-            VkBufferCreateInfo index_create = {};
-            index_create.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-            index_create.size = index_size;
-            index_create.usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
-            index_create.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        // The allocations may have needed a new mesh buffer
+        update_mesh_memory_usage();
+
+        // Vertex data comes first, then the indices. vertex_size is a multiple of sizeof(full_vertex), which keeps the
+        // indices aligned for the copy
+        std::memcpy(staging->mapped_data, data.vertex_data.data(), vertex_size);
+        std::memcpy(static_cast<uint8_t*>(staging->mapped_data) + vertex_size, data.indices.data(), index_size);
 
-            VmaAllocationCreateInfo index_alloc_info = {};
-            index_alloc_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+        mesh_upload upload;
+        upload.mesh_id = mesh.id;
+        upload.staging = *staging;
+        upload.vertex_memory = mesh.vertex_memory;
+        upload.index_memory = mesh.index_memory;
+        upload.vertex_size = vertex_size;
+        upload.index_size = index_size;
 
-            vmaCreateBuffer(vma_allocator,
-                            &index_create,
-                            &index_alloc_info,
-                            &mesh.index_buffer.buffer,
-                            &mesh.index_buffer.allocation,
-                            &mesh.index_buffer.alloc_info);
+        return upload;
+    }
 
-            index_create.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-            index_alloc_info.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
-            index_alloc_info.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+    bool vulkan_render_engine::is_mesh_ready(const mesh_id_t mesh_id) {
+        std::lock_guard l(meshes_mutex);
+        const auto itr = meshes.find(mesh_id);
+        return itr != meshes.end() && itr->second.is_ready;
+    }
 
-            vmaCreateBuffer(vma_allocator,
-                            &index_create,
-                            &index_alloc_info,
-                            &index_data_staging_buffer.buffer,
-                            &index_data_staging_buffer.allocation,
-                            &index_data_staging_buffer.alloc_info);
+    void vulkan_render_engine::delete_mesh(uint32_t mesh_id) {
+        std::lock_guard l(meshes_mutex);
+        const vk_mesh mesh = meshes.at(mesh_id);
+        meshes.erase(mesh_id);
+        meshes_by_last_use.remove(mesh_id);
+        meshes_to_reupload.erase(mesh_id);
 
-            std::memcpy(index_data_staging_buffer.alloc_info.pMappedData, input_mesh.indices.data(), index_size);
+        // Evicting the mesh already took care of its memory
+        if(!mesh.is_resident) {
+            return;
         }
 
-        VkCommandPool pool = get_command_buffer_pool_for_current_thread(transfer_family_index);
+        if(!mesh.is_ready) {
+            std::lock_guard uploads_lock(pending_mesh_uploads_mutex);
+            const auto upload = std::find_if(pending_mesh_uploads.begin(), pending_mesh_uploads.end(), [&](const mesh_upload& upload) {
+                return upload.mesh_id == mesh_id;
+            });
+
+            if(upload != pending_mesh_uploads.end()) {
+                // No frame has copied the mesh yet, so nothing on the GPU uses its memory
+                staging_buffer->free(upload->staging);
+                pending_mesh_uploads.erase(upload);
+
+                index_memory->free(mesh.index_memory);
+                vertex_memory->free(mesh.vertex_memory);
+                return;
+            }
+        }
 
-        VkCommandBufferAllocateInfo cmd_alloc = {};
-        cmd_alloc.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-        cmd_alloc.commandPool = pool;
-        cmd_alloc.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        cmd_alloc.commandBufferCount = 1;
+        // Frames that are in flight may still draw the mesh, or copy its data
+        deleted_meshes.push_back(mesh);
+        mesh_memory_being_freed += get_mesh_memory_size(mesh);
+    }
 
-        VkCommandBuffer cmds;
-        vkAllocateCommandBuffers(device, &cmd_alloc, &cmds);
+    VkSemaphore vulkan_render_engine::upload_pending_meshes() {
+        std::vector<mesh_upload> uploads;
+        {
+            std::lock_guard l(pending_mesh_uploads_mutex);
+            uploads.swap(pending_mesh_uploads);
+        }
+
+        std::lock_guard l(meshes_mutex);
+        mesh_upload_batch& batch = mesh_upload_batches.at(current_swapchain_image);
+
+        // The frame that submitted this batch has finished, so its copies have too
+        for(const mesh_upload& upload : batch.uploads) {
+            staging_buffer->free(upload.staging);
+            vertex_memory->make_movable(upload.vertex_memory);
+            index_memory->make_movable(upload.index_memory);
+        }
+        batch.uploads.clear();
+
+        for(const vk_mesh& mesh : batch.deleted_meshes) {
+            mesh_memory_being_freed -= get_mesh_memory_size(mesh);
+            index_memory->free(mesh.index_memory);
+            vertex_memory->free(mesh.vertex_memory);
+        }
+        batch.deleted_meshes.swap(deleted_meshes);
+        deleted_meshes.clear();
+
+        // No frame that's still in flight uses a buffer that's empty now, so its memory can go back to the device
+        vertex_memory->release_empty_buffers();
+        index_memory->release_empty_buffers();
+        update_mesh_memory_usage();
+
+        if(uploads.empty()) {
+            return VK_NULL_HANDLE;
+        }
+
+        NOVA_CHECK_RESULT(vkResetCommandBuffer(batch.cmds, 0));
 
         VkCommandBufferBeginInfo begin_info = {};
         begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
         begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(batch.cmds, &begin_info);
+
+        // Defragmentation doesn't move allocations that haven't been made movable, so these offsets can't change under us
+        for(const mesh_upload& upload : uploads) {
+            VkBufferCopy vertex_copy = {};
+            vertex_copy.srcOffset = upload.staging.offset;
+            vertex_copy.dstOffset = upload.vertex_memory->offset;
+            vertex_copy.size = upload.vertex_size;
+            vkCmdCopyBuffer(batch.cmds, upload.staging.buffer, upload.vertex_memory->block->get_buffer(), 1, &vertex_copy);
+
+            VkBufferCopy index_copy = {};
+            index_copy.srcOffset = upload.staging.offset + upload.vertex_size;
+            index_copy.dstOffset = upload.index_memory->offset;
+            index_copy.size = upload.index_size;
+            vkCmdCopyBuffer(batch.cmds, upload.staging.buffer, upload.index_memory->block->get_buffer(), 1, &index_copy);
+        }
 
-        vkBeginCommandBuffer(cmds, &begin_info);
-
-        VkBufferCopy vertex_copy = {};
-        vertex_copy.size = vertex_size;
-        vkCmdCopyBuffer(cmds, vertex_data_staging_buffer.buffer, mesh.vertex_buffer.buffer, 1, &vertex_copy);
+        NOVA_CHECK_RESULT(vkEndCommandBuffer(batch.cmds));
 
-        VkBufferCopy index_copy = {};
-        index_copy.size = index_size;
-        vkCmdCopyBuffer(cmds, index_data_staging_buffer.buffer, mesh.index_buffer.buffer, 1, &index_copy);
+        // The mesh buffers are shared by the graphics and transfer queues, so the semaphore is all the synchronization
+        // that the frame needs: no queue ownership transfer
+        submit_to_queue(batch.cmds, copy_queue, VK_NULL_HANDLE, {}, {batch.copies_done});
 
-        vkEndCommandBuffer(cmds);
+        NOVA_LOG(TRACE) << "Uploading " << uploads.size() << " meshes";
 
-        VkFenceCreateInfo create_info = {};
-        create_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        for(const mesh_upload& upload : uploads) {
+            // The mesh may have been deleted since it was added
+            const auto itr = meshes.find(upload.mesh_id);
+            if(itr != meshes.end()) {
+                itr->second.is_ready = true;
 
-        VkFence copy_done_fence;
-        vkCreateFence(device, &create_info, nullptr, &copy_done_fence);
+                // Count the upload as a use, so that a mesh isn't evicted before any frame has had a chance to draw it
+                itr->second.last_used_frame = current_frame;
+                if(itr->second.data) {
+                    meshes_by_last_use.touch(upload.mesh_id);
+                }
+            }
+        }
 
-        submit_to_queue(cmds, copy_queue, copy_done_fence);
+        batch.uploads = std::move(uploads);
 
-        vkWaitForFences(device, 1, &copy_done_fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+        return batch.copies_done;
+    }
 
-        vkDestroyFence(device, copy_done_fence, nullptr);
-        vmaDestroyBuffer(vma_allocator, vertex_data_staging_buffer.buffer, vertex_data_staging_buffer.allocation);
-        vmaDestroyBuffer(vma_allocator, index_data_staging_buffer.buffer, index_data_staging_buffer.allocation);
+    void vulkan_render_engine::manage_mesh_residency() {
+        update_device_memory_budget();
+
+        std::lock_guard l(meshes_mutex);
+
+        // The render thread can't wait for staging space, so meshes that don't fit this frame are tried again next frame
+        for(auto itr = meshes_to_reupload.begin(); itr != meshes_to_reupload.end();) {
+            const auto mesh_itr = meshes.find(*itr);
+            if(mesh_itr == meshes.end() || mesh_itr->second.is_resident) {
+                itr = meshes_to_reupload.erase(itr);
+                continue;
+            }
+
+            vk_mesh& mesh = mesh_itr->second;
+            const std::optional<mesh_upload> upload = stage_mesh(mesh, *mesh.data, false);
+            if(!upload) {
+                ++itr;
+                continue;
+            }
+
+            mesh.is_resident = true;
+            {
+                std::lock_guard uploads_lock(pending_mesh_uploads_mutex);
+                pending_mesh_uploads.push_back(*upload);
+            }
+
+            itr = meshes_to_reupload.erase(itr);
+        }
 
-        vkFreeCommandBuffers(device, pool, 1, &cmds);
+        // Memory only goes back to the device once a whole mesh buffer is empty, so this counts what's already on its
+        // way to being freed and evicts enough for the rest. If freeing it doesn't empty a buffer, a later frame is
+        // still over the budget and evicts more
+        uint32_t num_evicted = 0;
+        for(auto itr = meshes_by_last_use.begin();
+            itr != meshes_by_last_use.end() && gpu_memory->get_amount_over_budget() > mesh_memory_being_freed;) {
+            vk_mesh& mesh = meshes.at(*itr);
+
+            // Frames that are still in flight may draw this mesh, and every mesh after it was used even more recently
+            if(mesh.last_used_frame + max_in_flight_frames > current_frame) {
+                break;
+            }
+
+            // Freed the same way as a deleted mesh, once the frames that might have drawn it have all finished
+            deleted_meshes.push_back(mesh);
+            mesh_memory_being_freed += get_mesh_memory_size(mesh);
+
+            mesh.vertex_memory = nullptr;
+            mesh.index_memory = nullptr;
+            mesh.is_resident = false;
+            mesh.is_ready = false;
+
+            itr = meshes_by_last_use.erase(itr);
+            num_evicted++;
+        }
 
-        mesh.id = next_mesh_id;
-        next_mesh_id.fetch_add(1);
+        if(num_evicted > 0) {
+            NOVA_LOG(DEBUG) << "Evicted " << num_evicted << " meshes to get under the GPU memory budget of " << gpu_memory->get_budget()
+                            << " bytes";
+        }
 
-        meshes.emplace(mesh.id, mesh);
+        if(gpu_memory->get_amount_over_budget() > mesh_memory_being_freed) {
+            NOVA_LOG(TRACE) << "Still " << gpu_memory->get_amount_over_budget()
+                            << " bytes over the GPU memory budget, but every mesh that could be evicted has been";
+        }
+    }
 
-        return result<mesh_id_t>(mesh.id);
+    void vulkan_render_engine::update_mesh_memory_usage() {
+        gpu_memory->set_used(memory_category::Meshes, vertex_memory->get_allocated_size() + index_memory->get_allocated_size());
     }
 
-    void vulkan_render_engine::delete_mesh(uint32_t mesh_id) {
-        const vk_mesh mesh = meshes.at(mesh_id);
-        meshes.erase(mesh_id);
+    VkSemaphore vulkan_render_engine::defragment_mesh_memory() {
+        // The frame that last used this frame's slot has finished, so the semaphore it waited on can be signalled again
+        VkSemaphore& waited_semaphore = mesh_defragmentation_semaphores_waited.at(current_swapchain_image);
+        if(waited_semaphore != VK_NULL_HANDLE) {
+            free_mesh_defragmentation_semaphores.push_back(waited_semaphore);
+            waited_semaphore = VK_NULL_HANDLE;
+        }
+
+        const bool copies_finished = !mesh_defragmentation_in_flight ||
+                                     vkGetFenceStatus(device, mesh_defragmentation_fence) == VK_SUCCESS;
+
+        vertex_memory->advance_frame(copies_finished);
+        index_memory->advance_frame(copies_finished);
+
+        // Only one batch of defragmentation copies is in flight at once, so that publishing knows which copies finished
+        if(!copies_finished) {
+            return VK_NULL_HANDLE;
+        }
+
+        // The host knows the copies are done, but this frame's draws are the first to read from the new offsets, so
+        // the device needs to know too
+        VkSemaphore published_copies_done = VK_NULL_HANDLE;
+        if(mesh_defragmentation_in_flight) {
+            NOVA_CHECK_RESULT(vkResetFences(device, 1, &mesh_defragmentation_fence));
+            mesh_defragmentation_in_flight = false;
+
+            published_copies_done = mesh_defragmentation_done;
+            waited_semaphore = mesh_defragmentation_done;
+            mesh_defragmentation_done = VK_NULL_HANDLE;
+        }
+
+        NOVA_CHECK_RESULT(vkResetCommandBuffer(mesh_defragmentation_cmds, 0));
+
+        VkCommandBufferBeginInfo begin_info = {};
+        begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(mesh_defragmentation_cmds, &begin_info);
+
+        const VkDeviceSize bytes_moved = vertex_memory->record_defragmentation(mesh_defragmentation_cmds) +
+                                         index_memory->record_defragmentation(mesh_defragmentation_cmds);
+
+        NOVA_CHECK_RESULT(vkEndCommandBuffer(mesh_defragmentation_cmds));
+
+        if(bytes_moved > 0) {
+            if(free_mesh_defragmentation_semaphores.empty()) {
+                VkSemaphoreCreateInfo semaphore_info = {};
+                semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+                NOVA_CHECK_RESULT(vkCreateSemaphore(device, &semaphore_info, nullptr, &mesh_defragmentation_done));
+
+            } else {
+                mesh_defragmentation_done = free_mesh_defragmentation_semaphores.back();
+                free_mesh_defragmentation_semaphores.pop_back();
+            }
+
+            NOVA_LOG(TRACE) << "Moving " << bytes_moved << " bytes of mesh data to defragment the mesh buffers";
+            submit_to_queue(mesh_defragmentation_cmds, copy_queue, mesh_defragmentation_fence, {}, {mesh_defragmentation_done});
+            mesh_defragmentation_in_flight = true;
+        }
 
-        vmaDestroyBuffer(vma_allocator, mesh.index_buffer.buffer, mesh.index_buffer.allocation);
-        vmaDestroyBuffer(vma_allocator, mesh.vertex_buffer.buffer, mesh.vertex_buffer.allocation);
+        return published_copies_done;
     }
 } // namespace nova::renderer
@@ -1,3 +1,5 @@
+#include <algorithm>
+
 #include <fmt/format.h>
 
 #include "../../util/logger.hpp"
@@ -6,16 +8,6 @@
 #include "vulkan_utils.hpp"
 
 namespace nova::renderer {
-    void vulkan_render_engine::flush_model_matrix_buffer() {
-        VkMappedMemoryRange model_matrix_buffer_range = {};
-        model_matrix_buffer_range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-        model_matrix_buffer_range.memory = model_matrix_buffer.alloc_info.deviceMemory;
-        model_matrix_buffer_range.offset = model_matrix_buffer.alloc_info.offset;
-        model_matrix_buffer_range.size = model_matrix_buffer.alloc_info.size;
-
-        vkFlushMappedMemoryRanges(device, 1, &model_matrix_buffer_range);
-    }
-
     void vulkan_render_engine::render_frame() {
         NOVA_LOG(DEBUG) << "\n*******************************\n*         FRAME START         *\n*******************************\n";
 
@@ -24,6 +16,13 @@ namespace nova::renderer {
         NOVA_CHECK_RESULT(vkWaitForFences(device, 1, &frame_fences.at(cur_frame), VK_TRUE, std::numeric_limits<uint64_t>::max()));
         NOVA_CHECK_RESULT(vkResetFences(device, 1, &frame_fences.at(current_swapchain_image)));
 
+        // The frame that last used this frame's region of the transient data buffer has finished, so its data can go
+        transient_data->begin_frame(cur_frame);
+
+        const VkSemaphore mesh_defragmentation_done = defragment_mesh_memory();
+        manage_mesh_residency();
+        const VkSemaphore mesh_uploads_done = upload_pending_meshes();
+
         swapchain->acquire_next_swapchain_image(image_available_semaphores.at(cur_frame));
 
         // Record command buffers
@@ -56,17 +55,29 @@ namespace nova::renderer {
             record_renderpass(&renderpass_name, cmds);
         }
 
-        flush_model_matrix_buffer();
-
         shaderpack_loading_mutex.unlock();
 
         NOVA_CHECK_RESULT(vkEndCommandBuffer(cmds));
 
+        std::vector<VkSemaphore> wait_semaphores = {image_available_semaphores.at(cur_frame)};
+        std::vector<VkPipelineStageFlags> wait_stages = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+        if(mesh_uploads_done != VK_NULL_HANDLE) {
+            // Meshes that were uploaded this frame get drawn this frame, so vertex input has to wait for their copies
+            wait_semaphores.push_back(mesh_uploads_done);
+            wait_stages.push_back(VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+        }
+        if(mesh_defragmentation_done != VK_NULL_HANDLE) {
+            // This frame is the first to draw from the offsets that defragmentation moved meshes to
+            wait_semaphores.push_back(mesh_defragmentation_done);
+            wait_stages.push_back(VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+        }
+
         submit_to_queue(cmds,
                         graphics_queue,
                         frame_fences.at(cur_frame),
-                        {image_available_semaphores.at(cur_frame)},
-                        {render_finished_semaphores.at(cur_frame)});
+                        wait_semaphores,
+                        {render_finished_semaphores.at(cur_frame)},
+                        wait_stages);
 
         swapchain->present_current_image(render_finished_semaphores.at(cur_frame));
 
@@ -238,7 +249,21 @@ namespace nova::renderer {
                                  &barrier);
         }
 
-        // TODO: Any barriers for aliased textures if we're at an aliased boundary
+        if(!renderpass.aliasing_barriers.empty()) {
+            // The memory of these textures was last used by other textures, earlier in this frame or in the last one
+            vkCmdPipelineBarrier(cmds,
+                                 VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT |
+                                     VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                                 VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                                 0,
+                                 0,
+                                 nullptr,
+                                 0,
+                                 nullptr,
+                                 static_cast<uint32_t>(renderpass.aliasing_barriers.size()),
+                                 renderpass.aliasing_barriers.data());
+        }
+
         // TODO: Something about the depth buffer
 #pragma endregion
 
@@ -380,11 +405,51 @@ namespace nova::renderer {
          * int curr_instance = gl_InstanceIndex - gl_BaseInstance
          */
 
-        glm::mat4* model_matrices = reinterpret_cast<glm::mat4*>(model_matrix_buffer.alloc_info.pMappedData);
+        // Every mesh lives in the shared mesh buffers, so the buffers only need to be bound again in the rare case that
+        // a mesh is in a different one of them than the last mesh
+        VkBuffer bound_vertex_buffer = VK_NULL_HANDLE;
+        VkBuffer bound_index_buffer = VK_NULL_HANDLE;
+
+        std::lock_guard l(meshes_mutex);
 
         for(const auto& [mesh_id, static_meshes] : renderables.static_meshes) {
-            const uint32_t start_index = cur_model_matrix_idx;
+            // Skip meshes that have been deleted
+            const auto mesh_itr = meshes.find(mesh_id);
+            if(mesh_itr == meshes.end()) {
+                continue;
+            }
+            vk_mesh& mesh = mesh_itr->second;
 
+            const auto num_visible = static_cast<uint32_t>(
+                std::count_if(static_meshes.begin(), static_meshes.end(), [](const vk_static_mesh_renderable& r) { return r.is_visible; }));
+            if(num_visible == 0) {
+                continue;
+            }
+
+            if(!mesh.is_resident) {
+                // The mesh was evicted to stay under the memory budget, but it's visible again. The next frame uploads it
+                meshes_to_reupload.insert(mesh_id);
+                continue;
+            }
+
+            // Skip meshes that are still being uploaded
+            if(!mesh.is_ready) {
+                continue;
+            }
+
+            mesh.last_used_frame = current_frame;
+            if(mesh.data) {
+                meshes_by_last_use.touch(mesh_id);
+            }
+
+            const std::optional<per_frame_buffer::allocation> matrices_memory = transient_data->allocate_array<glm::mat4>(num_visible);
+            if(!matrices_memory) {
+                NOVA_LOG(ERROR) << "Ran out of space for model matrices this frame, not drawing mesh " << mesh_id;
+                continue;
+            }
+
+            auto* model_matrices = static_cast<glm::mat4*>(matrices_memory->mapped_data);
+            uint32_t cur_model_matrix_idx = 0;
             for(const vk_static_mesh_renderable& static_mesh : static_meshes) {
                 if(static_mesh.is_visible) {
                     model_matrices[cur_model_matrix_idx] = static_mesh.model_matrix;
@@ -392,22 +457,29 @@ namespace nova::renderer {
                 }
             }
 
-            if(cur_model_matrix_idx != start_index) {
-                const vk_mesh& mesh = meshes.at(mesh_id);
-
+            const VkBuffer vertex_buffer = mesh.vertex_memory->block->get_buffer();
+            if(vertex_buffer != bound_vertex_buffer) {
                 VkDeviceSize offsets[7] = {0, 0, 0, 0, 0, 0, 0};
-                VkBuffer buffers[7] = {mesh.vertex_buffer.buffer,
-                                       mesh.vertex_buffer.buffer,
-                                       mesh.vertex_buffer.buffer,
-                                       mesh.vertex_buffer.buffer,
-                                       mesh.vertex_buffer.buffer,
-                                       mesh.vertex_buffer.buffer,
-                                       mesh.vertex_buffer.buffer};
+                VkBuffer buffers[7] =
+                    {vertex_buffer, vertex_buffer, vertex_buffer, vertex_buffer, vertex_buffer, vertex_buffer, vertex_buffer};
                 vkCmdBindVertexBuffers(cmds, 0, 7, buffers, offsets);
-                vkCmdBindIndexBuffer(cmds, mesh.index_buffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+                bound_vertex_buffer = vertex_buffer;
+            }
 
-                vkCmdDrawIndexed(cmds, mesh.num_indices, cur_model_matrix_idx - start_index, 0, 0, 0);
+            const VkBuffer index_buffer = mesh.index_memory->block->get_buffer();
+            if(index_buffer != bound_index_buffer) {
+                vkCmdBindIndexBuffer(cmds, index_buffer, 0, VK_INDEX_TYPE_UINT32);
+                bound_index_buffer = index_buffer;
             }
+
+            // Defragmentation may have moved the mesh since the last frame, so look up where it is now
+            const auto first_index = static_cast<uint32_t>(mesh.index_memory->offset / sizeof(uint32_t));
+            const auto vertex_offset = static_cast<int32_t>(mesh.vertex_memory->offset / sizeof(full_vertex));
+
+            // Shaders find each instance's model matrix at gl_InstanceIndex, which starts at firstInstance
+            const auto first_instance = static_cast<uint32_t>(matrices_memory->offset / sizeof(glm::mat4));
+
+            vkCmdDrawIndexed(cmds, mesh.num_indices, num_visible, first_index, vertex_offset, first_instance);
         }
     }
 
@@ -415,13 +487,16 @@ namespace nova::renderer {
                                                VkQueue queue,
                                                VkFence cmd_buffer_done_fence,
                                                const std::vector<VkSemaphore>& wait_semaphores,
-                                               const std::vector<VkSemaphore>& signal_semaphores) {
+                                               const std::vector<VkSemaphore>& signal_semaphores,
+                                               const std::vector<VkPipelineStageFlags>& wait_stages) {
+
+        std::vector<VkPipelineStageFlags> stages = wait_stages;
+        stages.resize(wait_semaphores.size(), VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
 
         VkSubmitInfo submit_info = {};
         submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
         submit_info.pNext = nullptr;
-        VkPipelineStageFlags wait_stages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-        submit_info.pWaitDstStageMask = &wait_stages;
+        submit_info.pWaitDstStageMask = stages.data();
         submit_info.commandBufferCount = 1;
         submit_info.pCommandBuffers = &cmds;
 
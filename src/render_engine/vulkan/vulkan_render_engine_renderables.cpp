@@ -1,3 +1,5 @@
+#include <algorithm>
+
 #include <fmt/format.h>
 #include <glm/gtc/matrix_transform.hpp>
 
@@ -8,26 +10,17 @@
 
 namespace nova::renderer {
     void vulkan_render_engine::create_builtin_uniform_buffers() {
-        {
-            // Future Work: Get this from a per-scene configuration
-            const uint32_t total_object_estimate = 10000;
-            VkBufferCreateInfo model_matrix_create_info = {};
-            model_matrix_create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-            model_matrix_create_info.size = total_object_estimate * sizeof(glm::mat4);
-            model_matrix_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-            model_matrix_create_info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
-
-            VmaAllocationCreateInfo alloc_create_info = {};
-            alloc_create_info.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
-            alloc_create_info.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
-
-            vmaCreateBuffer(vma_allocator,
-                            &model_matrix_create_info,
-                            &alloc_create_info,
-                            &model_matrix_buffer.buffer,
-                            &model_matrix_buffer.allocation,
-                            &model_matrix_buffer.alloc_info);
-        }
+        // Future Work: Get this from a per-scene configuration
+        const uint32_t total_object_estimate = 10000;
+
+        // Regions start at multiples of 256 bytes. That's at least the storage buffer offset alignment of every device,
+        // and a multiple of the size of a model matrix, so model matrices can be found by their index in the whole buffer
+        const VkDeviceSize region_alignment = std::max<VkDeviceSize>(gpu.props.limits.minStorageBufferOffsetAlignment, 256);
+        transient_data = std::make_unique<per_frame_buffer>(total_object_estimate * sizeof(glm::mat4),
+                                                            max_in_flight_frames,
+                                                            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                                                            region_alignment,
+                                                            vma_allocator);
 
         {
             VkBufferCreateInfo per_frame_data_create_info = {};
@@ -47,6 +40,8 @@ namespace nova::renderer {
                             &per_frame_data_buffer.allocation,
                             &per_frame_data_buffer.alloc_info);
         }
+
+        gpu_memory->add(memory_category::Uniforms, transient_data->get_size() + per_frame_data_buffer.alloc_info.size);
     }
 
     result<renderable_id_t> vulkan_render_engine::add_renderable(const static_mesh_renderable_data& data) {
@@ -79,6 +74,7 @@ namespace nova::renderer {
     }
 
     result<const vk_mesh*> vulkan_render_engine::get_mesh_for_renderable(const static_mesh_renderable_data& data) {
+        std::lock_guard l(meshes_mutex);
         if(meshes.find(data.mesh) == meshes.end()) {
             return result<const vk_mesh*>(nova_error(fmt::format(fmt("Could not find mesh with id {:d}"), data.mesh)));
         }
@@ -1,3 +1,7 @@
+#include <algorithm>
+
+#include <fmt/format.h>
+
 #include "../../loading/shaderpack/render_graph_builder.hpp"
 #include "../../loading/shaderpack/shaderpack_loading.hpp"
 #include "../../util/logger.hpp"
@@ -21,7 +25,21 @@ namespace nova::renderer {
             NOVA_LOG(DEBUG) << "Resources from old shaderpacks destroyed";
         }
 
-        create_textures(data.resources.textures);
+        // Textures are aliased based on when passes use them, so the passes have to be ordered first
+        std::unordered_map<std::string, render_pass_data> passes_by_name;
+        passes_by_name.reserve(data.passes.size());
+        for(const render_pass_data& pass_data : data.passes) {
+            passes_by_name[pass_data.name] = pass_data;
+        }
+        render_passes_by_order = order_passes(passes_by_name);
+
+        std::vector<render_pass_data> ordered_passes;
+        ordered_passes.reserve(render_passes_by_order.size());
+        for(const std::string& pass_name : render_passes_by_order) {
+            ordered_passes.push_back(passes_by_name.at(pass_name));
+        }
+
+        create_textures(data.resources.textures, ordered_passes);
         NOVA_LOG(DEBUG) << "Dynamic textures created";
         for(const material_data& mat_data : data.materials) {
             materials[mat_data.name] = mat_data;
@@ -45,9 +63,33 @@ namespace nova::renderer {
         shaderpack_loaded = true;
     }
 
-    void vulkan_render_engine::create_textures(const std::vector<texture_resource_data>& texture_datas) {
+    void vulkan_render_engine::create_textures(const std::vector<texture_resource_data>& texture_datas,
+                                               const std::vector<render_pass_data>& passes) {
+        std::unordered_map<std::string, texture_resource_data> texture_datas_by_name;
+        texture_datas_by_name.reserve(texture_datas.size());
+        for(const texture_resource_data& texture_data : texture_datas) {
+            texture_datas_by_name[texture_data.name] = texture_data;
+        }
+
+        std::unordered_map<std::string, range> resource_used_range;
+        std::vector<std::string> resources_in_order;
+        determine_usage_order_of_textures(passes, resource_used_range, resources_in_order);
+
+        const std::unordered_map<std::string, std::string> aliases = determine_aliasing_of_textures(texture_datas_by_name,
+                                                                                                    resource_used_range,
+                                                                                                    resources_in_order);
+
+        // Every texture, grouped by the texture whose memory the group shares
+        std::unordered_map<std::string, std::vector<std::string>> alias_groups;
+        for(const texture_resource_data& texture_data : texture_datas) {
+            const auto alias = aliases.find(texture_data.name);
+            alias_groups[alias == aliases.end() ? texture_data.name : alias->second].push_back(texture_data.name);
+        }
+
         const VkExtent2D swapchain_extent = swapchain->get_swapchain_extent();
         const glm::uvec2 swapchain_extent_glm = {swapchain_extent.width, swapchain_extent.height};
+        std::unordered_map<std::string, VkMemoryRequirements> memory_requirements;
+        memory_requirements.reserve(texture_datas.size());
         for(const texture_resource_data& texture_data : texture_datas) {
             vk_texture texture;
             texture.is_dynamic = true;
@@ -69,6 +111,7 @@ namespace nova::renderer {
             image_create_info.usage = VK_IMAGE_USAGE_SAMPLED_BIT;
             if(texture.format == VK_FORMAT_D24_UNORM_S8_UINT || texture.format == VK_FORMAT_D32_SFLOAT) {
                 image_create_info.usage |= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+                texture.is_depth_tex = true;
             } else {
                 image_create_info.usage |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
             }
@@ -76,25 +119,73 @@ namespace nova::renderer {
             image_create_info.pQueueFamilyIndices = &graphics_family_index;
             image_create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 
+            // Memory is bound below, once we know which textures share it
+            NOVA_CHECK_RESULT(vkCreateImage(device, &image_create_info, nullptr, &texture.image));
+            vkGetImageMemoryRequirements(device, texture.image, &memory_requirements[texture_data.name]);
+
+            textures[texture_data.name] = texture;
+        }
+
+        VkDeviceSize unaliased_size = 0;
+        VkDeviceSize aliased_size = 0;
+        for(const auto& [root_name, group] : alias_groups) {
+            // The memory has to fit every texture in the group
+            VkMemoryRequirements group_requirements = {};
+            group_requirements.memoryTypeBits = ~0U;
+            for(const std::string& texture_name : group) {
+                const VkMemoryRequirements& requirements = memory_requirements.at(texture_name);
+                group_requirements.size = std::max(group_requirements.size, requirements.size);
+                group_requirements.alignment = std::max(group_requirements.alignment, requirements.alignment);
+                group_requirements.memoryTypeBits &= requirements.memoryTypeBits;
+
+                unaliased_size += requirements.size;
+            }
+
             VmaAllocationCreateInfo alloc_create_info = {};
             alloc_create_info.flags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
             alloc_create_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
             alloc_create_info.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-            alloc_create_info.preferredFlags = 0;
-            alloc_create_info.memoryTypeBits = 0;
-            alloc_create_info.pool = nullptr;
-            alloc_create_info.pUserData = nullptr;
 
-            vmaCreateImage(vma_allocator, &image_create_info, &alloc_create_info, &texture.image, &texture.allocation, &texture.vma_info);
+            VmaAllocation allocation;
+            VmaAllocationInfo allocation_info;
+            NOVA_CHECK_RESULT(vmaAllocateMemory(vma_allocator, &group_requirements, &alloc_create_info, &allocation, &allocation_info));
+            gpu_memory->add(memory_category::DynamicTextures, allocation_info.size);
+            aliased_size += allocation_info.size;
+
+            for(const std::string& texture_name : group) {
+                vk_texture& texture = textures.at(texture_name);
+                texture.allocation = allocation;
+                texture.vma_info = allocation_info;
+                NOVA_CHECK_RESULT(vmaBindImageMemory(vma_allocator, allocation, texture.image));
+
+                // Other textures use the memory between this texture's uses in two frames, so the first pass to use it
+                // each frame has to start over with it
+                if(group.size() > 1) {
+                    const uint32_t first_pass_idx = resource_used_range.at(texture_name).first_used_pass();
+                    aliased_textures_by_first_pass[passes.at(first_pass_idx).name].push_back(texture_name);
+                }
+            }
+
+            if(group.size() > 1) {
+                NOVA_LOG(DEBUG) << group.size() << " textures share the memory of dynamic texture " << root_name;
+            }
+        }
+
+        NOVA_LOG(INFO) << fmt::format(fmt("Aliasing dynamic textures saved {:.1f} MB of VRAM: they use {:.1f} MB instead of {:.1f} MB"),
+                                      static_cast<double>(unaliased_size - aliased_size) / (1024 * 1024),
+                                      static_cast<double>(aliased_size) / (1024 * 1024),
+                                      static_cast<double>(unaliased_size) / (1024 * 1024));
+
+        for(const texture_resource_data& texture_data : texture_datas) {
+            vk_texture& texture = textures.at(texture_data.name);
 
             VkImageViewCreateInfo image_view_create_info = {};
             image_view_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
             image_view_create_info.image = texture.image;
             image_view_create_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
-            image_view_create_info.format = image_create_info.format;
-            if(texture.format == VK_FORMAT_D24_UNORM_S8_UINT || texture.format == VK_FORMAT_D32_SFLOAT) {
+            image_view_create_info.format = texture.format;
+            if(texture.is_depth_tex) {
                 image_view_create_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-                texture.is_depth_tex = true;
             } else {
                 image_view_create_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
             }
@@ -114,8 +205,6 @@ namespace nova::renderer {
                 NOVA_CHECK_RESULT(vkSetDebugUtilsObjectNameEXT(device, &object_name));
                 NOVA_LOG(INFO) << "Set image " << texture.image << " to have name " << texture_data.name;
             }
-
-            textures[texture_data.name] = texture;
         }
 
         dynamic_textures_need_to_transition = true;
@@ -124,8 +213,6 @@ namespace nova::renderer {
     void vulkan_render_engine::create_render_passes(const std::vector<render_pass_data>& passes) {
         NOVA_LOG(DEBUG) << "Flattening frame graph...";
 
-        std::unordered_map<std::string, render_pass_data> regular_render_passes;
-        regular_render_passes.reserve(passes.size());
         render_passes.reserve(passes.size());
         for(const render_pass_data& pass_data : passes) {
             render_passes[pass_data.name].data = pass_data;
@@ -134,11 +221,8 @@ namespace nova::renderer {
             fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
             vkCreateFence(device, &fence_info, nullptr, &render_passes[pass_data.name].fence);
-            regular_render_passes[pass_data.name] = pass_data;
         }
 
-        render_passes_by_order = order_passes(regular_render_passes);
-
         const VkExtent2D swapchain_extent = swapchain->get_swapchain_extent();
 
         for(const auto& [pass_name, pass] : render_passes) {
@@ -841,7 +925,7 @@ namespace nova::renderer {
 
             } else if(resource_name == "NovaModelMatrixBuffer") {
                 NOVA_LOG(TRACE) << "Binding buffer NovaModelMatrixBuffer to descriptor (" << write.dstSet << "." << write.dstBinding << ")";
-                write_buffer_to_descriptor(model_matrix_buffer.buffer, write, buffer_infos, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+                write_buffer_to_descriptor(transient_data->get_buffer(), write, buffer_infos, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
 
             } else if(resource_name == "NovaPerFrameUBO") {
                 NOVA_LOG(TRACE) << "Binding buffer NovaPerFrameUBO to descriptor (" << write.dstSet << "." << write.dstBinding << ")";
@@ -893,10 +977,50 @@ namespace nova::renderer {
     void vulkan_render_engine::generate_barriers_for_dynamic_resources() {
         for(auto& [name, pass] : render_passes) {
             (void) name;
+            create_aliasing_barriers_for_renderpass(pass);
             create_barriers_for_renderpass(pass);
         }
     }
 
+    void vulkan_render_engine::create_aliasing_barriers_for_renderpass(vk_render_pass& pass) {
+        const auto aliased_textures = aliased_textures_by_first_pass.find(pass.data.name);
+        if(aliased_textures == aliased_textures_by_first_pass.end()) {
+            return;
+        }
+
+        for(const std::string& tex_name : aliased_textures->second) {
+            const vk_texture& tex = textures.at(tex_name);
+
+            // Whatever is in the memory belongs to the texture that used it last, so throw it away
+            VkImageMemoryBarrier barrier = {};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            barrier.srcQueueFamilyIndex = graphics_family_index;
+            barrier.dstQueueFamilyIndex = graphics_family_index;
+            barrier.image = tex.image;
+            barrier.subresourceRange.baseMipLevel = 0;
+            barrier.subresourceRange.levelCount = 1;
+            barrier.subresourceRange.baseArrayLayer = 0;
+            barrier.subresourceRange.layerCount = 1;
+
+            // Textures only share memory with textures of the same format, so the last texture to use the memory was
+            // written the same way as this one
+            if(tex.is_depth_tex) {
+                barrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+                barrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+                barrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+                barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+            } else {
+                barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+                barrier.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+                barrier.newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+                barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            }
+
+            pass.aliasing_barriers.push_back(barrier);
+        }
+    }
+
     void vulkan_render_engine::create_barriers_for_renderpass(vk_render_pass& pass) {
         /*
          * For each renderpass:
@@ -1002,12 +1126,19 @@ namespace nova::renderer {
             pass.read_texture_barriers.push_back(barrier);
         }
 
+        const auto aliased_textures = aliased_textures_by_first_pass.find(pass.data.name);
         for(const auto& [tex_name, _] : write_texture_barrier_necessity) {
             (void) _;
             if(tex_name == "Backbuffer") {
                 continue;
             }
 
+            // The aliasing barrier already puts the texture in the right layout
+            if(aliased_textures != aliased_textures_by_first_pass.end() &&
+               std::find(aliased_textures->second.begin(), aliased_textures->second.end(), tex_name) != aliased_textures->second.end()) {
+                continue;
+            }
+
             VkImage image = textures.at(tex_name).image;
 
             VkImageMemoryBarrier barrier = {};
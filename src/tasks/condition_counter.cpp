@@ -1,42 +1,114 @@
 #include "condition_counter.hpp"
 
+#include "fiber.hpp"
+
 namespace nova::ttl {
-    condition_counter::condition_counter(uint32_t initial_value) : counter(initial_value) {}
+    condition_counter::condition_counter(const uint32_t initial_value) : state(initial_value) {}
 
     void condition_counter::add(const uint32_t num) {
-        bool should_trigger = false;
-        {
-            std::unique_lock l(mut);
-            counter += num;
-            should_trigger = counter == wait_val;
-        }
+        const uint64_t new_state = state.fetch_add(num, std::memory_order_acq_rel) + num;
 
-        if(should_trigger) {
-            cv.notify_all();
+        if(new_state >= ONE_WAITER) {
+            wake_waiters(static_cast<uint32_t>(new_state & VALUE_MASK));
         }
     }
 
     void condition_counter::sub(const uint32_t num) {
-        bool should_trigger;
-        {
-            std::unique_lock l(mut);
-            counter -= (counter < num) ? counter : num;
-            should_trigger = counter == wait_val;
-        }
+        uint64_t old_state = state.load(std::memory_order_relaxed);
+        uint64_t new_state;
+        do {
+            const auto value = static_cast<uint32_t>(old_state & VALUE_MASK);
+            new_state = old_state - ((value < num) ? value : num);
+        } while(!state.compare_exchange_weak(old_state, new_state, std::memory_order_acq_rel, std::memory_order_relaxed));
 
-        if(should_trigger) {
-            cv.notify_all();
+        if(new_state >= ONE_WAITER) {
+            wake_waiters(static_cast<uint32_t>(new_state & VALUE_MASK));
         }
     }
 
     void condition_counter::wait_for_value(const uint32_t val) {
-        wait_val = val;
+        if((state.load(std::memory_order_acquire) & VALUE_MASK) == val) {
+            return;
+        }
+
+        fiber* current_fiber = fiber::get_current();
+        waiter self{val, current_fiber};
+
+        std::unique_lock l(waiters_mutex);
+
+        // Register before checking the value again. Whoever changes the value after this sees that someone is
+        // waiting, and has to take the mutex we're holding to wake us up
+        const uint64_t registered_state = state.fetch_add(ONE_WAITER, std::memory_order_seq_cst) + ONE_WAITER;
+        if((registered_state & VALUE_MASK) == val) {
+            state.fetch_sub(ONE_WAITER, std::memory_order_relaxed);
+            return;
+        }
+
+        self.next = waiters;
+        waiters = &self;
+
+        if(current_fiber != nullptr) {
+            l.unlock();
+
+            // Whoever brings the counter to `val` makes the fiber ready, and its worker resumes it from here. The
+            // worker can't resume it before it's yielded, because it's busy running this fiber
+            current_fiber->yield();
+
+        } else {
+            waiters_cv.wait(l, [&] { return self.is_ready; });
+        }
+    }
+
+    uint32_t condition_counter::get_value() const { return static_cast<uint32_t>(state.load(std::memory_order_acquire) & VALUE_MASK); }
+
+    void condition_counter::wake_waiters(const uint32_t value) {
+        // Fibers get made ready after we're done with the counter, since whoever they belong to could destroy it
+        // as soon as they're resumed
+        waiter* ready_fibers = nullptr;
 
         {
-            std::unique_lock l(mut);
-            // I want to explicitly copy wait_val so that the same condition variable can be waited on for different
-            // values, but I need to copy counter by reference
-            cv.wait(l, [&, this] { return counter == this->wait_val; });
+            std::lock_guard l(waiters_mutex);
+
+            uint64_t num_woken = 0;
+            bool should_notify = false;
+
+            waiter** link = &waiters;
+            while(*link != nullptr) {
+                waiter* current = *link;
+                if(current->value != value) {
+                    link = &current->next;
+                    continue;
+                }
+
+                *link = current->next;
+                num_woken++;
+
+                if(current->waiting_fiber != nullptr) {
+                    current->next = ready_fibers;
+                    ready_fibers = current;
+
+                } else {
+                    current->is_ready = true;
+                    should_notify = true;
+                }
+            }
+
+            if(num_woken > 0) {
+                state.fetch_sub(num_woken * ONE_WAITER, std::memory_order_relaxed);
+            }
+
+            // Notify while holding the lock, otherwise a woken thread could return and destroy this counter before
+            // we notify
+            if(should_notify) {
+                waiters_cv.notify_all();
+            }
+        }
+
+        while(ready_fibers != nullptr) {
+            // The waiter lives on the fiber's stack, so read everything we need before it can carry on
+            waiter* current = ready_fibers;
+            ready_fibers = current->next;
+            current->waiting_fiber->make_ready();
         }
     }
 } // namespace nova::ttl
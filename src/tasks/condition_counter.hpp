@@ -1,14 +1,23 @@
 #pragma once
 
+#include <atomic>
 #include <condition_variable>
 #include <cstdint>
 #include <mutex>
 
 namespace nova::ttl {
+    class fiber;
+
     /*!
      * \brief An atomic counter that can be waited on
      *
-     * Brought to you by std::condition_variable, std::mutex, and uint32_t
+     * The value of the counter and the number of threads waiting on it share a single atomic word, so `add` and `sub`
+     * are a single atomic operation when nobody is waiting. Waiters register themselves under a mutex, and when the
+     * word says someone is waiting, `add` and `sub` take that mutex to wake up the waiters whose target value they
+     * just reached. Several waiters may wait for different values at the same time
+     *
+     * Tasks which wait on a condition_counter don't block the thread they run on. Their fiber is suspended, and the
+     * worker thread goes off to run other tasks until the counter reaches the value the task is waiting for
      *
      * Internal value starts at 0
      */
@@ -16,6 +25,14 @@ namespace nova::ttl {
     public:
         explicit condition_counter(uint32_t initial_value = 0);
 
+        condition_counter(condition_counter&& other) noexcept = delete;
+        condition_counter& operator=(condition_counter&& other) noexcept = delete;
+
+        condition_counter(const condition_counter& other) = delete;
+        condition_counter& operator=(const condition_counter& other) = delete;
+
+        ~condition_counter() = default;
+
         /*!
          * \brief Atomically adds `num` to this boi
          */
@@ -28,14 +45,50 @@ namespace nova::ttl {
 
         /*!
          * \brief Waits for the value of this condition_counter to become equal to `val`
+         *
+         * Returns once an `add` or `sub` makes the counter equal to `val`, even if another `add` or `sub` has changed
+         * it again since. If called from a task running on a fiber, suspends the fiber instead of blocking the thread
          */
         void wait_for_value(uint32_t val);
 
+        [[nodiscard]] uint32_t get_value() const;
+
     private:
-        std::mutex mut;
-        std::condition_variable cv;
+        constexpr static uint64_t VALUE_MASK = 0xFFFFFFFF;
+        constexpr static uint64_t ONE_WAITER = uint64_t{1} << 32;
+
+        /*!
+         * \brief A thread or fiber that's waiting for the counter to reach a value. Lives on the waiter's stack
+         */
+        struct waiter {
+            uint32_t value;
+
+            /*!
+             * \brief The fiber to make ready, or nullptr if the waiter is a thread sleeping on `waiters_cv`
+             */
+            fiber* waiting_fiber;
+
+            bool is_ready = false;
 
-        uint32_t counter = 0;
-        uint32_t wait_val = 0;
+            waiter* next = nullptr;
+        };
+
+        /*!
+         * \brief The value of the counter in the low 32 bits, and the number of registered waiters in the high 32 bits
+         */
+        std::atomic<uint64_t> state;
+
+        std::mutex waiters_mutex;
+        std::condition_variable waiters_cv;
+
+        /*!
+         * \brief Everyone waiting on this counter. Guarded by `waiters_mutex`
+         */
+        waiter* waiters = nullptr;
+
+        /*!
+         * \brief Wakes up everyone who's waiting for `value`
+         */
+        void wake_waiters(uint32_t value);
     };
 } // namespace nova::ttl
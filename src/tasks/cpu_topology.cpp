@@ -0,0 +1,222 @@
+#include "cpu_topology.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <optional>
+#include <sstream>
+#include <tuple>
+
+#include "nova_renderer/util/platform.hpp"
+
+#ifdef NOVA_LINUX
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace nova::ttl {
+    namespace {
+        [[maybe_unused]] std::optional<std::string> read_line(const std::string& path) {
+            std::ifstream file(path);
+            std::string line;
+            if(!file || !std::getline(file, line)) {
+                return {};
+            }
+
+            return line;
+        }
+
+        [[maybe_unused]] std::optional<uint32_t> read_uint(const std::string& path) {
+            const std::optional<std::string> line = read_line(path);
+            if(!line) {
+                return {};
+            }
+
+            try {
+                return static_cast<uint32_t>(std::stoul(*line));
+            }
+            catch(const std::exception&) {
+                return {};
+            }
+        }
+
+        /*!
+         * \brief Finds the lowest-numbered CPU which shares `cpu_id`'s highest-level cache
+         */
+        [[maybe_unused]] uint32_t find_llc_id(const uint32_t cpu_id) {
+            const std::string cache_dir = "/sys/devices/system/cpu/cpu" + std::to_string(cpu_id) + "/cache/index";
+
+            uint32_t highest_level = 0;
+            uint32_t llc_id = cpu_id;
+            for(uint32_t index = 0;; index++) {
+                const std::optional<uint32_t> level = read_uint(cache_dir + std::to_string(index) + "/level");
+                if(!level) {
+                    break;
+                }
+
+                const std::optional<std::string> shared_cpus = read_line(cache_dir + std::to_string(index) + "/shared_cpu_list");
+                if(*level < highest_level || !shared_cpus) {
+                    continue;
+                }
+
+                const std::vector<uint32_t> sharing_cpus = parse_cpu_list(*shared_cpus);
+                if(!sharing_cpus.empty()) {
+                    highest_level = *level;
+                    llc_id = *std::min_element(sharing_cpus.begin(), sharing_cpus.end());
+                }
+            }
+
+            return llc_id;
+        }
+    } // namespace
+
+    cpu_distance get_distance(const logical_cpu& a, const logical_cpu& b) {
+        if(a.id == b.id) {
+            return cpu_distance::SAME_CPU;
+        }
+
+        if(a.package_id != b.package_id) {
+            return cpu_distance::REMOTE;
+        }
+
+        if(a.core_id == b.core_id) {
+            return cpu_distance::SMT_SIBLING;
+        }
+
+        if(a.llc_id == b.llc_id) {
+            return cpu_distance::SAME_LLC;
+        }
+
+        return cpu_distance::SAME_PACKAGE;
+    }
+
+    std::vector<logical_cpu> read_cpu_topology() {
+        std::vector<logical_cpu> cpus;
+
+#ifdef NOVA_LINUX
+        const std::optional<std::string> online = read_line("/sys/devices/system/cpu/online");
+        if(!online) {
+            return cpus;
+        }
+
+        for(const uint32_t cpu_id : parse_cpu_list(*online)) {
+            const std::string topology_dir = "/sys/devices/system/cpu/cpu" + std::to_string(cpu_id) + "/topology/";
+
+            logical_cpu cpu;
+            cpu.id = cpu_id;
+            cpu.core_id = read_uint(topology_dir + "core_id").value_or(cpu_id);
+            cpu.package_id = read_uint(topology_dir + "physical_package_id").value_or(0);
+            cpu.llc_id = find_llc_id(cpu_id);
+
+            cpus.push_back(cpu);
+        }
+
+        if(const std::vector<uint32_t> allowed_cpus = get_allowed_cpus(); !allowed_cpus.empty()) {
+            cpus = filter_cpus(cpus, allowed_cpus);
+        }
+#endif
+
+        return cpus;
+    }
+
+    std::vector<uint32_t> get_allowed_cpus() {
+        std::vector<uint32_t> cpu_ids;
+
+#ifdef NOVA_LINUX
+        cpu_set_t cpu_set;
+        CPU_ZERO(&cpu_set);
+        if(sched_getaffinity(0, sizeof(cpu_set), &cpu_set) != 0) {
+            return cpu_ids;
+        }
+
+        for(uint32_t cpu_id = 0; cpu_id < CPU_SETSIZE; cpu_id++) {
+            if(CPU_ISSET(cpu_id, &cpu_set)) {
+                cpu_ids.push_back(cpu_id);
+            }
+        }
+#endif
+
+        return cpu_ids;
+    }
+
+    std::vector<logical_cpu> filter_cpus(const std::vector<logical_cpu>& cpus, const std::vector<uint32_t>& allowed_cpu_ids) {
+        std::vector<logical_cpu> allowed_cpus;
+        std::copy_if(cpus.begin(), cpus.end(), std::back_inserter(allowed_cpus), [&](const logical_cpu& cpu) {
+            return std::find(allowed_cpu_ids.begin(), allowed_cpu_ids.end(), cpu.id) != allowed_cpu_ids.end();
+        });
+
+        return allowed_cpus;
+    }
+
+    std::vector<logical_cpu> place_workers(const std::vector<logical_cpu>& cpus, const uint32_t num_workers) {
+        std::vector<logical_cpu> placement;
+        if(cpus.empty()) {
+            return placement;
+        }
+
+        // Group SMT siblings by their core, with the cores ordered so that cores sharing a package and a cache are
+        // next to each other
+        std::map<std::tuple<uint32_t, uint32_t, uint32_t>, std::vector<logical_cpu>> cpus_by_core;
+        for(const logical_cpu& cpu : cpus) {
+            cpus_by_core[{cpu.package_id, cpu.llc_id, cpu.core_id}].push_back(cpu);
+        }
+
+        // The first CPU of every core, then the second CPU of every core, and so on
+        std::vector<logical_cpu> order;
+        order.reserve(cpus.size());
+        for(std::size_t sibling = 0; order.size() < cpus.size(); sibling++) {
+            for(const auto& [core, siblings] : cpus_by_core) {
+                if(sibling < siblings.size()) {
+                    order.push_back(siblings[sibling]);
+                }
+            }
+        }
+
+        placement.reserve(num_workers);
+        for(uint32_t i = 0; i < num_workers; i++) {
+            placement.push_back(order[i % order.size()]);
+        }
+
+        return placement;
+    }
+
+    std::vector<uint32_t> parse_cpu_list(const std::string& list) {
+        std::vector<uint32_t> cpu_ids;
+
+        std::stringstream ss(list);
+        std::string range;
+        while(std::getline(ss, range, ',')) {
+            try {
+                const std::size_t dash = range.find('-');
+                if(dash == std::string::npos) {
+                    cpu_ids.push_back(static_cast<uint32_t>(std::stoul(range)));
+
+                } else {
+                    const auto first = static_cast<uint32_t>(std::stoul(range.substr(0, dash)));
+                    const auto last = static_cast<uint32_t>(std::stoul(range.substr(dash + 1)));
+                    for(uint32_t cpu_id = first; cpu_id <= last; cpu_id++) {
+                        cpu_ids.push_back(cpu_id);
+                    }
+                }
+            }
+            catch(const std::exception&) {
+                // Blank or malformed ranges, like the newline at the end of a sysfs file, don't name any CPUs
+            }
+        }
+
+        return cpu_ids;
+    }
+
+    bool pin_current_thread_to_cpu([[maybe_unused]] const uint32_t cpu_id) {
+#ifdef NOVA_LINUX
+        cpu_set_t cpu_set;
+        CPU_ZERO(&cpu_set);
+        CPU_SET(cpu_id, &cpu_set);
+
+        return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set) == 0;
+#else
+        return false;
+#endif
+    }
+} // namespace nova::ttl
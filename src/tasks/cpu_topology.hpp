@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace nova::ttl {
+    /*!
+     * \brief Where a logical CPU sits in the machine
+     */
+    struct logical_cpu {
+        /*!
+         * \brief The number the OS knows this CPU by, e.g. the N in /sys/devices/system/cpu/cpuN
+         */
+        uint32_t id = 0;
+
+        /*!
+         * \brief The physical core this CPU belongs to. SMT siblings share a core
+         *
+         * Core IDs are only unique within a package
+         */
+        uint32_t core_id = 0;
+
+        /*!
+         * \brief The socket this CPU is in
+         */
+        uint32_t package_id = 0;
+
+        /*!
+         * \brief Identifies the last-level cache this CPU uses. CPUs with the same `llc_id` share their last-level cache
+         *
+         * This is the lowest-numbered CPU that shares the cache
+         */
+        uint32_t llc_id = 0;
+    };
+
+    /*!
+     * \brief How close two CPUs are, as far as sharing cached data goes. Lower is closer
+     */
+    enum class cpu_distance {
+        SAME_CPU,
+        SMT_SIBLING,
+        SAME_LLC,
+        SAME_PACKAGE,
+        REMOTE,
+    };
+
+    [[nodiscard]] cpu_distance get_distance(const logical_cpu& a, const logical_cpu& b);
+
+    /*!
+     * \brief Reads the online CPUs and how they're laid out from /sys/devices/system/cpu
+     *
+     * CPUs that the calling thread isn't allowed to run on, e.g. because of taskset or a cgroup cpuset, are left out,
+     * since a worker pinned to one of them couldn't run at all
+     *
+     * \return Every online CPU that the calling thread may run on, ordered by ID, or an empty vector if the topology
+     * can't be read on this platform
+     */
+    [[nodiscard]] std::vector<logical_cpu> read_cpu_topology();
+
+    /*!
+     * \brief Gets the IDs of the CPUs that the calling thread is allowed to run on. Threads that it creates inherit this
+     *
+     * \return The allowed CPU IDs in increasing order, or an empty vector if they can't be read on this platform
+     */
+    [[nodiscard]] std::vector<uint32_t> get_allowed_cpus();
+
+    /*!
+     * \brief Keeps only the CPUs whose IDs are in `allowed_cpu_ids`
+     */
+    [[nodiscard]] std::vector<logical_cpu> filter_cpus(const std::vector<logical_cpu>& cpus, const std::vector<uint32_t>& allowed_cpu_ids);
+
+    /*!
+     * \brief Picks a CPU for each of `num_workers` workers
+     *
+     * Workers are spread over physical cores before any core gets a second worker on its SMT sibling. Neighbouring
+     * worker indices get neighbouring cores, so workers that share a last-level cache and a package have consecutive
+     * indices. If there are more workers than CPUs, CPUs are reused from the start
+     *
+     * \return The CPU for each worker, or an empty vector if `cpus` is empty
+     */
+    [[nodiscard]] std::vector<logical_cpu> place_workers(const std::vector<logical_cpu>& cpus, uint32_t num_workers);
+
+    /*!
+     * \brief Parses a CPU list in the kernel's format, like "0-3,8,10-11"
+     */
+    [[nodiscard]] std::vector<uint32_t> parse_cpu_list(const std::string& list);
+
+    /*!
+     * \brief Restricts the calling thread to run on a single CPU
+     *
+     * \return True if the thread was pinned, false if pinning failed or isn't supported on this platform
+     */
+    bool pin_current_thread_to_cpu(uint32_t cpu_id);
+} // namespace nova::ttl
@@ -0,0 +1,93 @@
+#include "event_count.hpp"
+
+#include <climits>
+
+#ifdef NOVA_LINUX
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace nova::ttl {
+#ifdef NOVA_LINUX
+    namespace {
+        void futex_wait(std::atomic<uint32_t>* word, const uint32_t expected_value) {
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg)
+            syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAIT_PRIVATE, expected_value, nullptr, nullptr, 0);
+        }
+
+        void futex_wake(std::atomic<uint32_t>* word, const int num_to_wake) {
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg)
+            syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAKE_PRIVATE, num_to_wake, nullptr, nullptr, 0);
+        }
+    } // namespace
+#endif
+
+    uint32_t event_count::prepare_wait() {
+        num_waiters.fetch_add(1, std::memory_order_seq_cst);
+        const uint32_t key = epoch.load(std::memory_order_seq_cst);
+
+        // The caller re-checks its condition after this, and those loads must not be reordered before the waiter
+        // count is published, or a notifier could miss us
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        return key;
+    }
+
+    void event_count::cancel_wait() { num_waiters.fetch_sub(1, std::memory_order_relaxed); }
+
+    void event_count::wait(const uint32_t key) {
+#ifdef NOVA_LINUX
+        while(epoch.load(std::memory_order_acquire) == key) {
+            futex_wait(&epoch, key);
+        }
+#else
+        {
+            std::unique_lock l(sleep_mutex);
+            sleep_cv.wait(l, [&] { return epoch.load(std::memory_order_acquire) != key; });
+        }
+#endif
+
+        num_waiters.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    void event_count::notify_one() { notify(1); }
+
+    void event_count::notify_all() { notify(UINT32_MAX); }
+
+    void event_count::notify_n(const uint32_t count) {
+        if(count > 0) {
+            notify(count);
+        }
+    }
+
+    uint32_t event_count::get_num_waiters() const { return num_waiters.load(std::memory_order_relaxed); }
+
+    void event_count::notify(const uint32_t num_to_wake) {
+        // Pairs with the fence in prepare_wait. Either we see the waiter, or the waiter sees whatever the caller did
+        // before notifying
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(num_waiters.load(std::memory_order_relaxed) == 0) {
+            return;
+        }
+
+#ifdef NOVA_LINUX
+        epoch.fetch_add(1, std::memory_order_seq_cst);
+        futex_wake(&epoch, num_to_wake > INT_MAX ? INT_MAX : static_cast<int>(num_to_wake));
+#else
+        {
+            // Bump the epoch under the lock so a waiter can't check it and then miss the notification
+            std::lock_guard l(sleep_mutex);
+            epoch.fetch_add(1, std::memory_order_seq_cst);
+        }
+
+        if(num_to_wake >= num_waiters.load(std::memory_order_relaxed)) {
+            sleep_cv.notify_all();
+        } else {
+            for(uint32_t i = 0; i < num_to_wake; i++) {
+                sleep_cv.notify_one();
+            }
+        }
+#endif
+    }
+} // namespace nova::ttl
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+#include "nova_renderer/util/platform.hpp"
+
+namespace nova::ttl {
+    /*!
+     * \brief Lets threads sleep until something happens, without a lock on the notifying side
+     *
+     * An eventcount is a condition variable for lock-free data structures. A thread that wants to wait for a
+     * condition first calls `prepare_wait`, then checks the condition again. If the condition still doesn't hold, it
+     * calls `wait` with the key from `prepare_wait`, otherwise it calls `cancel_wait`. A thread that makes the
+     * condition true calls `notify_one` or `notify_all` afterwards. Any notification that happens after
+     * `prepare_wait` wakes the waiter, so wake-ups can't be lost between checking the condition and going to sleep
+     *
+     * Notifying when no threads are waiting is a fence and a load, nothing more. On Linux, waiting threads sleep on a
+     * futex. Other platforms use a mutex and a condition variable, which are only touched when someone is waiting
+     */
+    class event_count {
+    public:
+        event_count() = default;
+
+        event_count(event_count&& other) noexcept = delete;
+        event_count& operator=(event_count&& other) noexcept = delete;
+
+        event_count(const event_count& other) = delete;
+        event_count& operator=(const event_count& other) = delete;
+
+        ~event_count() = default;
+
+        /*!
+         * \brief Registers the calling thread as a waiter
+         *
+         * \return The key to pass to `wait`
+         */
+        uint32_t prepare_wait();
+
+        /*!
+         * \brief Unregisters the calling thread as a waiter, because the condition it was waiting for came true
+         */
+        void cancel_wait();
+
+        /*!
+         * \brief Sleeps until someone calls `notify_one` or `notify_all`, unless they already have since the call to
+         * `prepare_wait` which returned `key`
+         */
+        void wait(uint32_t key);
+
+        /*!
+         * \brief Wakes up one waiting thread, if there are any
+         */
+        void notify_one();
+
+        /*!
+         * \brief Wakes up all waiting threads
+         */
+        void notify_all();
+
+        /*!
+         * \brief Wakes up `count` waiting threads, or every waiting thread if there are fewer than that
+         */
+        void notify_n(uint32_t count);
+
+        /*!
+         * \brief Gets the number of threads that have called `prepare_wait` but have not yet been woken up
+         */
+        [[nodiscard]] uint32_t get_num_waiters() const;
+
+    private:
+        /*!
+         * \brief Incremented by every notification that had someone to notify. This is the word that waiters sleep on
+         */
+        std::atomic<uint32_t> epoch = 0;
+
+        std::atomic<uint32_t> num_waiters = 0;
+
+#ifndef NOVA_LINUX
+        std::mutex sleep_mutex;
+        std::condition_variable sleep_cv;
+#endif
+
+        void notify(uint32_t num_to_wake);
+    };
+} // namespace nova::ttl
@@ -0,0 +1,214 @@
+#include "fiber.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <new>
+
+#include "nova_renderer/util/platform.hpp"
+
+#if defined(NOVA_LINUX)
+#include <sys/mman.h>
+#include <unistd.h>
+
+#if !defined(__x86_64__)
+#include <ucontext.h>
+#endif
+
+#elif defined(NOVA_WINDOWS)
+#include "../util/windows.hpp"
+#endif
+
+#if defined(__SANITIZE_THREAD__)
+#define NOVA_TTL_TSAN
+#elif defined(__has_feature)
+#if __has_feature(thread_sanitizer)
+#define NOVA_TTL_TSAN
+#endif
+#endif
+
+#ifdef NOVA_TTL_TSAN
+#include <sanitizer/tsan_interface.h>
+#endif
+
+#if defined(NOVA_LINUX) && defined(__x86_64__)
+/*
+ * Saves the callee-saved registers and the SSE and x87 control words on the current stack, stores the stack pointer
+ * in `*from_stack_pointer`, then does the reverse with `to_stack_pointer`. Everything else is caller-saved in the
+ * System V ABI, so the compiler has already saved it if it cares
+ *
+ * void nova_ttl_switch_stack(void** from_stack_pointer, void* to_stack_pointer)
+ */
+asm(R"(
+    .text
+    .p2align 4
+    .globl nova_ttl_switch_stack
+    .hidden nova_ttl_switch_stack
+    .type nova_ttl_switch_stack, @function
+nova_ttl_switch_stack:
+    pushq %rbp
+    pushq %rbx
+    pushq %r12
+    pushq %r13
+    pushq %r14
+    pushq %r15
+    subq $8, %rsp
+    stmxcsr (%rsp)
+    fnstcw 4(%rsp)
+
+    movq %rsp, (%rdi)
+    movq %rsi, %rsp
+
+    ldmxcsr (%rsp)
+    fldcw 4(%rsp)
+    addq $8, %rsp
+    popq %r15
+    popq %r14
+    popq %r13
+    popq %r12
+    popq %rbx
+    popq %rbp
+    ret
+    .size nova_ttl_switch_stack, .-nova_ttl_switch_stack
+
+    .p2align 4
+    .globl nova_ttl_fiber_trampoline
+    .hidden nova_ttl_fiber_trampoline
+    .type nova_ttl_fiber_trampoline, @function
+nova_ttl_fiber_trampoline:
+    movq %r12, %rdi
+    callq *%r13
+    ud2
+    .size nova_ttl_fiber_trampoline, .-nova_ttl_fiber_trampoline
+)");
+
+extern "C" void nova_ttl_switch_stack(void** from_stack_pointer, void* to_stack_pointer);
+extern "C" void nova_ttl_fiber_trampoline();
+#endif
+
+namespace nova::ttl {
+    namespace {
+        thread_local fiber* current_fiber = nullptr;
+    } // namespace
+
+    fiber::fiber(const entry_function entry, const ready_function on_ready, void* user_data, const std::size_t stack_size)
+        : entry(entry), on_ready(on_ready), user_data(user_data), stack_size(stack_size) {
+#if defined(NOVA_LINUX)
+        // Put a guard page below the stack, so that overflowing it crashes instead of scribbling over the heap
+        const auto page_size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+        this->stack_size = (stack_size + page_size - 1) / page_size * page_size + page_size;
+
+        stack = mmap(nullptr, this->stack_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+        if(stack == MAP_FAILED) {
+            stack = nullptr;
+            throw std::bad_alloc();
+        }
+        mprotect(stack, page_size, PROT_NONE);
+
+#if defined(__x86_64__)
+        // Lay out the stack as if `nova_ttl_switch_stack` had been called from the start of the trampoline, so that
+        // switching to it for the first time pops our initial register values and returns into the trampoline
+        auto* stack_top = reinterpret_cast<uint64_t*>(static_cast<uint8_t*>(stack) + this->stack_size);
+        uint64_t* frame = stack_top - 8;
+
+        constexpr uint32_t default_mxcsr = 0x1F80;
+        constexpr uint16_t default_fpu_control_word = 0x037F;
+        std::memcpy(reinterpret_cast<uint8_t*>(frame), &default_mxcsr, sizeof(default_mxcsr));
+        std::memcpy(reinterpret_cast<uint8_t*>(frame) + 4, &default_fpu_control_word, sizeof(default_fpu_control_word));
+
+        frame[1] = 0;                                             // r15
+        frame[2] = 0;                                             // r14
+        frame[3] = reinterpret_cast<uint64_t>(&fiber::start);     // r13, the function the trampoline calls
+        frame[4] = reinterpret_cast<uint64_t>(this);              // r12, the argument the trampoline passes
+        frame[5] = 0;                                             // rbx
+        frame[6] = 0;                                             // rbp
+        frame[7] = reinterpret_cast<uint64_t>(&nova_ttl_fiber_trampoline);
+
+        context = frame;
+#else
+        auto* fiber_context = new ucontext_t;
+        getcontext(fiber_context);
+        fiber_context->uc_stack.ss_sp = static_cast<uint8_t*>(stack) + page_size;
+        fiber_context->uc_stack.ss_size = this->stack_size - page_size;
+        fiber_context->uc_link = nullptr;
+        // `resume` sets the current fiber before switching to it, so there's no need to squeeze a pointer through
+        // makecontext's int arguments
+        makecontext(fiber_context, [] { start(get_current()); }, 0);
+
+        context = fiber_context;
+        caller_context = new ucontext_t;
+#endif
+
+#elif defined(NOVA_WINDOWS)
+        context = CreateFiber(stack_size, [](void* param) { start(static_cast<fiber*>(param)); }, this);
+        if(context == nullptr) {
+            throw std::bad_alloc();
+        }
+#endif
+
+#ifdef NOVA_TTL_TSAN
+        sanitizer_fiber = __tsan_create_fiber(0);
+#endif
+    }
+
+    fiber::~fiber() {
+#ifdef NOVA_TTL_TSAN
+        __tsan_destroy_fiber(sanitizer_fiber);
+#endif
+
+#if defined(NOVA_LINUX)
+#if !defined(__x86_64__)
+        delete static_cast<ucontext_t*>(context);
+        delete static_cast<ucontext_t*>(caller_context);
+#endif
+        munmap(stack, stack_size);
+
+#elif defined(NOVA_WINDOWS)
+        DeleteFiber(context);
+#endif
+    }
+
+    void fiber::resume() {
+        current_fiber = this;
+
+#ifdef NOVA_TTL_TSAN
+        sanitizer_caller_fiber = __tsan_get_current_fiber();
+        __tsan_switch_to_fiber(sanitizer_fiber, 0);
+#endif
+
+#if defined(NOVA_LINUX) && defined(__x86_64__)
+        nova_ttl_switch_stack(&caller_context, context);
+#elif defined(NOVA_LINUX)
+        swapcontext(static_cast<ucontext_t*>(caller_context), static_cast<ucontext_t*>(context));
+#elif defined(NOVA_WINDOWS)
+        if(!IsThreadAFiber()) {
+            ConvertThreadToFiber(nullptr);
+        }
+        caller_context = GetCurrentFiber();
+        SwitchToFiber(context);
+#endif
+
+        current_fiber = nullptr;
+    }
+
+    void fiber::yield() {
+#ifdef NOVA_TTL_TSAN
+        __tsan_switch_to_fiber(sanitizer_caller_fiber, 0);
+#endif
+
+#if defined(NOVA_LINUX) && defined(__x86_64__)
+        nova_ttl_switch_stack(&context, caller_context);
+#elif defined(NOVA_LINUX)
+        swapcontext(static_cast<ucontext_t*>(context), static_cast<ucontext_t*>(caller_context));
+#elif defined(NOVA_WINDOWS)
+        SwitchToFiber(caller_context);
+#endif
+    }
+
+    void fiber::make_ready() { on_ready(this); }
+
+    void* fiber::get_user_data() const { return user_data; }
+
+    fiber* fiber::get_current() { return current_fiber; }
+
+    void fiber::start(fiber* self) { self->entry(self); }
+} // namespace nova::ttl
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+
+namespace nova::ttl {
+    /*!
+     * \brief A stack that code can run on, and be suspended and resumed on without blocking the thread it runs on
+     *
+     * A thread calls `resume` to switch from its own stack to the fiber. Code running on the fiber calls `yield` to
+     * switch back, and the thread carries on from where it called `resume`. The next call to `resume` carries on the
+     * fiber from where it called `yield`
+     *
+     * Fibers must only be resumed from a thread's own stack, not from another fiber. They should always be resumed
+     * by the same thread, since the compiler may cache the addresses of thread-local variables across a call to
+     * `yield`
+     *
+     * On Linux x86-64, switching is a handful of instructions that save and restore the callee-saved registers. Other
+     * Linux platforms use ucontext, and Windows uses its own fiber API
+     */
+    class fiber {
+    public:
+        /*!
+         * \brief The function a fiber starts running when it's first resumed. It must never return
+         */
+        using entry_function = void (*)(fiber* self);
+
+        /*!
+         * \brief A function which makes a suspended fiber runnable again
+         */
+        using ready_function = void (*)(fiber* self);
+
+        /*!
+         * \brief Creates a fiber with its own stack
+         *
+         * \param entry The function to run on the fiber. It starts when the fiber is resumed for the first time
+         * \param on_ready Called by `make_ready`, so whoever owns the fiber can arrange for it to be resumed
+         * \param user_data Anything the owner of the fiber wants to associate with it
+         * \param stack_size The size of the fiber's stack, in bytes. Memory is reserved up-front but only committed
+         * when the stack grows into it
+         */
+        fiber(entry_function entry, ready_function on_ready, void* user_data, std::size_t stack_size);
+
+        fiber(fiber&& other) noexcept = delete;
+        fiber& operator=(fiber&& other) noexcept = delete;
+
+        fiber(const fiber& other) = delete;
+        fiber& operator=(const fiber& other) = delete;
+
+        ~fiber();
+
+        /*!
+         * \brief Switches from the calling thread's stack to this fiber. Returns when the fiber calls `yield`
+         */
+        void resume();
+
+        /*!
+         * \brief Switches from this fiber back to the thread that resumed it
+         *
+         * \pre The calling code is running on this fiber
+         */
+        void yield();
+
+        /*!
+         * \brief Tells the owner of this fiber that whatever it was waiting for has happened
+         *
+         * May be called from any thread
+         */
+        void make_ready();
+
+        [[nodiscard]] void* get_user_data() const;
+
+        /*!
+         * \brief Gets the fiber that the calling thread is running on, or nullptr if it's running on its own stack
+         */
+        [[nodiscard]] static fiber* get_current();
+
+    private:
+        entry_function entry;
+        ready_function on_ready;
+        void* user_data;
+
+        void* stack = nullptr;
+        std::size_t stack_size;
+
+        /*!
+         * \brief Platform-specific state of the fiber while it's not running
+         */
+        void* context = nullptr;
+
+        /*!
+         * \brief Platform-specific state of the thread which resumed this fiber, for `yield` to switch back to
+         */
+        void* caller_context = nullptr;
+
+        /*!
+         * \brief Thread sanitizer's handle for this fiber, if the thread sanitizer is enabled
+         */
+        void* sanitizer_fiber = nullptr;
+        void* sanitizer_caller_fiber = nullptr;
+
+        static void start(fiber* self);
+    };
+} // namespace nova::ttl
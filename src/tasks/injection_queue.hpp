@@ -0,0 +1,190 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+
+#include "wait_free_queue.hpp"
+
+namespace nova::ttl {
+    /*!
+     * \brief A first-in, first-out queue that any number of threads may push to and pop from at once
+     *
+     * The scheduler uses this for tasks submitted from threads outside the pool, since only a worker may push to its
+     * own wait_free_queue
+     *
+     * Most of the time this is Dmitry Vyukov's bounded MPMC queue: a ring of cells, each with a sequence number that
+     * says whether the cell is ready to be written or read on the current lap. Pushing and popping each cost one CAS
+     * on the shared position, and producers only contend with each other on that one cache line rather than on a
+     * lock
+     *
+     * If the ring fills up, pushes go to an overflow deque behind a mutex until that deque has drained, so the queue
+     * never rejects an item and items stay in roughly the order they were pushed. Once consumers catch up, the mutex is
+     * never touched
+     */
+    template <typename T>
+    class injection_queue {
+        static_assert(std::is_trivially_copyable_v<T>, "injection_queue is meant for pointers and other small values");
+
+    public:
+        /*!
+         * \brief Creates a queue whose ring holds `capacity` items. `capacity` must be a power of two
+         */
+        explicit injection_queue(const std::size_t capacity = DEFAULT_CAPACITY)
+            : cells(new cell[capacity]), mask(capacity - 1) {
+            assert(capacity >= 2 && (capacity & (capacity - 1)) == 0);
+
+            for(std::size_t i = 0; i < capacity; i++) {
+                cells[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        injection_queue(injection_queue&& other) noexcept = delete;
+        injection_queue& operator=(injection_queue&& other) noexcept = delete;
+
+        injection_queue(const injection_queue& other) = delete;
+        injection_queue& operator=(const injection_queue& other) = delete;
+
+        ~injection_queue() = default;
+
+        /*!
+         * \brief Adds an item to the back of the queue. Safe to call from any thread
+         */
+        void push(const T& value) {
+            // Keep pushing to the overflow until it's empty, otherwise anything stuck there would be overtaken by
+            // everything pushed after it
+            if(num_overflowed.load(std::memory_order_acquire) == 0 && try_push_to_ring(value)) {
+                return;
+            }
+
+            std::lock_guard l(overflow_mutex);
+            overflow.push_back(value);
+            num_overflowed.fetch_add(1, std::memory_order_release);
+        }
+
+        /*!
+         * \brief Takes an item from the front of the queue. Safe to call from any thread
+         *
+         * \param value The memory to write the item to
+         * \return True if there was an item, false if the queue was empty
+         */
+        bool pop(T* value) {
+            if(try_pop_from_ring(value)) {
+                return true;
+            }
+
+            if(num_overflowed.load(std::memory_order_acquire) == 0) {
+                return false;
+            }
+
+            std::lock_guard l(overflow_mutex);
+            if(overflow.empty()) {
+                return false;
+            }
+
+            *value = overflow.front();
+            overflow.pop_front();
+            num_overflowed.fetch_sub(1, std::memory_order_release);
+
+            return true;
+        }
+
+        /*!
+         * \brief Gets the number of items in the queue
+         *
+         * The queue is changing under our feet, so this is only an estimate. It's meant for profiling
+         */
+        [[nodiscard]] std::size_t approximate_count() const {
+            const std::size_t dequeued = dequeue_position.load(std::memory_order_relaxed);
+            const std::size_t enqueued = enqueue_position.load(std::memory_order_relaxed);
+            const std::size_t in_ring = enqueued > dequeued ? enqueued - dequeued : 0;
+
+            return in_ring + num_overflowed.load(std::memory_order_relaxed);
+        }
+
+    private:
+        constexpr static std::size_t DEFAULT_CAPACITY = 4096;
+
+        struct cell {
+            /*!
+             * \brief Equal to the position of the next push to this cell when it's empty, and one past the position
+             * of the next pop from it when it's full
+             */
+            std::atomic<std::size_t> sequence;
+            T data;
+        };
+
+        std::unique_ptr<cell[]> cells;
+        const std::size_t mask;
+
+        alignas(CACHE_LINE_SIZE) std::atomic<std::size_t> enqueue_position = 0;
+        alignas(CACHE_LINE_SIZE) std::atomic<std::size_t> dequeue_position = 0;
+
+        alignas(CACHE_LINE_SIZE) std::atomic<std::size_t> num_overflowed = 0;
+        std::mutex overflow_mutex;
+        std::deque<T> overflow;
+
+        bool try_push_to_ring(const T& value) {
+            std::size_t position = enqueue_position.load(std::memory_order_relaxed);
+            cell* target = nullptr;
+
+            while(true) {
+                target = &cells[position & mask];
+                const std::size_t sequence = target->sequence.load(std::memory_order_acquire);
+                const auto difference = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(position);
+
+                if(difference == 0) {
+                    if(enqueue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                        break;
+                    }
+
+                } else if(difference < 0) {
+                    // The cell still holds an item from the last lap, so the ring is full
+                    return false;
+
+                } else {
+                    position = enqueue_position.load(std::memory_order_relaxed);
+                }
+            }
+
+            target->data = value;
+            target->sequence.store(position + 1, std::memory_order_release);
+
+            return true;
+        }
+
+        bool try_pop_from_ring(T* value) {
+            std::size_t position = dequeue_position.load(std::memory_order_relaxed);
+            cell* source = nullptr;
+
+            while(true) {
+                source = &cells[position & mask];
+                const std::size_t sequence = source->sequence.load(std::memory_order_acquire);
+                const auto difference = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(position + 1);
+
+                if(difference == 0) {
+                    if(dequeue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                        break;
+                    }
+
+                } else if(difference < 0) {
+                    // Nobody has written to the cell on this lap yet, so the ring is empty
+                    return false;
+
+                } else {
+                    position = dequeue_position.load(std::memory_order_relaxed);
+                }
+            }
+
+            *value = source->data;
+            source->sequence.store(position + mask + 1, std::memory_order_release);
+
+            return true;
+        }
+    };
+} // namespace nova::ttl
@@ -0,0 +1,234 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <mutex>
+#include <vector>
+
+#include "task_scheduler.hpp"
+
+/*!
+ * \file parallel_algorithms.hpp
+ *
+ * \brief Data-parallel loops on top of task_scheduler
+ *
+ * Each algorithm splits its range into chunks of `grain_size` elements. If you don't give a grain size, one is picked
+ * so that each participating thread gets several chunks, which keeps things balanced when some elements take longer
+ * than others. Chunks are claimed one at a time from a shared counter by the calling thread and by helper tasks on the
+ * scheduler's workers, so the caller does its share of the work instead of sitting idle. Once the chunks run out, the
+ * caller waits for the helpers to finish the chunks they've claimed. If the caller is a task, waiting suspends its
+ * fiber rather than blocking its worker
+ *
+ * If the body throws, no more chunks are started, and the algorithm rethrows the first exception on the calling thread
+ * once every chunk that was already running has finished
+ */
+
+namespace nova::ttl {
+    namespace detail {
+        /*!
+         * \brief How many chunks each participating thread should get, when picking a grain size automatically
+         */
+        constexpr std::size_t CHUNKS_PER_THREAD = 8;
+
+        inline std::size_t get_num_participants(const task_scheduler* scheduler) {
+            // A worker that calls into a parallel algorithm is one of the participants, so it only needs help from
+            // the other workers
+            return scheduler->is_worker_thread() ? scheduler->get_num_threads() : scheduler->get_num_threads() + std::size_t{1};
+        }
+
+        inline std::size_t pick_grain_size(const task_scheduler* scheduler, const std::size_t num_elements, const std::size_t grain_size) {
+            if(grain_size > 0) {
+                return grain_size;
+            }
+
+            const std::size_t num_chunks = get_num_participants(scheduler) * CHUNKS_PER_THREAD;
+            return std::max<std::size_t>((num_elements + num_chunks - 1) / num_chunks, 1);
+        }
+
+        /*!
+         * \brief Calls `run_chunk(chunk_idx)` for every chunk index in [0, num_chunks), using the calling thread and
+         * as many workers as will be useful
+         *
+         * If `run_chunk` throws, on the calling thread or on a helper, no new chunks are started and the first
+         * exception is rethrown on the calling thread once the helpers have finished
+         */
+        template <typename ChunkFunction>
+        void run_chunks(task_scheduler* scheduler, const std::size_t num_chunks, ChunkFunction&& run_chunk) {
+            if(num_chunks == 0) {
+                return;
+            }
+
+            std::atomic<std::size_t> next_chunk = 0;
+            std::mutex error_mutex;
+            std::exception_ptr error;
+            auto work = [&] {
+                try {
+                    for(std::size_t chunk = next_chunk.fetch_add(1, std::memory_order_relaxed); chunk < num_chunks;
+                        chunk = next_chunk.fetch_add(1, std::memory_order_relaxed)) {
+                        run_chunk(chunk);
+                    }
+                }
+                catch(...) {
+                    next_chunk.store(num_chunks, std::memory_order_relaxed);
+
+                    std::lock_guard l(error_mutex);
+                    if(!error) {
+                        error = std::current_exception();
+                    }
+                }
+            };
+
+            // There's no point waking up more helpers than there are chunks for them to take
+            const std::size_t num_helpers = std::min(num_chunks - 1, get_num_participants(scheduler) - 1);
+
+            condition_counter helpers_done;
+            for(std::size_t i = 0; i < num_helpers; i++) {
+                scheduler->add_detached_task(&helpers_done, [&work](task_scheduler* /* scheduler */) { work(); });
+            }
+
+            work();
+
+            // The helpers reference this stack frame, so we can't leave until they're done
+            helpers_done.wait_for_value(0);
+
+            // Every helper has finished, so nothing else touches the error
+            if(error) {
+                std::rethrow_exception(error);
+            }
+        }
+    } // namespace detail
+
+    /*!
+     * \brief Calls `body(i)` for every `i` in [begin, end), in parallel
+     *
+     * \param scheduler The scheduler whose workers should help
+     * \param begin The first index
+     * \param end One past the last index
+     * \param body The function to call for each index. Calls for different indices may happen concurrently
+     * \param grain_size The number of consecutive indices that one thread handles at a time, or 0 to pick one
+     * automatically
+     */
+    template <typename Body>
+    void parallel_for(task_scheduler* scheduler, const std::size_t begin, const std::size_t end, Body&& body, const std::size_t grain_size = 0) {
+        if(end <= begin) {
+            return;
+        }
+
+        const std::size_t num_elements = end - begin;
+        const std::size_t grain = detail::pick_grain_size(scheduler, num_elements, grain_size);
+        const std::size_t num_chunks = (num_elements + grain - 1) / grain;
+
+        detail::run_chunks(scheduler, num_chunks, [&](const std::size_t chunk) {
+            const std::size_t chunk_begin = begin + chunk * grain;
+            const std::size_t chunk_end = std::min(chunk_begin + grain, end);
+            for(std::size_t i = chunk_begin; i < chunk_end; i++) {
+                body(i);
+            }
+        });
+    }
+
+    /*!
+     * \brief Reduces the range [begin, end) to a single value, in parallel
+     *
+     * Each chunk is reduced by `reduce_range`, then the results for each chunk are combined on the calling thread in
+     * chunk order. This means the result is the same no matter how the chunks were scheduled, so long as `combine` is
+     * associative
+     *
+     * \param scheduler The scheduler whose workers should help
+     * \param begin The first index
+     * \param end One past the last index
+     * \param identity The value that combining with changes nothing, e.g. 0 for a sum
+     * \param reduce_range Called as `reduce_range(chunk_begin, chunk_end, identity)`, and returns the reduction of
+     * that chunk
+     * \param combine Called as `combine(left, right)`, and returns the reduction of both arguments
+     * \param grain_size The number of consecutive indices that one thread handles at a time, or 0 to pick one
+     * automatically
+     */
+    template <typename T, typename ReduceRange, typename Combine>
+    T parallel_reduce(task_scheduler* scheduler,
+                      const std::size_t begin,
+                      const std::size_t end,
+                      const T& identity,
+                      ReduceRange&& reduce_range,
+                      Combine&& combine,
+                      const std::size_t grain_size = 0) {
+        if(end <= begin) {
+            return identity;
+        }
+
+        const std::size_t num_elements = end - begin;
+        const std::size_t grain = detail::pick_grain_size(scheduler, num_elements, grain_size);
+        const std::size_t num_chunks = (num_elements + grain - 1) / grain;
+
+        std::vector<T> chunk_results(num_chunks, identity);
+        detail::run_chunks(scheduler, num_chunks, [&](const std::size_t chunk) {
+            const std::size_t chunk_begin = begin + chunk * grain;
+            const std::size_t chunk_end = std::min(chunk_begin + grain, end);
+            chunk_results[chunk] = reduce_range(chunk_begin, chunk_end, identity);
+        });
+
+        T result = identity;
+        for(T& chunk_result : chunk_results) {
+            result = combine(result, chunk_result);
+        }
+
+        return result;
+    }
+
+    /*!
+     * \brief Sorts [first, last), in parallel
+     *
+     * Sorts chunks of `grain_size` elements with std::sort, then merges neighbouring runs in rounds until there's only
+     * one run left. The merges within a round run in parallel. Like std::sort, the sort is not stable
+     *
+     * \param scheduler The scheduler whose workers should help
+     * \param first An iterator to the first element to sort
+     * \param last An iterator one past the last element to sort
+     * \param compare The comparison to sort with
+     * \param grain_size The number of elements in each initially sorted run, or 0 to pick one automatically
+     */
+    template <typename RandomIt, typename Compare = std::less<>>
+    void parallel_sort(task_scheduler* scheduler, RandomIt first, RandomIt last, Compare compare = {}, const std::size_t grain_size = 0) {
+        const auto num_elements = static_cast<std::size_t>(std::distance(first, last));
+        if(num_elements < 2) {
+            return;
+        }
+
+        const std::size_t grain = detail::pick_grain_size(scheduler, num_elements, grain_size);
+        if(grain >= num_elements) {
+            std::sort(first, last, compare);
+            return;
+        }
+
+        const auto at = [&](const std::size_t idx) { return first + static_cast<std::ptrdiff_t>(idx); };
+
+        const std::size_t num_runs = (num_elements + grain - 1) / grain;
+        parallel_for(
+            scheduler,
+            0,
+            num_runs,
+            [&](const std::size_t run) { std::sort(at(run * grain), at(std::min((run + 1) * grain, num_elements)), compare); },
+            1);
+
+        for(std::size_t run_size = grain; run_size < num_elements; run_size *= 2) {
+            const std::size_t num_merges = (num_elements + 2 * run_size - 1) / (2 * run_size);
+            parallel_for(
+                scheduler,
+                0,
+                num_merges,
+                [&](const std::size_t merge) {
+                    const std::size_t merge_begin = merge * 2 * run_size;
+                    const std::size_t merge_middle = std::min(merge_begin + run_size, num_elements);
+                    const std::size_t merge_end = std::min(merge_begin + 2 * run_size, num_elements);
+                    if(merge_middle < merge_end) {
+                        std::inplace_merge(at(merge_begin), at(merge_middle), at(merge_end), compare);
+                    }
+                },
+                1);
+        }
+    }
+} // namespace nova::ttl
@@ -0,0 +1,149 @@
+#include "task_graph.hpp"
+
+#include "task_scheduler.hpp"
+
+namespace nova::ttl {
+    task_graph::task_graph() : run_counter(new condition_counter) {}
+
+    task_graph::node_id task_graph::add_node(std::function<void(task_scheduler*)> work) {
+        declared_nodes.push_back({std::move(work), {}});
+        is_compiled = false;
+
+        return static_cast<node_id>(declared_nodes.size() - 1);
+    }
+
+    void task_graph::add_edge(const node_id before, const node_id after) {
+        declared_nodes.at(before).successors.push_back(after);
+        is_compiled = false;
+    }
+
+    void task_graph::compile() {
+        const auto num_nodes = static_cast<uint32_t>(declared_nodes.size());
+
+        std::vector<uint32_t> num_predecessors(num_nodes, 0);
+        for(const declared_node& node : declared_nodes) {
+            for(const node_id successor : node.successors) {
+                num_predecessors.at(successor)++;
+            }
+        }
+
+        // Kahn's algorithm. Ties are broken by declaration order, so a graph without edges runs in the order it was
+        // declared
+        std::vector<node_id> order;
+        order.reserve(num_nodes);
+
+        std::vector<uint32_t> remaining_predecessors = num_predecessors;
+        for(node_id id = 0; id < num_nodes; id++) {
+            if(remaining_predecessors[id] == 0) {
+                order.push_back(id);
+            }
+        }
+
+        for(std::size_t i = 0; i < order.size(); i++) {
+            for(const node_id successor : declared_nodes[order[i]].successors) {
+                remaining_predecessors[successor]--;
+                if(remaining_predecessors[successor] == 0) {
+                    order.push_back(successor);
+                }
+            }
+        }
+
+        if(order.size() != num_nodes) {
+            throw task_graph_cycle_exception("Task graph has a cycle, so some of its nodes would never run");
+        }
+
+        std::vector<uint32_t> compiled_idx_of_node(num_nodes);
+        for(uint32_t i = 0; i < num_nodes; i++) {
+            compiled_idx_of_node[order[i]] = i;
+        }
+
+        compiled_nodes = std::make_unique<compiled_node[]>(num_nodes);
+        compiled_successors.clear();
+        root_nodes.clear();
+
+        for(uint32_t i = 0; i < num_nodes; i++) {
+            const declared_node& node = declared_nodes[order[i]];
+            compiled_node& compiled = compiled_nodes[i];
+
+            compiled.work = &node.work;
+            compiled.first_successor = static_cast<uint32_t>(compiled_successors.size());
+            compiled.num_successors = static_cast<uint32_t>(node.successors.size());
+            compiled.num_predecessors = num_predecessors[order[i]];
+
+            for(const node_id successor : node.successors) {
+                compiled_successors.push_back(compiled_idx_of_node[successor]);
+            }
+
+            if(compiled.num_predecessors == 0) {
+                root_nodes.push_back(i);
+            }
+        }
+
+        is_compiled = true;
+    }
+
+    void task_graph::run(task_scheduler* scheduler) {
+        run_async(scheduler, run_counter.get());
+        run_counter->wait_for_value(0);
+    }
+
+    void task_graph::run_async(task_scheduler* scheduler, condition_counter* counter) {
+        if(!is_compiled) {
+            compile();
+        }
+
+        const auto num_nodes = static_cast<uint32_t>(declared_nodes.size());
+        if(num_nodes == 0) {
+            return;
+        }
+
+        for(uint32_t i = 0; i < num_nodes; i++) {
+            compiled_nodes[i].remaining_predecessors.store(compiled_nodes[i].num_predecessors, std::memory_order_relaxed);
+        }
+
+        // Count every node up front, so the counter can't reach zero until the last node has finished
+        counter->add(num_nodes);
+
+        for(const uint32_t root : root_nodes) {
+            queue_node(scheduler, root, counter);
+        }
+    }
+
+    std::size_t task_graph::get_num_nodes() const { return declared_nodes.size(); }
+
+    void task_graph::queue_node(task_scheduler* scheduler, const uint32_t node_idx, condition_counter* counter) {
+        scheduler->add_detached_task([this, node_idx, counter](task_scheduler* pool) { run_node(pool, node_idx, counter); });
+    }
+
+    void task_graph::run_node(task_scheduler* scheduler, uint32_t node_idx, condition_counter* counter) {
+        while(node_idx != NO_NODE) {
+            const compiled_node& node = compiled_nodes[node_idx];
+
+            try {
+                (*node.work)(scheduler);
+            }
+            catch(...) {
+                NOVA_LOG(FATAL) << "Task graph node failed executing!";
+#ifdef NOVA_LINUX
+                nova_backtrace();
+#endif
+            }
+
+            uint32_t continuation = NO_NODE;
+            for(uint32_t i = node.first_successor; i < node.first_successor + node.num_successors; i++) {
+                const uint32_t successor = compiled_successors[i];
+                if(compiled_nodes[successor].remaining_predecessors.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    if(continuation != NO_NODE) {
+                        queue_node(scheduler, continuation, counter);
+                    }
+                    continuation = successor;
+                }
+            }
+
+            // This may be the last node, in which case the graph can be destroyed as soon as the counter is
+            // decremented, so don't touch it afterwards
+            counter->sub(1);
+            node_idx = continuation;
+        }
+    }
+} // namespace nova::ttl
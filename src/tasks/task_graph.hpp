@@ -1,4 +1,134 @@
 #pragma once
+
+#include <atomic>
+#include <cstdint>
 #include <functional>
+#include <memory>
+#include <vector>
+
+#include "nova_renderer/util/utils.hpp"
+
+#include "condition_counter.hpp"
+
+namespace nova::ttl {
+    class task_scheduler;
+
+    NOVA_EXCEPTION(task_graph_cycle_exception);
+
+    /*!
+     * \brief A set of tasks and the order they have to run in, which can be run over and over, e.g. once per frame
+     *
+     * Declare the work with `add_node` and the dependencies between it with `add_edge`, then `compile` the graph.
+     * Compiling sorts the nodes topologically and packs them into a single array, with a flat array of successor
+     * indices, so running the graph doesn't allocate. Each run resets every node's count of unfinished predecessors,
+     * then queues the nodes without any predecessors. When a node finishes it decrements its successors' counts, and
+     * queues the ones which hit zero. The last of those runs straight away on the same thread, without going through
+     * the queue
+     *
+     * A graph must not be run again, or changed, until its previous run has finished
+     */
+    class task_graph {
+    public:
+        using node_id = uint32_t;
+
+        task_graph();
+
+        task_graph(task_graph&& other) noexcept = default;
+        task_graph& operator=(task_graph&& other) noexcept = default;
+
+        task_graph(const task_graph& other) = delete;
+        task_graph& operator=(const task_graph& other) = delete;
+
+        ~task_graph() = default;
+
+        /*!
+         * \brief Adds some work to the graph
+         *
+         * \param work The function to call when all the node's predecessors have finished
+         *
+         * \return The ID of the new node, for use with `add_edge`
+         */
+        node_id add_node(std::function<void(task_scheduler*)> work);
+
+        /*!
+         * \brief Makes `after` wait for `before` to finish before it starts
+         */
+        void add_edge(node_id before, node_id after);
+
+        /*!
+         * \brief Sorts the graph's nodes into the order they'll run in
+         *
+         * Called by `run` and `run_async` if the graph has changed since it was last compiled
+         *
+         * \throws task_graph_cycle_exception if the dependencies between nodes form a cycle
+         */
+        void compile();
+
+        /*!
+         * \brief Runs every node in the graph, and waits for them all to finish
+         *
+         * If called from a task, the task's fiber is suspended while it waits, so the thread carries on with other work
+         */
+        void run(task_scheduler* scheduler);
+
+        /*!
+         * \brief Starts running every node in the graph. `counter` is incremented once for each node, and decremented
+         * when that node finishes
+         */
+        void run_async(task_scheduler* scheduler, condition_counter* counter);
+
+        [[nodiscard]] std::size_t get_num_nodes() const;
+
+    private:
+        constexpr static uint32_t NO_NODE = UINT32_MAX;
+
+        /*!
+         * \brief A node as it was declared
+         */
+        struct declared_node {
+            std::function<void(task_scheduler*)> work;
+            std::vector<node_id> successors;
+        };
+
+        /*!
+         * \brief A node in the compiled graph. Its successors are indices into the compiled graph, not node IDs
+         */
+        struct compiled_node {
+            const std::function<void(task_scheduler*)>* work = nullptr;
+            uint32_t first_successor = 0;
+            uint32_t num_successors = 0;
+            uint32_t num_predecessors = 0;
+            std::atomic<uint32_t> remaining_predecessors = 0;
+        };
+
+        std::vector<declared_node> declared_nodes;
+        bool is_compiled = false;
+
+        /*!
+         * \brief All the nodes, in topological order
+         */
+        std::unique_ptr<compiled_node[]> compiled_nodes;
+
+        /*!
+         * \brief The successors of every compiled node, one node's after another
+         */
+        std::vector<uint32_t> compiled_successors;
+
+        /*!
+         * \brief The compiled nodes which have no predecessors, and so start running straight away
+         */
+        std::vector<uint32_t> root_nodes;
+
+        /*!
+         * \brief Counts the nodes that haven't finished during a call to `run`
+         */
+        std::unique_ptr<condition_counter> run_counter;
+
+        void queue_node(task_scheduler* scheduler, uint32_t node_idx, condition_counter* counter);
 
-namespace nova::ttl {}
+        /*!
+         * \brief Runs a node, releases its successors, then runs whichever successor became ready last
+         */
+        void run_node(task_scheduler* scheduler, uint32_t node_idx, condition_counter* counter);
+    };
+} // namespace nova::ttl
@@ -0,0 +1,204 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "wait_free_queue.hpp"
+
+namespace nova::ttl {
+    class task_record_pool;
+
+    /*!
+     * \brief A type-erased task, stored inline so that queueing it doesn't need the heap
+     *
+     * A task_record holds a callable in a fixed-size buffer, plus a pointer to a function which knows how to call and
+     * destroy that callable. Records are handed out by a task_record_pool and go back to it once they've executed
+     */
+    class alignas(CACHE_LINE_SIZE) task_record {
+        friend class task_record_pool;
+
+    public:
+        /*!
+         * \brief The number of bytes that a callable (and everything it captures) may use
+         */
+        constexpr static std::size_t inline_storage_size = 2 * CACHE_LINE_SIZE - 2 * alignof(std::max_align_t);
+
+        /*!
+         * \brief Whether a callable of type `Callable` fits inside a task_record
+         */
+        template <typename Callable>
+        constexpr static bool fits_inline = sizeof(Callable) <= inline_storage_size && alignof(Callable) <= alignof(std::max_align_t);
+
+        task_record() = default;
+
+        task_record(task_record&& other) noexcept = delete;
+        task_record& operator=(task_record&& other) noexcept = delete;
+
+        task_record(const task_record& other) = delete;
+        task_record& operator=(const task_record& other) = delete;
+
+        ~task_record() = default;
+
+        /*!
+         * \brief Moves the provided callable into this record's storage
+         *
+         * \pre This record doesn't currently hold a callable
+         */
+        template <typename Callable>
+        void emplace(Callable&& callable) {
+            using CallableType = std::decay_t<Callable>;
+            static_assert(fits_inline<CallableType>,
+                          "Task is too big to be stored inline. Capture less, or capture a pointer to the data you need");
+
+            new(&storage) CallableType(std::forward<Callable>(callable));
+            manage = [](void* data, const bool should_invoke) {
+                auto* stored_callable = std::launder(static_cast<CallableType*>(data));
+
+                // Destroy the callable even if it throws, otherwise whatever it captured would leak
+                struct destroyer {
+                    CallableType* callable;
+                    ~destroyer() { callable->~CallableType(); }
+                } guard{stored_callable};
+
+                if(should_invoke) {
+                    (*stored_callable)();
+                }
+            };
+        }
+
+        /*!
+         * \brief Calls the stored callable, then destroys it
+         *
+         * \pre `emplace` has been called since the last time `execute` or `discard` was called
+         */
+        void execute() { take_manage_function()(&storage, true); }
+
+        /*!
+         * \brief Destroys the stored callable without calling it
+         *
+         * \pre `emplace` has been called since the last time `execute` or `discard` was called
+         */
+        void discard() { take_manage_function()(&storage, false); }
+
+    private:
+        using manage_function = void (*)(void*, bool);
+
+        std::aligned_storage_t<inline_storage_size, alignof(std::max_align_t)> storage;
+
+        /*!
+         * \brief Destroys the stored callable, invoking it first if asked to
+         */
+        manage_function manage = nullptr;
+
+        /*!
+         * \brief The pool this record came from, or nullptr if it was allocated on the heap because its pool was empty
+         */
+        task_record_pool* owner = nullptr;
+
+        /*!
+         * \brief Intrusive free list link
+         */
+        task_record* next = nullptr;
+
+        manage_function take_manage_function() {
+            const manage_function function = manage;
+            manage = nullptr;
+            return function;
+        }
+    };
+
+    static_assert(sizeof(task_record) == 2 * CACHE_LINE_SIZE, "task_record should be exactly two cache lines");
+
+    /*!
+     * \brief A fixed-capacity pool of task_records, owned by a single thread
+     *
+     * Only the owning thread may allocate from the pool, but any thread may return a record to it. Records returned
+     * by the owning thread go straight back onto its local free list. Records returned by other threads are pushed
+     * onto a lock-free list which the owner takes all at once when its local list runs dry, so the only
+     * synchronization is one CAS per remote free and one exchange per refill
+     *
+     * If the pool is exhausted, records are allocated from the heap instead. They're deleted when they're freed, so
+     * the pool doesn't grow
+     */
+    class task_record_pool {
+    public:
+        /*!
+         * \brief Creates a pool with space for `capacity` records
+         */
+        explicit task_record_pool(std::size_t capacity) : records(new task_record[capacity]) {
+            for(std::size_t i = 0; i < capacity; i++) {
+                records[i].owner = this;
+                records[i].next = i + 1 < capacity ? &records[i + 1] : nullptr;
+            }
+
+            local_free_list = capacity > 0 ? &records[0] : nullptr;
+        }
+
+        task_record_pool(task_record_pool&& other) noexcept = delete;
+        task_record_pool& operator=(task_record_pool&& other) noexcept = delete;
+
+        task_record_pool(const task_record_pool& other) = delete;
+        task_record_pool& operator=(const task_record_pool& other) = delete;
+
+        ~task_record_pool() = default;
+
+        /*!
+         * \brief Gets a record from this pool
+         *
+         * Must only be called by the thread that owns this pool
+         *
+         * \return An empty record. Never nullptr
+         */
+        task_record* allocate() {
+            if(local_free_list == nullptr) {
+                local_free_list = remote_free_list.exchange(nullptr, std::memory_order_acquire);
+            }
+
+            if(local_free_list == nullptr) {
+                // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
+                return new task_record;
+            }
+
+            task_record* record = local_free_list;
+            local_free_list = record->next;
+            record->next = nullptr;
+
+            return record;
+        }
+
+        /*!
+         * \brief Returns a record to the pool that it came from
+         *
+         * \param record The record to free. It must not hold a callable
+         * \param freeing_pool The pool owned by the calling thread, or nullptr if the calling thread doesn't own a pool
+         */
+        static void free(task_record* record, task_record_pool* freeing_pool) {
+            task_record_pool* pool = record->owner;
+            if(pool == nullptr) {
+                // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
+                delete record;
+
+            } else if(pool == freeing_pool) {
+                record->next = pool->local_free_list;
+                pool->local_free_list = record;
+
+            } else {
+                task_record* head = pool->remote_free_list.load(std::memory_order_relaxed);
+                do {
+                    record->next = head;
+                } while(!pool->remote_free_list.compare_exchange_weak(head, record, std::memory_order_release, std::memory_order_relaxed));
+            }
+        }
+
+    private:
+        std::unique_ptr<task_record[]> records;
+
+        task_record* local_free_list = nullptr;
+
+        alignas(CACHE_LINE_SIZE) std::atomic<task_record*> remote_free_list = nullptr;
+    };
+} // namespace nova::ttl
@@ -1,32 +1,99 @@
 #include "task_scheduler.hpp"
 
+#include <algorithm>
+#include <chrono>
 #include <utility>
 
 namespace nova::ttl {
+    namespace {
+        /*!
+         * \brief The scheduler that the current thread is a worker for, or nullptr if it isn't a worker
+         */
+        thread_local const task_scheduler* current_thread_scheduler = nullptr;
+
+        /*!
+         * \brief The index of the current thread in `current_thread_scheduler`
+         */
+        thread_local std::size_t current_thread_idx = 0;
+
+        /*!
+         * \brief Hands out indices into the external record pools, so that outside threads are spread over them
+         */
+        std::atomic<std::size_t> next_external_record_pool = 0;
+
+        /*!
+         * \brief Which of a scheduler's external record pools the current thread allocates from, if it's not a worker
+         */
+        thread_local const std::size_t current_external_record_pool = next_external_record_pool.fetch_add(1, std::memory_order_relaxed);
+
+        /*!
+         * \brief Adds to a counter that only the calling thread writes to, without a locked read-modify-write
+         */
+        void bump(std::atomic<uint64_t>& counter, const uint64_t amount = 1) {
+            counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+        }
+    } // namespace
+
     task_scheduler::per_thread_data::per_thread_data()
-        : task_queue(new wait_free_queue<std::function<void()>>),
-          things_in_queue_mutex(new std::mutex),
-          things_in_queue_cv(new std::condition_variable),
+        : task_queues{std::make_unique<wait_free_queue<task_record*>>(),
+                      std::make_unique<wait_free_queue<task_record*>>(),
+                      std::make_unique<wait_free_queue<task_record*>>()},
+          record_pool(new task_record_pool(TASK_RECORDS_PER_THREAD)),
+          counters(new worker_counters),
+          ready_fibers_mutex(new std::mutex),
+          num_ready_fibers(new std::atomic<std::size_t>(0)),
+          wakeup(new event_count),
           is_sleeping(new std::atomic<bool>(false)) {}
 
-    task_scheduler::task_scheduler(const uint32_t num_threads, const empty_queue_behavior /* behavior */)
+    task_scheduler::task_scheduler(const uint32_t num_threads, const empty_queue_behavior behavior, const worker_placement placement)
         : num_threads(num_threads),
           should_shutdown(new std::atomic<bool>(false)),
+          behavior_of_empty_queues(behavior),
+          num_sleeping_workers(new std::atomic<uint32_t>(0)),
           initialized_mutex(new std::mutex),
-          initialized_cv(new std::condition_variable) {
+          initialized_cv(new std::condition_variable),
+          external_tasks{std::make_unique<injection_queue<task_record*>>(),
+                         std::make_unique<injection_queue<task_record*>>(),
+                         std::make_unique<injection_queue<task_record*>>()},
+          external_record_pools(new external_record_pool[NUM_EXTERNAL_RECORD_POOLS]) {
         threads.reserve(num_threads);
         thread_local_data.resize(num_threads);
 
-        for(uint32_t i = 0; i < num_threads; i++) {
-            per_thread_data data;
-            data.task_queue = std::make_unique<wait_free_queue<std::function<void()>>>();
-            data.is_sleeping = std::make_unique<std::atomic<bool>>();
-            data.last_successful_steal = 0;
-            data.things_in_queue_cv = std::make_unique<std::condition_variable>();
-            data.things_in_queue_mutex = std::make_unique<std::mutex>();
-            thread_local_data.push_back(std::move(data));
+        for(per_thread_data& data : thread_local_data) {
+            data.scheduler = this;
+        }
+
+        if(placement == worker_placement::PIN_TO_CORES) {
+            const std::vector<logical_cpu> placed_cpus = place_workers(read_cpu_topology(), num_threads);
+            if(placed_cpus.empty()) {
+                NOVA_LOG(WARN) << "Could not read the CPU topology, so task scheduler workers will not be pinned";
+            }
+
+            for(std::size_t i = 0; i < placed_cpus.size(); i++) {
+                const logical_cpu& cpu = placed_cpus[i];
+                thread_local_data[i].cpu = cpu;
+                NOVA_LOG(INFO) << "Task scheduler worker " << i << " is pinned to CPU " << cpu.id << " (core " << cpu.core_id
+                               << ", package " << cpu.package_id << ", last-level cache " << cpu.llc_id << ")";
+            }
+        }
+
+        for(std::size_t i = 0; i < num_threads; i++) {
+            std::vector<std::size_t>& steal_order = thread_local_data[i].steal_order;
+            for(std::size_t offset = 1; offset < num_threads; offset++) {
+                steal_order.push_back((i + offset) % num_threads);
+            }
+
+            // Pinned workers steal from the workers closest to them first. The sort is stable, so workers the same
+            // distance away are still tried round-robin
+            if(const std::optional<logical_cpu>& cpu = thread_local_data[i].cpu) {
+                std::stable_sort(steal_order.begin(), steal_order.end(), [&](const std::size_t a, const std::size_t b) {
+                    return get_distance(*cpu, *thread_local_data[a].cpu) < get_distance(*cpu, *thread_local_data[b].cpu);
+                });
+            }
+        }
 
-            threads.emplace_back(thread_func, this);
+        for(uint32_t i = 0; i < num_threads; i++) {
+            threads.emplace_back(thread_func, this, i);
         }
 
         {
@@ -38,86 +105,191 @@ namespace nova::ttl {
 
     task_scheduler::~task_scheduler() {
         should_shutdown->store(true);
+        for(per_thread_data& data : thread_local_data) {
+            data.wakeup->notify_all();
+        }
 
         for(auto& thread : threads) {
             thread.join();
         }
-    }
 
-    std::size_t task_scheduler::get_current_thread_idx() {
-        const std::thread::id thread_id = std::this_thread::get_id();
-        for(std::size_t i = 0; i < num_threads; ++i) {
-            if(threads[i].get_id() == thread_id) {
-                return i;
+        // Destroy anything that didn't get to run, so that whatever the tasks captured gets cleaned up. Tasks that
+        // were suspended when we shut down are abandoned along with their fibers
+        for(per_thread_data& data : thread_local_data) {
+            for(auto& queue : data.task_queues) {
+                task_record* task = nullptr;
+                while(queue->pop(&task)) {
+                    task->discard();
+                    task_record_pool::free(task, nullptr);
+                }
+            }
+        }
+
+        for(auto& lane : external_tasks) {
+            task_record* task = nullptr;
+            while(lane->pop(&task)) {
+                task->discard();
+                task_record_pool::free(task, nullptr);
             }
         }
+    }
 
-        // If none of the threads in the pool are the thread we were called from, the user is doing something
-        // unsupported so they must be punished
-        // throw called_from_external_thread();
+    std::size_t task_scheduler::get_current_thread_idx() const {
+        if(current_thread_scheduler == this) {
+            return current_thread_idx;
+        }
 
-        return 0;
+        return get_external_thread_idx();
     }
 
+    std::size_t task_scheduler::get_external_thread_idx() const { return num_threads; }
+
+    bool task_scheduler::is_worker_thread() const { return current_thread_scheduler == this; }
+
     uint32_t task_scheduler::get_num_threads() const { return num_threads; }
 
-    void task_scheduler::add_task(std::function<void()> task) {
-        size_t thread_idx = 0;
-        if(behavior_of_task_queue_search == task_queue_search_behavior::NEXT) {
-            if(last_task_queue_index >= thread_local_data.size()) {
-                last_task_queue_index = 0;
-            }
+    std::size_t task_scheduler::get_queue_depth(const task_priority priority) const {
+        const auto lane = static_cast<std::size_t>(priority);
 
-            thread_idx = last_task_queue_index++;
-        } else if(behavior_of_task_queue_search == task_queue_search_behavior::MOST_EMPTY) {
-            size_t lowest_size = std::numeric_limits<size_t>::max();
-            for(size_t i = 0; i < thread_local_data.size(); i++) {
-                size_t size = thread_local_data[i].task_queue->size();
-                if(size < lowest_size) {
-                    thread_idx = i;
-                    lowest_size = size;
-                }
+        std::size_t depth = external_tasks[lane]->approximate_count();
+        for(const per_thread_data& data : thread_local_data) {
+            depth += data.task_queues[lane]->approximate_count();
+        }
+
+        return depth;
+    }
+
+    std::vector<worker_stats> task_scheduler::get_worker_stats() const {
+        std::vector<worker_stats> stats;
+        stats.reserve(thread_local_data.size());
+
+        for(const per_thread_data& data : thread_local_data) {
+            const worker_counters& counters = *data.counters;
+
+            worker_stats& worker = stats.emplace_back();
+            worker.tasks_executed = counters.tasks_executed.load(std::memory_order_relaxed);
+            worker.fibers_resumed = counters.fibers_resumed.load(std::memory_order_relaxed);
+            worker.pops = counters.pops.load(std::memory_order_relaxed);
+            worker.external_pops = counters.external_pops.load(std::memory_order_relaxed);
+            worker.steal_attempts = counters.steal_attempts.load(std::memory_order_relaxed);
+            worker.steals = counters.steals.load(std::memory_order_relaxed);
+            worker.busy_time = std::chrono::nanoseconds(counters.busy_nanoseconds.load(std::memory_order_relaxed));
+            worker.idle_time = std::chrono::nanoseconds(counters.idle_nanoseconds.load(std::memory_order_relaxed));
+            worker.max_queue_depth = counters.max_queue_depth.load(std::memory_order_relaxed);
+        }
+
+        return stats;
+    }
+
+    void task_scheduler::add_task(task_record* task, const task_priority priority) {
+        push_task(task, priority);
+        wake_workers(1);
+    }
+
+    void task_scheduler::push_task(task_record* task, const task_priority priority) {
+        const auto lane = static_cast<std::size_t>(priority);
+
+        if(is_worker_thread()) {
+            per_thread_data& tls = thread_local_data[current_thread_idx];
+            tls.task_queues[lane]->push(task);
+
+            const uint64_t depth = tls.task_queues[lane]->approximate_count();
+            if(depth > tls.counters->max_queue_depth.load(std::memory_order_relaxed)) {
+                tls.counters->max_queue_depth.store(depth, std::memory_order_relaxed);
             }
+
+        } else {
+            external_tasks[lane]->push(task);
         }
+    }
 
-        thread_local_data[thread_idx].task_queue->push(std::move(task));
+    void task_scheduler::wake_workers(const std::size_t num_tasks) {
+        if(behavior_of_empty_queues != empty_queue_behavior::SLEEP) {
+            return;
+        }
 
-        if(behavior_of_empty_queues == empty_queue_behavior::SLEEP) {
-            // Find a thread that is sleeping and wake it
-            for(uint32_t i = 0; i < num_threads; ++i) {
-                std::unique_lock<std::mutex> lock(*thread_local_data[i].things_in_queue_mutex);
-                if(thread_local_data[i].is_sleeping) {
-                    thread_local_data[i].is_sleeping->store(false);
-                    thread_local_data[i].things_in_queue_cv->notify_one();
+        // Pairs with the sleeping worker incrementing num_sleeping_workers before it looks for work one last time:
+        // either we see that it's asleep, or it sees the new tasks
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(num_sleeping_workers->load(std::memory_order_relaxed) == 0) {
+            return;
+        }
 
-                    break;
-                }
+        std::size_t num_woken = 0;
+        for(per_thread_data& data : thread_local_data) {
+            if(num_woken >= num_tasks) {
+                break;
             }
+
+            // Whoever changes is_sleeping to false is the one who wakes the worker, so each sleeper is only woken once
+            if(data.is_sleeping->load(std::memory_order_relaxed) && data.is_sleeping->exchange(false)) {
+                num_sleeping_workers->fetch_sub(1);
+                data.wakeup->notify_one();
+                num_woken++;
+            }
+        }
+    }
+
+    void task_scheduler::stop_sleeping(per_thread_data& tls) {
+        if(tls.is_sleeping->exchange(false)) {
+            num_sleeping_workers->fetch_sub(1);
+        }
+    }
+
+    task_record* task_scheduler::allocate_task_record() {
+        if(is_worker_thread()) {
+            return thread_local_data[current_thread_idx].record_pool->allocate();
         }
+
+        external_record_pool& external_pool = external_record_pools[current_external_record_pool % NUM_EXTERNAL_RECORD_POOLS];
+        std::lock_guard l(external_pool.mutex);
+        return external_pool.pool.allocate();
     }
 
-    void task_scheduler::add_task_proxy(std::function<void()> task) { add_task(std::move(task)); }
+    bool task_scheduler::get_next_task(task_record** task) {
+        per_thread_data& tls = thread_local_data[current_thread_idx];
+
+        // Every so often, look from the bottom up so that background work still gets done when the pool is flooded
+        // with more urgent work
+        const bool lowest_priority_first = tls.tasks_since_starvation_check >= STARVATION_GUARD_INTERVAL;
+
+        for(std::size_t i = 0; i < NUM_TASK_PRIORITIES; i++) {
+            const std::size_t lane = lowest_priority_first ? NUM_TASK_PRIORITIES - 1 - i : i;
+            if(get_next_task_with_priority(task, static_cast<task_priority>(lane))) {
+                tls.tasks_since_starvation_check = lowest_priority_first ? 0 : tls.tasks_since_starvation_check + 1;
+                return true;
+            }
+        }
+
+        return false;
+    }
 
-    bool task_scheduler::get_next_task(std::function<void()>* task) {
-        const std::size_t current_thread_index = get_current_thread_idx();
+    bool task_scheduler::get_next_task_with_priority(task_record** task, const task_priority priority) {
+        const auto lane = static_cast<std::size_t>(priority);
+        const std::size_t current_thread_index = current_thread_idx;
         per_thread_data& tls = thread_local_data[current_thread_index];
 
         // Try to pop from our own queue
-        if(tls.task_queue->pop(task)) {
+        if(tls.task_queues[lane]->pop(task)) {
+            bump(tls.counters->pops);
             return true;
         }
 
-        // Ours is empty, try to steal from the others'
-        const std::size_t thread_index = tls.last_successful_steal;
-        for(std::size_t i = 0; i < num_threads; ++i) {
-            const std::size_t thread_index_to_steal_from = (thread_index + i) % num_threads;
-            if(thread_index_to_steal_from == current_thread_index) {
-                continue;
-            }
+        // Ours is empty, see if anything came in from outside the pool
+        if(external_tasks[lane]->pop(task)) {
+            bump(tls.counters->external_pops);
+            return true;
+        }
 
-            per_thread_data& other_tls = thread_local_data[thread_index_to_steal_from];
-            if(other_tls.task_queue->steal(task)) {
-                tls.last_successful_steal = thread_index_to_steal_from;
+        // Nothing there either, try to steal from the others'. Whoever we last stole from probably has more, so try
+        // them first, then everyone else from nearest to furthest
+        const std::size_t last_steal = tls.last_successful_steal;
+        if(last_steal != current_thread_index && steal_from(tls, last_steal, lane, task)) {
+            return true;
+        }
+
+        for(const std::size_t thread_index_to_steal_from : tls.steal_order) {
+            if(thread_index_to_steal_from != last_steal && steal_from(tls, thread_index_to_steal_from, lane, task)) {
                 return true;
             }
         }
@@ -125,28 +297,164 @@ namespace nova::ttl {
         return false;
     }
 
+    bool task_scheduler::steal_from(per_thread_data& tls, const std::size_t victim_idx, const std::size_t lane, task_record** task) {
+        bump(tls.counters->steal_attempts);
+        if(thread_local_data[victim_idx].task_queues[lane]->steal(task)) {
+            bump(tls.counters->steals);
+            tls.last_successful_steal = victim_idx;
+            return true;
+        }
+
+        return false;
+    }
+
+    bool task_scheduler::run_next_task() {
+        per_thread_data& tls = thread_local_data[current_thread_idx];
+
+        // Finish what we've already started before starting anything new
+        if(tls.num_ready_fibers->load(std::memory_order_acquire) > 0) {
+            fiber* ready_fiber = nullptr;
+            {
+                std::lock_guard l(*tls.ready_fibers_mutex);
+                ready_fiber = tls.ready_fibers.back();
+                tls.ready_fibers.pop_back();
+                tls.num_ready_fibers->fetch_sub(1, std::memory_order_relaxed);
+            }
+
+            bump(tls.counters->fibers_resumed);
+            ready_fiber->resume();
+            return true;
+        }
+
+        // Tasks which yielded are polling for something, so they get a look-in every so often even when there's
+        // plenty of other work
+        const bool yielded_fiber_is_due = tls.tasks_since_yielded_fiber_ran >= STARVATION_GUARD_INTERVAL;
+
+        task_record* task = nullptr;
+        if((tls.yielded_fibers.empty() || !yielded_fiber_is_due) && get_next_task(&task)) {
+            tls.tasks_since_yielded_fiber_ran++;
+            execute_task(task);
+            return true;
+        }
+
+        if(!tls.yielded_fibers.empty()) {
+            fiber* yielded_fiber = tls.yielded_fibers.front();
+            tls.yielded_fibers.erase(tls.yielded_fibers.begin());
+            tls.tasks_since_yielded_fiber_ran = 0;
+
+            bump(tls.counters->fibers_resumed);
+            yielded_fiber->resume();
+            return true;
+        }
+
+        return false;
+    }
+
+    void task_scheduler::yield_current_task() {
+        fiber* current_fiber = fiber::get_current();
+        if(current_fiber == nullptr || !is_worker_thread()) {
+            std::this_thread::yield();
+            return;
+        }
+
+        per_thread_data& tls = thread_local_data[current_thread_idx];
+        if(tls.yielded_fibers.empty()) {
+            tls.tasks_since_yielded_fiber_ran = 0;
+        }
+
+        tls.yielded_fibers.push_back(current_fiber);
+        current_fiber->yield();
+    }
+
+    void task_scheduler::execute_task(task_record* task) {
+        per_thread_data& tls = thread_local_data[current_thread_idx];
+
+        if(tls.free_fibers.empty()) {
+            tls.fibers.emplace_back(std::make_unique<fiber>(fiber_main, make_fiber_ready, &tls, FIBER_STACK_SIZE));
+            tls.free_fibers.push_back(tls.fibers.back().get());
+        }
+
+        fiber* task_fiber = tls.free_fibers.back();
+        tls.free_fibers.pop_back();
+
+        bump(tls.counters->tasks_executed);
+
+        tls.next_fiber_task = task;
+        task_fiber->resume();
+    }
+
+    void task_scheduler::run_task(task_record* task) {
+        task->execute();
+        task_record_pool::free(task, thread_local_data[current_thread_idx].record_pool.get());
+    }
+
+    void task_scheduler::fiber_main(fiber* self) {
+        // Fibers are only ever resumed by the thread that created them, so this never changes
+        auto* tls = static_cast<per_thread_data*>(self->get_user_data());
+
+        while(true) {
+            task_record* task = tls->next_fiber_task;
+            tls->next_fiber_task = nullptr;
+
+            tls->scheduler->run_task(task);
+
+            tls->free_fibers.push_back(self);
+            self->yield();
+        }
+    }
+
+    void task_scheduler::make_fiber_ready(fiber* self) {
+        auto* tls = static_cast<per_thread_data*>(self->get_user_data());
+        {
+            std::lock_guard l(*tls->ready_fibers_mutex);
+            tls->ready_fibers.push_back(self);
+            tls->num_ready_fibers->fetch_add(1, std::memory_order_release);
+        }
+
+        // The fiber can only run on its own thread, so make sure that thread is awake. No other thread can run it, so
+        // nobody else needs waking
+        if(tls->scheduler->behavior_of_empty_queues == empty_queue_behavior::SLEEP) {
+            tls->wakeup->notify_one();
+        }
+    }
+
     /*!
      * \brief Function for each thread in the thread pool. We check if there's any tasks to execute. If so they get
      * executed, if not we check again
      */
-    void thread_func(task_scheduler* pool) {
+    void thread_func(task_scheduler* pool, const std::size_t thread_idx) {
+        current_thread_scheduler = pool;
+        current_thread_idx = thread_idx;
+
+        if(const std::optional<logical_cpu>& cpu = pool->thread_local_data[thread_idx].cpu) {
+            if(!pin_current_thread_to_cpu(cpu->id)) {
+                NOVA_LOG(WARN) << "Could not pin task scheduler worker " << thread_idx << " to CPU " << cpu->id;
+            }
+        }
+
         {
             std::unique_lock l(*pool->initialized_mutex);
             pool->initialized_cv->wait(l, [=] { return pool->initialized; });
         }
 
-        const std::size_t thread_idx = pool->get_current_thread_idx();
         task_scheduler::per_thread_data& tls = pool->thread_local_data[thread_idx];
 
+        // Each pass through the loop is either busy or idle as a whole, so one clock read per pass is enough to
+        // split the thread's time between the two
+        auto last_timestamp = std::chrono::steady_clock::now();
+
         while(!pool->should_shutdown->load()) {
-            // Get a new task from the queue, and execute it
-            std::function<void()> next_task;
-            const bool success = pool->get_next_task(&next_task);
+            // Carry on a suspended task or get a new task from the queue, and execute it
+            const bool success = pool->run_next_task();
+            bool ran_task = success;
             const empty_queue_behavior behavior = pool->behavior_of_empty_queues;
 
-            if(success) {
-                next_task();
-            } else {
+            if(!success) {
+                // We're out of work, so give back whatever memory the last burst of tasks made our queues grow into
+                for(auto& queue : tls.task_queues) {
+                    queue->shrink();
+                }
+
                 // We failed to find a Task from any of the queues
                 // What we do now depends on behavior_of_empty_queues, which we loaded above
                 switch(behavior) {
@@ -155,10 +463,27 @@ namespace nova::ttl {
                         break;
 
                     case empty_queue_behavior::SLEEP: {
-                        std::unique_lock<std::mutex> lock(*tls.things_in_queue_mutex);
+                        // Register as a sleeper before looking for work one last time, so that a task added or a fiber
+                        // made ready after the last look is guaranteed to wake us up
+                        const uint32_t wait_key = tls.wakeup->prepare_wait();
                         tls.is_sleeping->store(true);
+                        pool->num_sleeping_workers->fetch_add(1);
+
+                        task_record* next_task = nullptr;
+                        if(tls.num_ready_fibers->load(std::memory_order_acquire) > 0 || pool->get_next_task(&next_task) ||
+                           pool->should_shutdown->load()) {
+                            tls.wakeup->cancel_wait();
 
-                        tls.things_in_queue_cv->wait(lock);
+                        } else {
+                            tls.wakeup->wait(wait_key);
+                        }
+
+                        pool->stop_sleeping(tls);
+
+                        if(next_task != nullptr) {
+                            pool->execute_task(next_task);
+                            ran_task = true;
+                        }
 
                         break;
                     }
@@ -169,6 +494,11 @@ namespace nova::ttl {
                         break;
                 }
             }
+
+            const auto timestamp = std::chrono::steady_clock::now();
+            const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(timestamp - last_timestamp);
+            bump(ran_task ? tls.counters->busy_nanoseconds : tls.counters->idle_nanoseconds, static_cast<uint64_t>(elapsed.count()));
+            last_timestamp = timestamp;
         }
     }
 
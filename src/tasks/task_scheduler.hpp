@@ -1,14 +1,26 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <functional>
 #include <future>
+#include <iterator>
+#include <optional>
+#include <tuple>
+#include <type_traits>
 
 #include "nova_renderer/util/utils.hpp"
 
 #include "../util/logger.hpp"
 #include "condition_counter.hpp"
+#include "cpu_topology.hpp"
+#include "event_count.hpp"
+#include "fiber.hpp"
+#include "injection_queue.hpp"
+#include "task_record.hpp"
 #include "wait_free_queue.hpp"
 
 #ifdef NOVA_LINUX
@@ -16,8 +28,6 @@
 #endif
 
 namespace nova::ttl {
-    NOVA_EXCEPTION(called_from_external_thread);
-
     class task_scheduler;
 
     using ArgumentExtractorType = std::function<void(task_scheduler*)>;
@@ -54,23 +64,108 @@ namespace nova::ttl {
 
         /*!
          * \brief Sleep until tasks are available
+         *
+         * Sleeping threads are woken one at a time as tasks are added, so an idle scheduler uses no CPU
          */
         SLEEP
     };
 
     /*!
-     * \brief How a task queue is searched for adding a new task
+     * \brief How urgently a task needs to run
+     *
+     * Workers always look for tasks in the higher-priority lanes first, except that every
+     * `task_scheduler::STARVATION_GUARD_INTERVAL` tasks they look from the lowest lane up, so a steady stream of urgent
+     * work can't stop background work from ever running
+     */
+    enum class task_priority {
+        /*!
+         * \brief Work that has to finish inside the current frame
+         */
+        FRAME_CRITICAL,
+
+        /*!
+         * \brief Anything without a deadline in particular
+         */
+        NORMAL,
+
+        /*!
+         * \brief Work which may take several frames, like loading a shaderpack or uploading meshes
+         */
+        BACKGROUND,
+    };
+
+    constexpr std::size_t NUM_TASK_PRIORITIES = 3;
+
+    /*!
+     * \brief Whether workers should be tied to particular CPUs
+     */
+    enum class worker_placement {
+        /*!
+         * \brief Let the OS move workers between CPUs as it sees fit. Workers steal from each other round-robin
+         */
+        UNPINNED,
+
+        /*!
+         * \brief Pin each worker to its own CPU, using the topology in /sys/devices/system/cpu
+         *
+         * Workers are spread over physical cores before doubling up on SMT siblings, and each worker steals from the
+         * workers closest to it first: its SMT sibling, then workers that share its last-level cache, then the rest of
+         * its package, then other packages. Falls back to UNPINNED where the topology can't be read
+         */
+        PIN_TO_CORES,
+    };
+
+    /*!
+     * \brief What one worker has done since its scheduler was created
+     *
+     * See `task_scheduler::get_worker_stats`
      */
-    enum class task_queue_search_behavior {
+    struct worker_stats {
+        /*!
+         * \brief The number of tasks this worker has started
+         */
+        uint64_t tasks_executed = 0;
+
+        /*!
+         * \brief The number of times this worker has resumed a task that was waiting on a condition_counter
+         */
+        uint64_t fibers_resumed = 0;
+
+        /*!
+         * \brief The number of tasks this worker has taken from its own queues
+         */
+        uint64_t pops = 0;
+
+        /*!
+         * \brief The number of tasks this worker has taken from the queue of tasks submitted from outside the pool
+         */
+        uint64_t external_pops = 0;
+
+        /*!
+         * \brief The number of times this worker has tried to steal a task from another worker's queue
+         */
+        uint64_t steal_attempts = 0;
+
         /*!
-         * \brief Just choose the next queue from the previously filled one and start from the beginning if none is left
+         * \brief The number of tasks this worker has successfully stolen
          */
-        NEXT,
+        uint64_t steals = 0;
 
         /*!
-         * \brief Search for the most empty queue and add the task to it
+         * \brief How long this worker has spent running tasks
          */
-        MOST_EMPTY
+        std::chrono::nanoseconds busy_time{0};
+
+        /*!
+         * \brief How long this worker has spent looking for tasks, yielding, or asleep
+         */
+        std::chrono::nanoseconds idle_time{0};
+
+        /*!
+         * \brief The most tasks that have been waiting in any one of this worker's queues, as seen just after the worker
+         * pushed a task to it
+         */
+        uint64_t max_queue_depth = 0;
     };
 
     /*!
@@ -78,23 +173,139 @@ namespace nova::ttl {
      */
     class task_scheduler {
     public:
+        /*!
+         * \brief The number of task records in each thread's record pool
+         */
+        constexpr static std::size_t TASK_RECORDS_PER_THREAD = 1024;
+
+        /*!
+         * \brief The size of the stack that each task runs on
+         */
+        constexpr static std::size_t FIBER_STACK_SIZE = 512 * 1024;
+
+        /*!
+         * \brief How many tasks a worker runs between checks of the lower-priority lanes before the higher ones
+         */
+        constexpr static std::size_t STARVATION_GUARD_INTERVAL = 32;
+
+        /*!
+         * \brief The counters behind `worker_stats`
+         *
+         * Each counter is only ever written by the worker it belongs to, so updating one is a plain load and store
+         * rather than a locked read-modify-write. They're atomic so that `get_worker_stats` can read them from any
+         * thread
+         */
+        struct alignas(CACHE_LINE_SIZE) worker_counters {
+            std::atomic<uint64_t> tasks_executed = 0;
+            std::atomic<uint64_t> fibers_resumed = 0;
+            std::atomic<uint64_t> pops = 0;
+            std::atomic<uint64_t> external_pops = 0;
+            std::atomic<uint64_t> steal_attempts = 0;
+            std::atomic<uint64_t> steals = 0;
+            std::atomic<uint64_t> busy_nanoseconds = 0;
+            std::atomic<uint64_t> idle_nanoseconds = 0;
+            std::atomic<uint64_t> max_queue_depth = 0;
+        };
+
         /*!
          * \brief Data that each thread needs
          */
         struct per_thread_data {
             /*!
-             * \brief A queue of all the tasks this thread needs to execute
+             * \brief The tasks this thread needs to execute, one queue for each task_priority
              */
-            std::unique_ptr<wait_free_queue<std::function<void()>>> task_queue;
+            std::array<std::unique_ptr<wait_free_queue<task_record*>>, NUM_TASK_PRIORITIES> task_queues;
+
+            /*!
+             * \brief The records that tasks submitted from this thread are stored in
+             */
+            std::unique_ptr<task_record_pool> record_pool;
+
             /*!
              * \brief The index of the queue we last stole from
              */
             std::size_t last_successful_steal = 0;
 
-            std::unique_ptr<std::mutex> things_in_queue_mutex;
-            std::unique_ptr<std::condition_variable> things_in_queue_cv;
+            /*!
+             * \brief The other workers, in the order this thread tries to steal from them
+             */
+            std::vector<std::size_t> steal_order;
+
+            /*!
+             * \brief The CPU this thread is pinned to, if it's pinned
+             */
+            std::optional<logical_cpu> cpu;
+
+            /*!
+             * \brief The number of tasks this thread has run since it last looked at the lowest-priority lane first
+             */
+            std::size_t tasks_since_starvation_check = 0;
+
+            /*!
+             * \brief What this thread has been up to, for profiling
+             */
+            std::unique_ptr<worker_counters> counters;
+
+            /*!
+             * \brief The scheduler this thread belongs to, so that fibers can find their way home
+             */
+            task_scheduler* scheduler = nullptr;
+
+            /*!
+             * \brief Every fiber this thread has created
+             *
+             * Fibers never move between threads. A thread creates a new fiber whenever all of its existing fibers are
+             * running or suspended, so a suspended task can never stop its thread from running other tasks
+             */
+            std::vector<std::unique_ptr<fiber>> fibers;
+
+            /*!
+             * \brief Fibers which aren't running or suspended
+             */
+            std::vector<fiber*> free_fibers;
+
+            /*!
+             * \brief The task that the next fiber to start should run
+             */
+            task_record* next_fiber_task = nullptr;
+
+            /*!
+             * \brief Suspended fibers which are ready to carry on
+             *
+             * Fibers are made ready by whichever thread finishes what they were waiting for, so this is guarded by
+             * `ready_fibers_mutex`
+             */
+            std::vector<fiber*> ready_fibers;
+            std::unique_ptr<std::mutex> ready_fibers_mutex;
+            std::unique_ptr<std::atomic<std::size_t>> num_ready_fibers;
+
+            /*!
+             * \brief Where this thread sleeps when there's nothing to do and `behavior_of_empty_queues` is SLEEP
+             *
+             * Only this thread waits on it, so a fiber that's ready to carry on can wake up its own thread without
+             * waking anyone else
+             */
+            std::unique_ptr<event_count> wakeup;
+
+            /*!
+             * \brief True while this thread is asleep or about to go to sleep
+             *
+             * Whoever changes it back to false decrements `num_sleeping_workers`
+             */
             std::unique_ptr<std::atomic<bool>> is_sleeping;
 
+            /*!
+             * \brief Fibers whose tasks called `yield_current_task`, oldest first
+             *
+             * Only ever touched by this thread, since a fiber can only yield on the thread it belongs to
+             */
+            std::vector<fiber*> yielded_fibers;
+
+            /*!
+             * \brief The number of tasks this thread has started since it last resumed a yielded fiber
+             */
+            std::size_t tasks_since_yielded_fiber_ran = 0;
+
             per_thread_data();
 
             per_thread_data(per_thread_data&& other) noexcept = default;
@@ -111,8 +322,9 @@ namespace nova::ttl {
          *
          * \param num_threads The number of threads for this thread pool
          * \param behavior The behavior of empty task queues. See \enum empty_queue_behavior for more info
+         * \param placement Whether to pin workers to CPUs. See \enum worker_placement for more info
          */
-        task_scheduler(uint32_t num_threads, empty_queue_behavior behavior);
+        task_scheduler(uint32_t num_threads, empty_queue_behavior behavior, worker_placement placement = worker_placement::UNPINNED);
 
         task_scheduler(task_scheduler&& other) noexcept = default;
         task_scheduler& operator=(task_scheduler&& other) noexcept = default;
@@ -199,18 +411,264 @@ namespace nova::ttl {
             return future;
         }
 
+        /*!
+         * \brief Adds a task to the internal queue without producing a future. Does not allocate
+         *
+         * The function and its arguments are stored inline in a task record taken from the calling thread's record
+         * pool, so they must fit in `task_record::inline_storage_size` bytes. Use this for small, fine-grained tasks
+         * where the allocations made by `add_task` would cost more than the task itself
+         *
+         * \tparam F       Function type.
+         * \tparam Args    Arguments to the function. Copied if lvalue. Moved if rvalue. Use std::ref/std::cref for references.
+         *
+         * \param priority The lane to queue the task in
+         * \param function Function to invoke
+         * \param args     Arguments to the function. Copied if lvalue. Moved if rvalue. Use std::ref/std::cref for references.
+         */
+        template <class F, class... Args>
+        auto add_detached_task(const task_priority priority, F&& function, Args&&... args)
+            -> std::enable_if_t<std::is_invocable_v<std::decay_t<F>&, task_scheduler*, std::decay_t<Args>&...>> {
+            add_task_proxy(
+                [this, function = std::forward<F>(function), arguments = std::make_tuple(std::forward<Args>(args)...)]() mutable {
+                    try {
+                        std::apply([&](auto&... unpacked) { function(this, unpacked...); }, arguments);
+                    }
+                    catch(...) {
+                        NOVA_LOG(FATAL) << "Task failed executing!";
+#ifdef NOVA_LINUX
+                        nova_backtrace();
+#endif
+                    }
+                },
+                priority);
+        }
+
+        /*!
+         * \brief Adds a task to the internal queue without producing a future. Does not allocate
+         *
+         * \tparam F       Function type.
+         * \tparam Args    Arguments to the function. Copied if lvalue. Moved if rvalue. Use std::ref/std::cref for references.
+         *
+         * \param priority The lane to queue the task in
+         * \param counter  The counter to decrement when the task has finished
+         * \param function Function to invoke
+         * \param args     Arguments to the function. Copied if lvalue. Moved if rvalue. Use std::ref/std::cref for references.
+         */
+        template <class F, class... Args>
+        auto add_detached_task(const task_priority priority, condition_counter* counter, F&& function, Args&&... args)
+            -> std::enable_if_t<std::is_invocable_v<std::decay_t<F>&, task_scheduler*, std::decay_t<Args>&...>> {
+            counter->add(1);
+            add_task_proxy(
+                [this, counter, function = std::forward<F>(function), arguments = std::make_tuple(std::forward<Args>(args)...)]() mutable {
+                    try {
+                        std::apply([&](auto&... unpacked) { function(this, unpacked...); }, arguments);
+                    }
+                    catch(...) {
+                        NOVA_LOG(FATAL) << "Task failed executing!";
+#ifdef NOVA_LINUX
+                        nova_backtrace();
+#endif
+                    }
+                    counter->sub(1);
+                },
+                priority);
+        }
+
+        /*!
+         * \brief Adds a task with normal priority to the internal queue without producing a future. Does not allocate
+         */
+        template <class F, class... Args>
+        auto add_detached_task(F&& function, Args&&... args)
+            -> std::enable_if_t<std::is_invocable_v<std::decay_t<F>&, task_scheduler*, std::decay_t<Args>&...>> {
+            add_detached_task(task_priority::NORMAL, std::forward<F>(function), std::forward<Args>(args)...);
+        }
+
+        /*!
+         * \brief Adds a task with normal priority to the internal queue without producing a future. Does not allocate
+         */
+        template <class F, class... Args>
+        auto add_detached_task(condition_counter* counter, F&& function, Args&&... args)
+            -> std::enable_if_t<std::is_invocable_v<std::decay_t<F>&, task_scheduler*, std::decay_t<Args>&...>> {
+            add_detached_task(task_priority::NORMAL, counter, std::forward<F>(function), std::forward<Args>(args)...);
+        }
+
+        /*!
+         * \brief Adds a task for every index in [begin, end), which calls `function(scheduler, index)`
+         *
+         * Rather than queueing one task per index up front, this queues one task per worker, each of which owns a
+         * slice of the range. When a worker starts on a slice it keeps splitting it in half and queueing the top half,
+         * where idle workers can steal it, until it's down to a single index. So submitting costs the same no matter
+         * how big the range is, and sleeping workers are only woken once there's something for them to do
+         *
+         * `counter` is incremented once for each task before the task is queued, so waiting for it to reach zero
+         * waits for every index. `function` is copied into each task, so it must be cheap to copy and small enough
+         * to fit in a task record next to a couple of indices
+         *
+         * \param priority The lane to queue the tasks in
+         * \param counter The counter to decrement as each task finishes
+         * \param begin The first index
+         * \param end One past the last index
+         * \param function The function to call for each index. Calls for different indices may happen concurrently
+         */
+        template <class F>
+        auto add_detached_tasks(
+            const task_priority priority, condition_counter* counter, const std::size_t begin, const std::size_t end, F&& function)
+            -> std::enable_if_t<std::is_invocable_v<std::decay_t<F>&, task_scheduler*, std::size_t>> {
+            if(end <= begin) {
+                return;
+            }
+
+            // Any more slices than there are workers and the extra ones would only get split up by whoever took
+            // them, which the first slices would do anyway
+            const std::size_t num_indices = end - begin;
+            const std::size_t num_slices = std::min<std::size_t>(num_indices, num_threads);
+            const std::size_t slice_size = num_indices / num_slices;
+            const std::size_t num_bigger_slices = num_indices % num_slices;
+
+            counter->add(static_cast<uint32_t>(num_slices));
+
+            std::size_t slice_begin = begin;
+            for(std::size_t i = 0; i < num_slices; i++) {
+                const std::size_t slice_end = slice_begin + slice_size + (i < num_bigger_slices ? 1 : 0);
+
+                task_record* record = allocate_task_record();
+                record->emplace([this, counter, function, slice_begin, slice_end, priority]() mutable {
+                    run_index_range(priority, counter, function, slice_begin, slice_end);
+                });
+                push_task(record, priority);
+
+                slice_begin = slice_end;
+            }
+
+            wake_workers(num_slices);
+        }
+
+        /*!
+         * \brief Adds a task with normal priority for every index in [begin, end)
+         */
+        template <class F>
+        auto add_detached_tasks(condition_counter* counter, const std::size_t begin, const std::size_t end, F&& function)
+            -> std::enable_if_t<std::is_invocable_v<std::decay_t<F>&, task_scheduler*, std::size_t>> {
+            add_detached_tasks(task_priority::NORMAL, counter, begin, end, std::forward<F>(function));
+        }
+
+        /*!
+         * \brief Adds a task for each callable in [first, last), then wakes as many workers as the tasks can keep busy
+         *
+         * Each element is copied into a task record, and called as `element(scheduler)`. The tasks are all queued
+         * before any sleeping workers are woken, and `counter` is incremented once for the whole batch
+         *
+         * \param priority The lane to queue the tasks in
+         * \param counter The counter to decrement as each task finishes
+         * \param first An iterator to the first callable
+         * \param last An iterator one past the last callable
+         */
+        template <class ForwardIt>
+        auto add_detached_tasks(const task_priority priority, condition_counter* counter, ForwardIt first, ForwardIt last)
+            -> std::enable_if_t<std::is_invocable_v<typename std::iterator_traits<ForwardIt>::value_type&, task_scheduler*>> {
+            const auto num_tasks = static_cast<std::size_t>(std::distance(first, last));
+            if(num_tasks == 0) {
+                return;
+            }
+
+            counter->add(static_cast<uint32_t>(num_tasks));
+
+            for(; first != last; ++first) {
+                task_record* record = allocate_task_record();
+                record->emplace([this, counter, function = *first]() mutable {
+                    try {
+                        function(this);
+                    }
+                    catch(...) {
+                        NOVA_LOG(FATAL) << "Task failed executing!";
+#ifdef NOVA_LINUX
+                        nova_backtrace();
+#endif
+                    }
+                    counter->sub(1);
+                });
+                push_task(record, priority);
+            }
+
+            wake_workers(num_tasks);
+        }
+
+        /*!
+         * \brief Adds a task with normal priority for each callable in [first, last)
+         */
+        template <class ForwardIt>
+        auto add_detached_tasks(condition_counter* counter, ForwardIt first, ForwardIt last)
+            -> std::enable_if_t<std::is_invocable_v<typename std::iterator_traits<ForwardIt>::value_type&, task_scheduler*>> {
+            add_detached_tasks(task_priority::NORMAL, counter, first, last);
+        }
+
+        /*!
+         * \brief Lets the calling thread run other tasks before it carries on with the current one
+         *
+         * If called from a task, the task's fiber is suspended and the worker goes off to run something else. The
+         * task carries on once its worker runs out of other work, or after `STARVATION_GUARD_INTERVAL` more tasks,
+         * whichever comes first. Threads outside the pool yield to the OS instead
+         */
+        void yield_current_task();
+
+        /*!
+         * \brief Waits until `is_done()` returns true, running other tasks in the meantime
+         *
+         * Use this to wait for things that can't wake up a condition_counter, like a VkFence or a std::future:
+         *
+         * `scheduler->wait_until([&] { return vkGetFenceStatus(device, fence) != VK_NOT_READY; });`
+         *
+         * `is_done` is polled from the waiting task between other tasks, and continuously when the worker has
+         * nothing else to do
+         */
+        template <typename Predicate>
+        void wait_until(Predicate&& is_done) {
+            while(!is_done()) {
+                yield_current_task();
+            }
+        }
+
+        /*!
+         * \brief Gets the number of tasks waiting in a lane, across every worker's queue and the external queue
+         *
+         * The queues are changing under our feet, so this is only an estimate. It's meant for profiling
+         */
+        [[nodiscard]] std::size_t get_queue_depth(task_priority priority) const;
+
+        /*!
+         * \brief Gets a snapshot of what each worker has done since this scheduler was created
+         *
+         * Workers keep updating their counters while the snapshot is taken, so the counters in the snapshot may not
+         * all be from exactly the same moment. Diff two snapshots to see what happened between them
+         *
+         * \return One worker_stats for each worker, indexed by thread index
+         */
+        [[nodiscard]] std::vector<worker_stats> get_worker_stats() const;
+
         /*!
          * \brief Gets the index of the current thread
          *
-         * Gets the ID of the thread this method is called from. Loops through all the threads that TTL knows about,
-         * comparing their IDs to our ID. If a match is found, the index of that thread is returned. If not, an
-         * exception is thrown
+         * Each worker records its index in thread-local storage when it starts, so this is a single thread-local
+         * read. Threads that aren't part of this pool all share the external thread index, which is one past the
+         * index of the last worker. This lets per-thread resources be stored in an array of `get_num_threads() + 1`
+         * elements, with the last element belonging to whichever outside thread drives Nova
          *
-         * \return The index of the calling thread
+         * \return The index of the calling thread, or `get_external_thread_idx()` if the calling thread is not one of
+         * this pool's workers
          */
-        std::size_t get_current_thread_idx();
+        [[nodiscard]] std::size_t get_current_thread_idx() const;
 
-        friend void thread_func(task_scheduler* pool);
+        /*!
+         * \brief Gets the index that threads outside of this pool are identified by
+         */
+        [[nodiscard]] std::size_t get_external_thread_idx() const;
+
+        /*!
+         * \brief Checks if the calling thread is one of this pool's workers
+         */
+        [[nodiscard]] bool is_worker_thread() const;
+
+        friend void thread_func(task_scheduler* pool, std::size_t thread_idx);
 
         [[nodiscard]] uint32_t get_num_threads() const;
 
@@ -222,25 +680,116 @@ namespace nova::ttl {
         std::unique_ptr<std::atomic<bool>> should_shutdown;
 
         empty_queue_behavior behavior_of_empty_queues = empty_queue_behavior::YIELD;
-        task_queue_search_behavior behavior_of_task_queue_search = task_queue_search_behavior::NEXT;
+
+        /*!
+         * \brief The number of workers whose `is_sleeping` is true
+         *
+         * Every new task checks this, which costs a fence and a load when no workers are asleep
+         */
+        std::unique_ptr<std::atomic<uint32_t>> num_sleeping_workers;
+
         bool initialized = false;
         std::unique_ptr<std::mutex> initialized_mutex;
         std::unique_ptr<std::condition_variable> initialized_cv;
 
-        uint32_t last_task_queue_index = 0;
+        /*!
+         * \brief Tasks submitted from threads outside the pool
+         *
+         * A worker's task queue may only be pushed to by that worker, so threads outside the pool put their tasks
+         * here instead. Workers check this queue after their own queue and before stealing. There's one queue for
+         * each task_priority
+         */
+        std::array<std::unique_ptr<injection_queue<task_record*>>, NUM_TASK_PRIORITIES> external_tasks;
+
+        /*!
+         * \brief A record pool that threads outside the pool share
+         *
+         * A task_record_pool may only be allocated from by one thread at a time, so each of these has a mutex.
+         * Outside threads are spread over `NUM_EXTERNAL_RECORD_POOLS` of them, so that several threads submitting at
+         * once rarely need the same mutex
+         */
+        struct external_record_pool {
+            std::mutex mutex;
+            task_record_pool pool{TASK_RECORDS_PER_THREAD};
+        };
+
+        constexpr static std::size_t NUM_EXTERNAL_RECORD_POOLS = 4;
+
+        std::unique_ptr<external_record_pool[]> external_record_pools;
+
+        /*!
+         * \brief Gets an empty task record from the calling thread's record pool
+         */
+        task_record* allocate_task_record();
 
         /*!
          * \brief Adds a task to the internal queue.
          *
          * \param task       The task to queue
          */
-        void add_task(std::function<void()> task);
+        void add_task(task_record* task, task_priority priority);
+
+        /*!
+         * \brief Adds a task to the calling worker's queue, or the external queue, without waking anyone up
+         */
+        void push_task(task_record* task, task_priority priority);
+
+        /*!
+         * \brief Wakes up enough sleeping workers to run `num_tasks` new tasks, if workers sleep when they're idle
+         */
+        void wake_workers(std::size_t num_tasks);
+
+        /*!
+         * \brief Marks a worker as awake, if it was marked as asleep
+         */
+        void stop_sleeping(per_thread_data& tls);
+
         /*!
-         * \brief Proxy to add_task because the compiler cannot be sure which add_task
-         *           to use for lambdas
+         * \brief Runs `function` for every index in [begin, end), splitting the top half off into a new task for as
+         * long as there's more than one index left
+         */
+        template <typename F>
+        void run_index_range(const task_priority priority, condition_counter* counter, F& function, const std::size_t begin, std::size_t end) {
+            while(end - begin > 1) {
+                const std::size_t middle = begin + (end - begin) / 2;
+
+                auto top_half = [this, counter, function, middle, end, priority]() mutable {
+                    run_index_range(priority, counter, function, middle, end);
+                };
+
+                counter->add(1);
+                add_task_proxy(std::move(top_half), priority);
+
+                end = middle;
+            }
+
+            try {
+                function(this, begin);
+            }
+            catch(...) {
+                NOVA_LOG(FATAL) << "Task failed executing!";
+#ifdef NOVA_LINUX
+                nova_backtrace();
+#endif
+            }
+
+            counter->sub(1);
+        }
+
+        /*!
+         * \brief Stores a callable in a task record from the calling thread's pool and queues it
+         *
+         * Proxy to add_task because the compiler cannot be sure which add_task to use for lambdas
+         *
          * \param task The task to queue
+         * \param priority The lane to queue the task in
          */
-        void add_task_proxy(std::function<void()> task);
+        template <typename Callable>
+        void add_task_proxy(Callable&& task, const task_priority priority = task_priority::NORMAL) {
+            task_record* record = allocate_task_record();
+            record->emplace(std::forward<Callable>(task));
+            add_task(record, priority);
+        }
 
         /*!
          * \brief Attempts to get the next task, returning success
@@ -248,8 +797,48 @@ namespace nova::ttl {
          * \param task The memory to write the next task to
          * \return True if there was a task, false if there was not
          */
-        bool get_next_task(std::function<void()>* task);
+        bool get_next_task(task_record** task);
+
+        /*!
+         * \brief Attempts to get a task from one lane of our own queue, the external queue, or another thread's queue
+         */
+        bool get_next_task_with_priority(task_record** task, task_priority priority);
+
+        /*!
+         * \brief Tries to steal a task from one lane of another worker's queue
+         */
+        bool steal_from(per_thread_data& tls, std::size_t victim_idx, std::size_t lane, task_record** task);
+
+        /*!
+         * \brief Resumes a ready fiber or starts a new task, if the current thread has either
+         *
+         * \return True if anything ran, false if there was nothing to do
+         */
+        bool run_next_task();
+
+        /*!
+         * \brief Runs a task on one of the current thread's fibers
+         *
+         * Returns when the task finishes, or when it suspends to wait on a condition_counter
+         */
+        void execute_task(task_record* task);
+
+        /*!
+         * \brief Executes a task, then returns its record to the pool it came from
+         */
+        void run_task(task_record* task);
+
+        /*!
+         * \brief Runs tasks on a fiber. Each time the fiber is resumed it runs `next_fiber_task`, puts itself back on
+         * the free list, and yields
+         */
+        static void fiber_main(fiber* self);
+
+        /*!
+         * \brief Queues a suspended fiber to be resumed by the thread it belongs to
+         */
+        static void make_fiber_ready(fiber* self);
     };
 
-    void thread_func(task_scheduler* pool);
+    void thread_func(task_scheduler* pool, std::size_t thread_idx);
 } // namespace nova::ttl
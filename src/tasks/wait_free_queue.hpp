@@ -32,20 +32,41 @@
 
 #include <atomic>
 #include <cassert>
+#include <cstdint>
 #include <memory>
-#include <vector>
+#include <type_traits>
 
 constexpr static size_t CACHE_LINE_SIZE = 64;
 
 namespace nova::ttl {
 
+    /*!
+     * \brief A work-stealing deque. The owning thread pushes and pops at the bottom, other threads steal from the top
+     *
+     * Slots are atomics, so a thief can read a slot while the owner writes another one without a data race. That
+     * means `T` has to be trivially copyable. Store a pointer to anything bigger, like the scheduler does with
+     * task_records, so that pushing and stealing never copy more than a pointer
+     *
+     * When the queue fills up it moves into an array twice the size. Thieves may still be reading the old array, so
+     * it's retired rather than deleted. Every thief counts itself in `stealers_in_flight` for the duration of a steal,
+     * and the owner deletes retired arrays the next time it sees that count at zero. A thief which arrives after the
+     * switch can only see the new array, so once the count has been zero, nobody can be reading the retired ones.
+     * After a burst, the owner can call `shrink` to move back into a smaller array
+     */
     template <typename T>
     class wait_free_queue {
+        static_assert(std::is_trivially_copyable_v<T>, "wait_free_queue slots are atomics, so T must be trivially copyable");
+
     public:
+        /*!
+         * \brief The number of slots a queue starts with, and the smallest number `shrink` will go down to
+         */
+        constexpr static std::size_t INITIAL_CAPACITY = 32;
+
         wait_free_queue()
             : m_top(1),    // m_top and m_bottom must start at 1
               m_bottom(1), // Otherwise, the first Pop on an empty queue will underflow m_bottom
-              m_array(new circular_array(32)) {}
+              m_array(new circular_array(INITIAL_CAPACITY)) {}
 
         wait_free_queue(wait_free_queue&& other) = delete;
         wait_free_queue& operator=(wait_free_queue&& other) noexcept = delete;
@@ -56,34 +77,39 @@ namespace nova::ttl {
         ~wait_free_queue() {
             // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
             delete m_array.load(std::memory_order_relaxed);
+            delete_retired_arrays();
         }
 
     private:
         class circular_array {
         public:
-            explicit circular_array(std::size_t n) : items(n) {
+            explicit circular_array(std::size_t n) : items(new std::atomic<T>[n]), num_items(n) {
                 // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-array-to-pointer-decay)
                 assert(n != 0 && !(n & (n - 1)) && "n must be a power of 2");
             }
 
         private:
-            std::vector<T> items;
-            std::unique_ptr<circular_array> previous;
+            std::unique_ptr<std::atomic<T>[]> items;
+            std::size_t num_items;
 
         public:
-            [[nodiscard]] std::size_t size() const { return items.size(); }
+            /*!
+             * \brief The next array in the owner's list of retired arrays
+             */
+            circular_array* next_retired = nullptr;
+
+            [[nodiscard]] std::size_t size() const { return num_items; }
 
-            T get(std::size_t index) { return items[index & (size() - 1)]; }
+            T get(std::size_t index) const { return items[index & (num_items - 1)].load(std::memory_order_relaxed); }
 
-            void put(std::size_t index, T x) { items[index & (size() - 1)] = x; }
+            void put(std::size_t index, T x) { items[index & (num_items - 1)].store(x, std::memory_order_relaxed); }
 
-            // Growing the array returns a new circular_array object and keeps a
-            // linked list of all previous arrays. This is done because other threads
-            // could still be accessing elements from the smaller arrays.
-            circular_array* grow(std::size_t top, std::size_t bottom) {
+            /*!
+             * \brief Makes a new array with `new_size` slots, holding the elements in [top, bottom)
+             */
+            circular_array* resize(std::size_t new_size, std::size_t top, std::size_t bottom) const {
                 // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
-                auto* new_array = new circular_array(size() * 2);
-                new_array->previous.reset(this);
+                auto* new_array = new circular_array(new_size);
                 for(std::size_t i = top; i != bottom; i++) {
                     new_array->put(i, get(i));
                 }
@@ -95,7 +121,48 @@ namespace nova::ttl {
         alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> m_bottom;
         alignas(CACHE_LINE_SIZE) std::atomic<circular_array*> m_array;
 
+        /*!
+         * \brief The number of threads which are part-way through `steal`
+         */
+        alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> stealers_in_flight = 0;
+
+        /*!
+         * \brief Arrays that the queue has moved out of, which thieves may still be reading. Only touched by the owner
+         */
+        circular_array* retired_arrays = nullptr;
+
+        /*!
+         * \brief Switches to a new array, and retires the current one
+         */
+        void replace_array(circular_array* old_array, circular_array* new_array) {
+            // Sequentially consistent, so that any thief which counts itself in after we check `stealers_in_flight`
+            // is guaranteed to see the new array
+            m_array.store(new_array, std::memory_order_seq_cst);
+
+            old_array->next_retired = retired_arrays;
+            retired_arrays = old_array;
+        }
+
+        void reclaim_retired_arrays() {
+            if(retired_arrays != nullptr && stealers_in_flight.load(std::memory_order_seq_cst) == 0) {
+                delete_retired_arrays();
+            }
+        }
+
+        void delete_retired_arrays() {
+            while(retired_arrays != nullptr) {
+                circular_array* array = retired_arrays;
+                retired_arrays = array->next_retired;
+
+                // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
+                delete array;
+            }
+        }
+
     public:
+        /*!
+         * \brief Adds an element to the bottom of the queue. Must only be called by the owner
+         */
         void push(T value) {
             uint64_t b = m_bottom.load(std::memory_order_relaxed);
             uint64_t t = m_top.load(std::memory_order_acquire);
@@ -103,20 +170,22 @@ namespace nova::ttl {
 
             if(b - t > array->size() - 1) {
                 /* Full queue. */
-                array = array->grow(t, b);
-                m_array.store(array, std::memory_order_release);
+                circular_array* new_array = array->resize(array->size() * 2, t, b);
+                replace_array(array, new_array);
+                array = new_array;
             }
             array->put(b, value);
 
-#if defined(FTL_STRONG_MEMORY_MODEL)
-            std::atomic_signal_fence(std::memory_order_release);
-#else
-            std::atomic_thread_fence(std::memory_order_release);
-#endif
+            // A release store rather than a release fence and a relaxed store, which the thread sanitizer can't see
+            // through. They compile to the same thing
+            m_bottom.store(b + 1, std::memory_order_release);
 
-            m_bottom.store(b + 1, std::memory_order_relaxed);
+            reclaim_retired_arrays();
         }
 
+        /*!
+         * \brief Takes an element from the bottom of the queue. Must only be called by the owner
+         */
         bool pop(T* value) {
             uint64_t b = m_bottom.load(std::memory_order_relaxed) - 1;
             circular_array* array = m_array.load(std::memory_order_relaxed);
@@ -150,7 +219,12 @@ namespace nova::ttl {
             return result;
         }
 
+        /*!
+         * \brief Takes an element from the top of the queue. May be called by any thread
+         */
         bool steal(T* value) {
+            stealers_in_flight.fetch_add(1, std::memory_order_seq_cst);
+
             uint64_t t = m_top.load(std::memory_order_acquire);
 
 #if defined(FTL_STRONG_MEMORY_MODEL)
@@ -160,22 +234,60 @@ namespace nova::ttl {
 #endif
 
             uint64_t b = m_bottom.load(std::memory_order_acquire);
+            bool result = false;
             if(t < b) {
                 /* Non-empty queue. */
-                circular_array* array = m_array.load(std::memory_order_consume);
-                *value = array->get(t);
-
-                return std::atomic_compare_exchange_strong_explicit(&m_top,
-                                                                    &t,
-                                                                    t + 1,
-                                                                    std::memory_order_seq_cst,
-                                                                    std::memory_order_relaxed);
+                circular_array* array = m_array.load(std::memory_order_seq_cst);
+                const T item = array->get(t);
+
+                if(std::atomic_compare_exchange_strong_explicit(&m_top, &t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                    *value = item;
+                    result = true;
+                }
             }
 
-            return false;
+            stealers_in_flight.fetch_sub(1, std::memory_order_release);
+
+            return result;
         }
 
+        /*!
+         * \brief Moves into a smaller array if the queue is using less than a quarter of its current one, and frees
+         * any retired arrays which nobody can be reading. Must only be called by the owner
+         */
+        void shrink() {
+            circular_array* array = m_array.load(std::memory_order_relaxed);
+            if(array->size() > INITIAL_CAPACITY) {
+                const uint64_t b = m_bottom.load(std::memory_order_relaxed);
+                const uint64_t t = m_top.load(std::memory_order_acquire);
+                const uint64_t count = b > t ? b - t : 0;
+
+                std::size_t new_size = array->size();
+                while(new_size / 2 >= INITIAL_CAPACITY && count * 4 <= new_size) {
+                    new_size /= 2;
+                }
+
+                if(new_size != array->size()) {
+                    replace_array(array, array->resize(new_size, t, b));
+                }
+            }
+
+            reclaim_retired_arrays();
+        }
+
+        /*!
+         * \brief Gets the number of slots in the current array
+         */
         size_t size() { return m_array.load(std::memory_order_relaxed)->size(); }
+
+        /*!
+         * \brief Gets roughly how many elements are in the queue. May be out of date by the time it returns
+         */
+        [[nodiscard]] size_t approximate_count() const {
+            const uint64_t t = m_top.load(std::memory_order_relaxed);
+            const uint64_t b = m_bottom.load(std::memory_order_relaxed);
+            return b > t ? static_cast<size_t>(b - t) : 0;
+        }
     };
 
 } // namespace nova::ttl
@@ -0,0 +1,221 @@
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <list>
+#include <optional>
+#include <random>
+#include <vector>
+
+#include "../../../src/render_engine/tlsf_allocator.hpp"
+
+#include <benchmark/benchmark.h>
+
+using namespace nova::renderer;
+
+/*!
+ * \brief One step of an allocation trace
+ */
+struct trace_event {
+    bool is_allocation = true;
+
+    /*!
+     * \brief Names the allocation, so that a later free can refer to it. IDs are dense and start at 0
+     */
+    uint32_t id = 0;
+
+    /*!
+     * \brief The size of the allocation. Unused for frees
+     */
+    uint64_t size = 0;
+};
+
+struct allocation_trace {
+    uint64_t buffer_size = 0;
+    uint32_t num_ids = 0;
+    std::vector<trace_event> events;
+};
+
+/*!
+ * \brief Loads a trace from a text file
+ *
+ * The first line is the size of the buffer being allocated from. Every line after that is either `a <id> <size>` for an
+ * allocation or `f <id>` for a free
+ */
+std::optional<allocation_trace> load_trace(const char* path) {
+    std::ifstream file(path);
+    allocation_trace trace;
+    if(!(file >> trace.buffer_size)) {
+        return {};
+    }
+
+    char type;
+    while(file >> type) {
+        trace_event event;
+        event.is_allocation = type == 'a';
+        file >> event.id;
+        if(event.is_allocation) {
+            file >> event.size;
+        }
+        trace.num_ids = std::max(trace.num_ids, event.id + 1);
+        trace.events.push_back(event);
+    }
+
+    return trace;
+}
+
+/*!
+ * \brief Makes a trace that looks like a player flying over a chunked world: lots of meshes get loaded, then old
+ * chunks are unloaded as new ones load in
+ */
+allocation_trace make_chunk_churn_trace(const uint32_t num_live_meshes, const uint32_t num_churn_steps) {
+    allocation_trace trace;
+    trace.buffer_size = 1024 * 1024 * 1024;
+
+    // Always the same trace, so that results from different runs can be compared
+    std::mt19937 rng(0x6e6f7661);
+    std::uniform_int_distribution<uint64_t> size_dist(1024, 64 * 1024);
+
+    std::vector<uint32_t> live;
+    const auto allocate = [&] {
+        trace.events.push_back({true, trace.num_ids, size_dist(rng)});
+        live.push_back(trace.num_ids);
+        trace.num_ids++;
+    };
+
+    for(uint32_t i = 0; i < num_live_meshes; i++) {
+        allocate();
+    }
+
+    for(uint32_t i = 0; i < num_churn_steps; i++) {
+        const std::size_t victim = rng() % live.size();
+        trace.events.push_back({false, live[victim], 0});
+        live[victim] = live.back();
+        live.pop_back();
+
+        allocate();
+    }
+
+    return trace;
+}
+
+/*!
+ * \brief Replays the trace from the file named by the NOVA_ALLOCATION_TRACE environment variable, or a generated one if
+ * that's not set
+ */
+const allocation_trace& get_trace() {
+    static const allocation_trace trace = [] {
+        if(const char* path = std::getenv("NOVA_ALLOCATION_TRACE")) {
+            if(auto loaded = load_trace(path)) {
+                return *loaded;
+            }
+            std::cerr << "Could not read allocation trace " << path << ", using a generated one\n";
+        }
+
+        return make_chunk_churn_trace(4096, 16384);
+    }();
+
+    return trace;
+}
+
+/*!
+ * \brief How compacting_block_allocator found free space before it used tlsf_allocator: first fit from a sorted list
+ * of blocks, and a walk of the list to find the block to free
+ */
+class first_fit_list_allocator {
+public:
+    explicit first_fit_list_allocator(const uint64_t size) { blocks.push_back({0, size, true}); }
+
+    std::optional<tlsf_allocator::allocation> allocate(const uint64_t size) {
+        for(auto it = blocks.begin(); it != blocks.end(); ++it) {
+            if(!it->free || it->size < size) {
+                continue;
+            }
+
+            if(it->size > size) {
+                blocks.insert(std::next(it), {it->offset + size, it->size - size, true});
+            }
+
+            it->size = size;
+            it->free = false;
+            return tlsf_allocator::allocation{0, it->offset, size};
+        }
+
+        return {};
+    }
+
+    void free(const tlsf_allocator::allocation& allocation) {
+        auto it = blocks.begin();
+        while(it != blocks.end() && it->offset != allocation.offset) {
+            ++it;
+        }
+
+        it->free = true;
+
+        if(it != blocks.begin() && std::prev(it)->free) {
+            auto prev = std::prev(it);
+            prev->size += it->size;
+            blocks.erase(it);
+            it = prev;
+        }
+
+        if(auto next = std::next(it); next != blocks.end() && next->free) {
+            it->size += next->size;
+            blocks.erase(next);
+        }
+    }
+
+private:
+    struct block {
+        uint64_t offset;
+        uint64_t size;
+        bool free;
+    };
+
+    std::list<block> blocks;
+};
+
+class tlsf_adapter {
+public:
+    explicit tlsf_adapter(const uint64_t size) : allocator(size) {}
+
+    std::optional<tlsf_allocator::allocation> allocate(const uint64_t size) { return allocator.allocate(size); }
+
+    void free(const tlsf_allocator::allocation& allocation) { allocator.free(allocation.block); }
+
+private:
+    tlsf_allocator allocator;
+};
+
+template <typename AllocatorType>
+void BM_ReplayAllocationTrace(benchmark::State& state) {
+    const allocation_trace& trace = get_trace();
+
+    uint32_t num_failed = 0;
+    for(auto _ : state) {
+        AllocatorType allocator(trace.buffer_size);
+        std::vector<std::optional<tlsf_allocator::allocation>> allocations(trace.num_ids);
+        num_failed = 0;
+
+        for(const trace_event& event : trace.events) {
+            if(event.is_allocation) {
+                allocations[event.id] = allocator.allocate(event.size);
+                if(!allocations[event.id]) {
+                    num_failed++;
+                }
+
+            } else if(allocations[event.id]) {
+                allocator.free(*allocations[event.id]);
+                allocations[event.id].reset();
+            }
+        }
+
+        benchmark::DoNotOptimize(allocations.data());
+    }
+
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * trace.events.size()));
+    state.counters["failed_allocations"] = num_failed;
+}
+
+BENCHMARK_TEMPLATE(BM_ReplayAllocationTrace, tlsf_adapter)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_ReplayAllocationTrace, first_fit_list_allocator)->Unit(benchmark::kMillisecond);
@@ -0,0 +1,54 @@
+#include <condition_variable>
+#include <mutex>
+
+#include "../../../src/tasks/condition_counter.hpp"
+
+#include <benchmark/benchmark.h>
+
+using namespace nova::ttl;
+
+/*!
+ * \brief The mutex-based condition_counter that the lock-free one replaced, kept here to compare against
+ */
+class mutex_condition_counter {
+public:
+    void add(const uint32_t num) {
+        std::unique_lock l(mut);
+        counter += num;
+        if(counter == wait_val) {
+            cv.notify_all();
+        }
+    }
+
+    void sub(const uint32_t num) {
+        std::unique_lock l(mut);
+        counter -= (counter < num) ? counter : num;
+        if(counter == wait_val) {
+            cv.notify_all();
+        }
+    }
+
+private:
+    std::mutex mut;
+    std::condition_variable cv;
+
+    uint32_t counter = 0;
+    uint32_t wait_val = 0;
+};
+
+/*!
+ * \brief Every thread adds to and subtracts from the same counter, like thousands of small tasks finishing at once
+ */
+template <typename Counter>
+static void BM_CounterContention(benchmark::State& state) {
+    static Counter counter;
+
+    for(auto _ : state) {
+        counter.add(1);
+        counter.sub(1);
+    }
+
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * 2);
+}
+BENCHMARK_TEMPLATE(BM_CounterContention, condition_counter)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_CounterContention, mutex_condition_counter)->ThreadRange(1, 8)->UseRealTime();
@@ -0,0 +1,58 @@
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../../../src/tasks/injection_queue.hpp"
+
+#include <benchmark/benchmark.h>
+
+using namespace nova::ttl;
+
+/*!
+ * \brief What the scheduler used for tasks from outside the pool before injection_queue
+ */
+template <typename T>
+class mutex_queue {
+public:
+    void push(const T& value) {
+        std::lock_guard l(mutex);
+        items.push_back(value);
+    }
+
+    bool pop(T* value) {
+        std::lock_guard l(mutex);
+        if(items.empty()) {
+            return false;
+        }
+
+        *value = items.front();
+        items.pop_front();
+        return true;
+    }
+
+private:
+    std::mutex mutex;
+    std::deque<T> items;
+};
+
+/*!
+ * \brief Every benchmark thread pushes an element then pops one, so producers and consumers fight over the queue
+ */
+template <typename Queue>
+static void BM_MultiProducerPushPop(benchmark::State& state) {
+    // Shared by every thread in the benchmark. Each iteration pops as much as it pushes, so it's empty between runs
+    static Queue queue;
+
+    uint64_t value = 0;
+    for(auto _ : state) {
+        queue.push(value++);
+        queue.pop(&value);
+        benchmark::DoNotOptimize(value);
+    }
+
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+BENCHMARK_TEMPLATE(BM_MultiProducerPushPop, injection_queue<uint64_t>)->ThreadRange(1, 4)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_MultiProducerPushPop, mutex_queue<uint64_t>)->ThreadRange(1, 4)->UseRealTime();
@@ -0,0 +1,80 @@
+#include <cmath>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "../../../src/tasks/parallel_algorithms.hpp"
+
+#include <benchmark/benchmark.h>
+
+using namespace nova::ttl;
+
+constexpr std::size_t NUM_ELEMENTS = 1 << 20;
+
+/*!
+ * \brief Each benchmark runs with every thread count from 1 up to this, to show how well it scales
+ */
+static const int MAX_THREADS = static_cast<int>(std::max(std::thread::hardware_concurrency(), 1U));
+
+/*!
+ * \brief A loop body that does enough work per element that splitting the loop up is worth it, like transforming a
+ * model matrix
+ */
+static void BM_ParallelFor(benchmark::State& state) {
+    task_scheduler scheduler(static_cast<uint32_t>(state.range(0)), empty_queue_behavior::SLEEP);
+    std::vector<float> values(NUM_ELEMENTS, 1.0F);
+
+    for(auto _ : state) {
+        parallel_for(&scheduler, 0, values.size(), [&](const std::size_t i) { values[i] = std::sqrt(values[i] * 1.0001F + 0.5F); });
+        benchmark::ClobberMemory();
+    }
+
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * NUM_ELEMENTS));
+}
+BENCHMARK(BM_ParallelFor)->DenseRange(1, MAX_THREADS)->UseRealTime();
+
+static void BM_ParallelReduce(benchmark::State& state) {
+    task_scheduler scheduler(static_cast<uint32_t>(state.range(0)), empty_queue_behavior::SLEEP);
+    std::vector<float> values(NUM_ELEMENTS, 1.0F);
+
+    for(auto _ : state) {
+        const float sum = parallel_reduce(
+            &scheduler,
+            0,
+            values.size(),
+            0.0F,
+            [&](const std::size_t begin, const std::size_t end, float partial) {
+                for(std::size_t i = begin; i < end; i++) {
+                    partial += values[i];
+                }
+                return partial;
+            },
+            [](const float a, const float b) { return a + b; });
+        benchmark::DoNotOptimize(sum);
+    }
+
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * NUM_ELEMENTS));
+}
+BENCHMARK(BM_ParallelReduce)->DenseRange(1, MAX_THREADS)->UseRealTime();
+
+static void BM_ParallelSort(benchmark::State& state) {
+    task_scheduler scheduler(static_cast<uint32_t>(state.range(0)), empty_queue_behavior::SLEEP);
+
+    std::mt19937 rng(1234);
+    std::vector<uint32_t> unsorted(NUM_ELEMENTS);
+    for(uint32_t& value : unsorted) {
+        value = static_cast<uint32_t>(rng());
+    }
+
+    std::vector<uint32_t> values;
+    for(auto _ : state) {
+        state.PauseTiming();
+        values = unsorted;
+        state.ResumeTiming();
+
+        parallel_sort(&scheduler, values.begin(), values.end());
+    }
+
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * NUM_ELEMENTS));
+}
+BENCHMARK(BM_ParallelSort)->DenseRange(1, MAX_THREADS)->UseRealTime();
@@ -0,0 +1,335 @@
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <thread>
+
+#include "../../../src/tasks/task_scheduler.hpp"
+
+#include <benchmark/benchmark.h>
+
+using namespace nova::ttl;
+
+constexpr uint32_t TASKS_PER_ITERATION = 4096;
+
+static void empty_task(task_scheduler* /* scheduler */) {}
+
+static const char* behavior_name(const empty_queue_behavior behavior) {
+    switch(behavior) {
+        case empty_queue_behavior::SPIN:
+            return "SPIN";
+        case empty_queue_behavior::YIELD:
+            return "YIELD";
+        case empty_queue_behavior::SLEEP:
+            return "SLEEP";
+    }
+
+    return "";
+}
+
+/*!
+ * \brief Submits tasks through the future-returning add_task, which allocates for every task
+ */
+static void BM_SubmitTaskWithFuture(benchmark::State& state) {
+    condition_counter counter;
+    task_scheduler scheduler(static_cast<uint32_t>(state.range(0)), empty_queue_behavior::YIELD);
+
+    for(auto _ : state) {
+        for(uint32_t i = 0; i < TASKS_PER_ITERATION; i++) {
+            benchmark::DoNotOptimize(scheduler.add_task(&counter, empty_task));
+        }
+        counter.wait_for_value(0);
+    }
+
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * TASKS_PER_ITERATION);
+}
+BENCHMARK(BM_SubmitTaskWithFuture)->RangeMultiplier(2)->Range(1, 8)->UseRealTime();
+
+/*!
+ * \brief Submits tasks through add_detached_task, which stores them inline in pooled task records
+ */
+static void BM_SubmitDetachedTask(benchmark::State& state) {
+    condition_counter counter;
+    task_scheduler scheduler(static_cast<uint32_t>(state.range(0)), empty_queue_behavior::YIELD);
+
+    for(auto _ : state) {
+        for(uint32_t i = 0; i < TASKS_PER_ITERATION; i++) {
+            scheduler.add_detached_task(&counter, empty_task);
+        }
+        counter.wait_for_value(0);
+    }
+
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * TASKS_PER_ITERATION);
+}
+BENCHMARK(BM_SubmitDetachedTask)->RangeMultiplier(2)->Range(1, 8)->UseRealTime();
+
+/*!
+ * \brief Runs tasks which each fan out into subtasks and wait for them, like nested parallel frame work does
+ *
+ * Waiting parents suspend their fiber rather than blocking their worker, so this scales with the number of workers
+ * instead of deadlocking when every worker is waiting
+ */
+static void BM_NestedForkJoin(benchmark::State& state) {
+    constexpr uint32_t NUM_PARENTS = 64;
+    constexpr uint32_t CHILDREN_PER_PARENT = 64;
+
+    condition_counter counter;
+    task_scheduler scheduler(static_cast<uint32_t>(state.range(0)), empty_queue_behavior::SLEEP);
+
+    for(auto _ : state) {
+        for(uint32_t i = 0; i < NUM_PARENTS; i++) {
+            scheduler.add_detached_task(&counter, [](task_scheduler* pool) {
+                condition_counter children;
+                for(uint32_t j = 0; j < CHILDREN_PER_PARENT; j++) {
+                    pool->add_detached_task(&children, empty_task);
+                }
+                children.wait_for_value(0);
+            });
+        }
+        counter.wait_for_value(0);
+    }
+
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * NUM_PARENTS * (CHILDREN_PER_PARENT + 1));
+}
+BENCHMARK(BM_NestedForkJoin)->RangeMultiplier(2)->Range(1, 8)->UseRealTime();
+
+/*!
+ * \brief Measures how long an idle scheduler takes to start running a task, for each empty_queue_behavior
+ */
+static void BM_WakeUpLatency(benchmark::State& state) {
+    const auto behavior = static_cast<empty_queue_behavior>(state.range(0));
+    state.SetLabel(behavior_name(behavior));
+
+    std::atomic<std::chrono::steady_clock::time_point::rep> task_start_time = 0;
+    condition_counter counter;
+    task_scheduler scheduler(2, behavior);
+
+    for(auto _ : state) {
+        // Let the workers go idle so that we measure waking them, not a worker that happens to be polling
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+        const auto submit_time = std::chrono::steady_clock::now();
+        scheduler.add_detached_task(&counter, [&task_start_time](task_scheduler* /* scheduler */) {
+            task_start_time.store(std::chrono::steady_clock::now().time_since_epoch().count());
+        });
+        counter.wait_for_value(0);
+
+        const std::chrono::steady_clock::time_point start_time{std::chrono::steady_clock::duration(task_start_time.load())};
+        state.SetIterationTime(std::chrono::duration<double>(start_time - submit_time).count());
+    }
+}
+BENCHMARK(BM_WakeUpLatency)->DenseRange(0, 2)->Iterations(200)->UseManualTime();
+
+/*!
+ * \brief Measures how much CPU time an idle scheduler burns, for each empty_queue_behavior
+ *
+ * The `cpu_cores_while_idle` counter is the number of cores that the scheduler's workers kept busy while there was
+ * nothing for them to do
+ */
+static void BM_IdleCpuUsage(benchmark::State& state) {
+    const auto behavior = static_cast<empty_queue_behavior>(state.range(0));
+    state.SetLabel(behavior_name(behavior));
+
+    task_scheduler scheduler(2, behavior);
+
+    double total_cpu_seconds = 0;
+    double total_wall_seconds = 0;
+
+    for(auto _ : state) {
+        // std::clock measures CPU time used by the whole process, and this thread is asleep, so it's all the workers
+        const std::clock_t cpu_start = std::clock();
+        const auto wall_start = std::chrono::steady_clock::now();
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+        total_cpu_seconds += static_cast<double>(std::clock() - cpu_start) / CLOCKS_PER_SEC;
+        total_wall_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+    }
+
+    state.counters["cpu_cores_while_idle"] = total_cpu_seconds / total_wall_seconds;
+}
+BENCHMARK(BM_IdleCpuUsage)->DenseRange(0, 2)->Iterations(5)->UseRealTime();
+
+/*!
+ * \brief Measures how long a task waits to start while the pool is flooded with background work
+ *
+ * Argument 0 submits the task as frame-critical, argument 1 submits it with the same priority as the flood
+ */
+static void BM_LatencyUnderBackgroundLoad(benchmark::State& state) {
+    constexpr uint32_t BACKGROUND_TASKS = 1024;
+    const task_priority priority = state.range(0) == 0 ? task_priority::FRAME_CRITICAL : task_priority::BACKGROUND;
+    state.SetLabel(priority == task_priority::FRAME_CRITICAL ? "FRAME_CRITICAL" : "BACKGROUND");
+
+    std::atomic<std::chrono::steady_clock::time_point::rep> task_start_time = 0;
+    condition_counter background_counter;
+    condition_counter counter;
+    task_scheduler scheduler(2, empty_queue_behavior::SLEEP);
+
+    for(auto _ : state) {
+        for(uint32_t i = 0; i < BACKGROUND_TASKS; i++) {
+            scheduler.add_detached_task(task_priority::BACKGROUND, &background_counter, [](task_scheduler* /* scheduler */) {
+                const auto end = std::chrono::steady_clock::now() + std::chrono::microseconds(2);
+                while(std::chrono::steady_clock::now() < end) {
+                }
+            });
+        }
+
+        const auto submit_time = std::chrono::steady_clock::now();
+        scheduler.add_detached_task(priority, &counter, [&task_start_time](task_scheduler* /* scheduler */) {
+            task_start_time.store(std::chrono::steady_clock::now().time_since_epoch().count());
+        });
+        counter.wait_for_value(0);
+
+        const std::chrono::steady_clock::time_point start_time{std::chrono::steady_clock::duration(task_start_time.load())};
+        state.SetIterationTime(std::chrono::duration<double>(start_time - submit_time).count());
+
+        background_counter.wait_for_value(0);
+    }
+}
+BENCHMARK(BM_LatencyUnderBackgroundLoad)->DenseRange(0, 1)->Iterations(100)->UseManualTime();
+
+/*!
+ * \brief Times how long it takes to submit 16k tasks, one add_detached_task at a time (0) or with a single
+ * add_detached_tasks over an index range (1). Only the submission is timed, not running the tasks
+ */
+static void BM_SubmitBatch(benchmark::State& state) {
+    constexpr std::size_t NUM_TASKS = 16384;
+
+    const bool batched = state.range(0) == 1;
+    state.SetLabel(batched ? "add_detached_tasks" : "add_detached_task");
+
+    condition_counter counter;
+    task_scheduler scheduler(std::max(std::thread::hardware_concurrency(), 1U), empty_queue_behavior::SLEEP);
+
+    for(auto _ : state) {
+        const auto start = std::chrono::steady_clock::now();
+
+        if(batched) {
+            scheduler.add_detached_tasks(&counter, 0, NUM_TASKS, [](task_scheduler* /* scheduler */, const std::size_t i) {
+                benchmark::DoNotOptimize(i);
+            });
+
+        } else {
+            for(std::size_t i = 0; i < NUM_TASKS; i++) {
+                scheduler.add_detached_task(&counter, [](task_scheduler* /* scheduler */, const std::size_t index) {
+                    benchmark::DoNotOptimize(index);
+                }, i);
+            }
+        }
+
+        const auto end = std::chrono::steady_clock::now();
+        state.SetIterationTime(std::chrono::duration<double>(end - start).count());
+
+        counter.wait_for_value(0);
+    }
+
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * NUM_TASKS));
+}
+BENCHMARK(BM_SubmitBatch)->DenseRange(0, 1)->Iterations(100)->UseManualTime();
+
+/*!
+ * \brief Measures how long a task waits between being submitted and starting, on a pool whose workers are polling
+ * for work rather than asleep
+ *
+ * Argument 0 submits from outside the pool, through the injection queue. Argument 1 submits from a task, to the
+ * worker's own queue, where either the other worker steals it or the submitting worker pops it once the submitting
+ * task suspends
+ */
+static void BM_SubmitToExecuteLatency(benchmark::State& state) {
+    const bool from_worker = state.range(0) == 1;
+    state.SetLabel(from_worker ? "from worker" : "from outside");
+
+    std::atomic<std::chrono::steady_clock::time_point::rep> task_start_time = 0;
+    condition_counter counter;
+    task_scheduler scheduler(2, empty_queue_behavior::SPIN);
+
+    const auto submit = [&task_start_time](task_scheduler* pool, condition_counter* task_counter) {
+        const auto submit_time = std::chrono::steady_clock::now();
+        pool->add_detached_task(task_counter, [&task_start_time](task_scheduler* /* scheduler */) {
+            task_start_time.store(std::chrono::steady_clock::now().time_since_epoch().count());
+        });
+
+        return submit_time;
+    };
+
+    for(auto _ : state) {
+        std::chrono::steady_clock::time_point submit_time;
+
+        if(from_worker) {
+            condition_counter submitter_done;
+            scheduler.add_detached_task(&submitter_done, [&](task_scheduler* pool) {
+                submit_time = submit(pool, &counter);
+                counter.wait_for_value(0);
+            });
+            submitter_done.wait_for_value(0);
+
+        } else {
+            submit_time = submit(&scheduler, &counter);
+            counter.wait_for_value(0);
+        }
+
+        const std::chrono::steady_clock::time_point start_time{std::chrono::steady_clock::duration(task_start_time.load())};
+        state.SetIterationTime(std::chrono::duration<double>(start_time - submit_time).count());
+    }
+}
+BENCHMARK(BM_SubmitToExecuteLatency)->DenseRange(0, 1)->Iterations(1000)->UseManualTime();
+
+/*!
+ * \brief Runs empty tasks submitted from inside the pool, so the time is all scheduler overhead: allocating the
+ * record, pushing, popping or stealing, switching to a fiber and freeing the record
+ */
+static void BM_EmptyTaskThroughput(benchmark::State& state) {
+    condition_counter counter;
+    task_scheduler scheduler(static_cast<uint32_t>(state.range(0)), empty_queue_behavior::SPIN);
+
+    for(auto _ : state) {
+        scheduler.add_detached_task(&counter, [](task_scheduler* pool) {
+            condition_counter children;
+            for(uint32_t i = 0; i < TASKS_PER_ITERATION; i++) {
+                pool->add_detached_task(&children, empty_task);
+            }
+            children.wait_for_value(0);
+        });
+        counter.wait_for_value(0);
+    }
+
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * TASKS_PER_ITERATION);
+}
+BENCHMARK(BM_EmptyTaskThroughput)->RangeMultiplier(2)->Range(1, 8)->UseRealTime();
+
+/*!
+ * \brief Forks a task into two children and waits for them, recursively, down to the given depth
+ */
+static void fork_join(task_scheduler* scheduler, const uint32_t depth) {
+    if(depth == 0) {
+        return;
+    }
+
+    condition_counter children;
+    scheduler->add_detached_task(&children, fork_join, depth - 1);
+    scheduler->add_detached_task(&children, fork_join, depth - 1);
+    children.wait_for_value(0);
+}
+
+/*!
+ * \brief Runs a binary tree of fork/join tasks, `state.range(0)` levels deep, on every core
+ *
+ * Every level has a parent suspended on its fiber while its children run, so this shows how the cost of waiting grows
+ * with the depth of the tree
+ */
+static void BM_ForkJoinDepth(benchmark::State& state) {
+    const auto depth = static_cast<uint32_t>(state.range(0));
+
+    condition_counter counter;
+    task_scheduler scheduler(std::max(std::thread::hardware_concurrency(), 1U), empty_queue_behavior::SLEEP);
+
+    for(auto _ : state) {
+        scheduler.add_detached_task(&counter, fork_join, depth);
+        counter.wait_for_value(0);
+    }
+
+    // A tree with `depth` levels below the root has 2^(depth + 1) - 1 nodes
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * ((int64_t{1} << (depth + 1)) - 1));
+}
+BENCHMARK(BM_ForkJoinDepth)->DenseRange(4, 12, 4)->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,71 @@
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "../../../src/tasks/wait_free_queue.hpp"
+
+#include <benchmark/benchmark.h>
+
+using namespace nova::ttl;
+
+constexpr uint32_t ELEMENTS_PER_ITERATION = 1024;
+
+/*!
+ * \brief The owner pushes a batch of elements then pops them all, with nobody stealing
+ */
+static void BM_WaitFreeQueuePushPop(benchmark::State& state) {
+    wait_free_queue<uint64_t> queue;
+
+    for(auto _ : state) {
+        for(uint64_t i = 0; i < ELEMENTS_PER_ITERATION; i++) {
+            queue.push(i);
+        }
+
+        uint64_t value = 0;
+        while(queue.pop(&value)) {
+            benchmark::DoNotOptimize(value);
+        }
+    }
+
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * ELEMENTS_PER_ITERATION);
+}
+BENCHMARK(BM_WaitFreeQueuePushPop);
+
+/*!
+ * \brief The owner pushes a batch of elements, and `state.range(0)` thieves race it to take them
+ */
+static void BM_WaitFreeQueuePushSteal(benchmark::State& state) {
+    wait_free_queue<uint64_t> queue;
+    std::atomic<bool> done = false;
+
+    std::vector<std::thread> thieves;
+    for(int64_t i = 0; i < state.range(0); i++) {
+        thieves.emplace_back([&] {
+            uint64_t value = 0;
+            while(!done.load(std::memory_order_relaxed)) {
+                if(queue.steal(&value)) {
+                    benchmark::DoNotOptimize(value);
+                }
+            }
+        });
+    }
+
+    for(auto _ : state) {
+        for(uint64_t i = 0; i < ELEMENTS_PER_ITERATION; i++) {
+            queue.push(i);
+        }
+
+        uint64_t value = 0;
+        while(queue.pop(&value)) {
+            benchmark::DoNotOptimize(value);
+        }
+    }
+
+    done = true;
+    for(std::thread& thief : thieves) {
+        thief.join();
+    }
+
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * ELEMENTS_PER_ITERATION);
+}
+BENCHMARK(BM_WaitFreeQueuePushSteal)->DenseRange(1, 3)->UseRealTime();
@@ -68,8 +68,8 @@ layout(location = 2) out vec2 lightmap_uv;
 layout(location = 3) out vec3 normal;
 
 void main() {
-    int model_matrix_index = gl_InstanceIndex - gl_BaseInstance;
-	gl_Position = /*gbufferProjection * gbufferModelView * gbufferModel */ modelMatrices[model_matrix_index] * vec4(position_in, 1.0f);
+    // Nova puts each draw's model matrices at firstInstance, so gl_InstanceIndex is the index of this instance's matrix
+	gl_Position = /*gbufferProjection * gbufferModelView * gbufferModel */ modelMatrices[gl_InstanceIndex] * vec4(position_in, 1.0f);
 
 	uv = uv_in;
  	color = color_in;
@@ -0,0 +1,113 @@
+#include "../../../../src/loading/shaderpack/render_graph_builder.hpp"
+#include "../../../src/general_test_setup.hpp"
+#undef TEST
+#include <gtest/gtest.h>
+
+using namespace nova::renderer;
+
+namespace {
+    texture_resource_data make_texture(const std::string& name, const pixel_format_enum pixel_format = pixel_format_enum::RGBA8) {
+        texture_resource_data texture;
+        texture.name = name;
+        texture.format.pixel_format = pixel_format;
+        texture.format.dimension_type = texture_dimension_type_enum::ScreenRelative;
+        texture.format.width = 1;
+        texture.format.height = 1;
+        return texture;
+    }
+
+    render_pass_data make_pass(const std::string& name, const std::vector<std::string>& inputs, const std::vector<std::string>& outputs) {
+        render_pass_data pass;
+        pass.name = name;
+        pass.texture_inputs = inputs;
+        for(const std::string& output : outputs) {
+            texture_attachment attachment;
+            attachment.name = output;
+            pass.texture_outputs.push_back(attachment);
+        }
+        return pass;
+    }
+
+    std::unordered_map<std::string, std::string> alias_textures(const std::vector<texture_resource_data>& texture_list,
+                                                                const std::vector<render_pass_data>& passes) {
+        std::unordered_map<std::string, texture_resource_data> textures;
+        for(const texture_resource_data& texture : texture_list) {
+            textures[texture.name] = texture;
+        }
+
+        std::unordered_map<std::string, range> resource_used_range;
+        std::vector<std::string> resources_in_order;
+        determine_usage_order_of_textures(passes, resource_used_range, resources_in_order);
+
+        return determine_aliasing_of_textures(textures, resource_used_range, resources_in_order);
+    }
+} // namespace
+
+TEST(RenderGraphBuilder, TexturesUsedInOnePassHaveAUsageRange) {
+    TEST_SETUP_LOGGER();
+
+    std::unordered_map<std::string, range> resource_used_range;
+    std::vector<std::string> resources_in_order;
+    determine_usage_order_of_textures({make_pass("A", {}, {"First"}), make_pass("B", {"First"}, {"Second"})},
+                                      resource_used_range,
+                                      resources_in_order);
+
+    EXPECT_EQ(resources_in_order, (std::vector<std::string>{"First", "Second"}));
+
+    const range& first = resource_used_range.at("First");
+    EXPECT_EQ(first.first_used_pass(), 0);
+    EXPECT_EQ(first.last_used_pass(), 1);
+
+    const range& second = resource_used_range.at("Second");
+    EXPECT_TRUE(second.is_used());
+    EXPECT_EQ(second.first_used_pass(), 1);
+    EXPECT_EQ(second.last_used_pass(), 1);
+}
+
+TEST(RenderGraphBuilder, DisjointTexturesWithTheSameFormatAreAliased) {
+    TEST_SETUP_LOGGER();
+
+    const auto aliases = alias_textures({make_texture("GBuffer"), make_texture("Lit"), make_texture("Bloom"), make_texture("Final")},
+                                        {make_pass("Geometry", {}, {"GBuffer"}),
+                                         make_pass("Lighting", {"GBuffer"}, {"Lit"}),
+                                         make_pass("Bloom", {"Lit"}, {"Bloom"}),
+                                         make_pass("Composite", {"Bloom"}, {"Final"})});
+
+    // GBuffer is done before Bloom starts, and Lit is done before Final starts
+    EXPECT_EQ(aliases.size(), 2);
+    EXPECT_EQ(aliases.at("Bloom"), "GBuffer");
+    EXPECT_EQ(aliases.at("Final"), "Lit");
+}
+
+TEST(RenderGraphBuilder, TexturesAreOnlyAliasedWithGroupsTheyDontOverlap) {
+    TEST_SETUP_LOGGER();
+
+    // C doesn't overlap A, but it does overlap B, which already shares A's memory
+    const auto aliases = alias_textures({make_texture("A"), make_texture("B"), make_texture("C")},
+                                        {make_pass("1", {}, {"A"}),
+                                         make_pass("2", {"A"}, {}),
+                                         make_pass("3", {}, {"B", "C"}),
+                                         make_pass("4", {"B", "C"}, {})});
+
+    EXPECT_EQ(aliases.at("B"), "A");
+    EXPECT_EQ(aliases.count("C"), 0);
+}
+
+TEST(RenderGraphBuilder, TexturesWithDifferentFormatsAreNotAliased) {
+    TEST_SETUP_LOGGER();
+
+    const auto aliases = alias_textures({make_texture("Color"), make_texture("Hdr", pixel_format_enum::RGBA16F)},
+                                        {make_pass("1", {}, {"Color"}), make_pass("2", {"Color"}, {}), make_pass("3", {}, {"Hdr"})});
+
+    EXPECT_TRUE(aliases.empty());
+}
+
+TEST(RenderGraphBuilder, TexturesReadBeforeTheyreWrittenAreNotAliased) {
+    TEST_SETUP_LOGGER();
+
+    // History is read before it's written, so it has to keep its contents from the last frame
+    const auto aliases = alias_textures({make_texture("Scratch"), make_texture("History")},
+                                        {make_pass("1", {}, {"Scratch"}), make_pass("2", {"History"}, {}), make_pass("3", {}, {"History"})});
+
+    EXPECT_TRUE(aliases.empty());
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+/*!
+ * \brief Checks that no two allocations overlap and that they all fit in `size` bytes
+ *
+ * Works with any allocation type that has `offset` and `size` members
+ */
+template <typename AllocationType>
+void expect_disjoint(std::vector<AllocationType> allocations, const uint64_t size) {
+    std::sort(allocations.begin(), allocations.end(), [](const auto& a, const auto& b) { return a.offset < b.offset; });
+
+    for(std::size_t i = 0; i < allocations.size(); i++) {
+        EXPECT_LE(allocations[i].offset + allocations[i].size, size);
+        if(i > 0) {
+            EXPECT_LE(allocations[i - 1].offset + allocations[i - 1].size, allocations[i].offset);
+        }
+    }
+}
@@ -0,0 +1,108 @@
+#include <random>
+#include <vector>
+
+#include "../../../src/render_engine/best_fit_allocator.hpp"
+#undef TEST
+#include <gtest/gtest.h>
+
+#include "allocator_test_helpers.hpp"
+
+using namespace nova::renderer;
+
+TEST(BestFitAllocator, PicksTheSmallestRangeThatFits) {
+    best_fit_allocator allocator(1000);
+
+    // Make free ranges of 100, 300 and 50 bytes, with allocations between them
+    std::vector<best_fit_allocator::range> allocations;
+    for(const uint64_t size : {100, 10, 300, 10, 50, 10}) {
+        const auto allocation = allocator.allocate(size);
+        ASSERT_TRUE(allocation.has_value());
+        allocations.push_back(*allocation);
+    }
+    allocator.free(allocations[0]);
+    allocator.free(allocations[2]);
+    allocator.free(allocations[4]);
+
+    const auto small = allocator.allocate(40);
+    ASSERT_TRUE(small.has_value());
+    EXPECT_EQ(small->offset, allocations[4].offset);
+
+    const auto medium = allocator.allocate(90);
+    ASSERT_TRUE(medium.has_value());
+    EXPECT_EQ(medium->offset, allocations[0].offset);
+
+    const auto large = allocator.allocate(250);
+    ASSERT_TRUE(large.has_value());
+    EXPECT_EQ(large->offset, allocations[2].offset);
+}
+
+TEST(BestFitAllocator, SizesAreRoundedToTheGranularity) {
+    best_fit_allocator allocator(4096, 256);
+
+    for(const uint64_t size : {1, 255, 256, 257, 0}) {
+        const auto allocation = allocator.allocate(size);
+        ASSERT_TRUE(allocation.has_value());
+        EXPECT_EQ(allocation->offset % 256, 0U);
+        EXPECT_EQ(allocation->size % 256, 0U);
+        EXPECT_GE(allocation->size, size);
+    }
+}
+
+TEST(BestFitAllocator, FreeingMergesBothNeighbours) {
+    best_fit_allocator allocator(300);
+
+    const auto first = allocator.allocate(100);
+    const auto second = allocator.allocate(100);
+    const auto third = allocator.allocate(100);
+    ASSERT_TRUE(first.has_value());
+    ASSERT_TRUE(second.has_value());
+    ASSERT_TRUE(third.has_value());
+    EXPECT_FALSE(allocator.allocate(1).has_value());
+
+    allocator.free(*first);
+    allocator.free(*third);
+    EXPECT_EQ(allocator.get_num_free_ranges(), 2U);
+    EXPECT_FLOAT_EQ(allocator.get_fragmentation(), 0.5f);
+
+    allocator.free(*second);
+    EXPECT_EQ(allocator.get_num_free_ranges(), 1U);
+    EXPECT_EQ(allocator.get_largest_free_range(), 300U);
+    EXPECT_FLOAT_EQ(allocator.get_fragmentation(), 0.0f);
+}
+
+TEST(BestFitAllocator, RandomAllocationsNeverOverlap) {
+    constexpr uint64_t SIZE = 1024 * 1024;
+    best_fit_allocator allocator(SIZE, 16);
+
+    std::mt19937 rng(1234);
+    std::uniform_int_distribution<uint64_t> size_dist(1, 8192);
+
+    std::vector<best_fit_allocator::range> live;
+    for(uint32_t i = 0; i < 20000; i++) {
+        if(live.empty() || rng() % 3 != 0) {
+            if(const auto allocation = allocator.allocate(size_dist(rng))) {
+                live.push_back(*allocation);
+            }
+
+        } else {
+            const std::size_t victim = rng() % live.size();
+            allocator.free(live[victim]);
+            live[victim] = live.back();
+            live.pop_back();
+        }
+    }
+
+    expect_disjoint(live, SIZE);
+
+    uint64_t used = 0;
+    for(const auto& allocation : live) {
+        used += allocation.size;
+    }
+    EXPECT_EQ(allocator.get_free_size(), SIZE - used);
+
+    for(const auto& allocation : live) {
+        allocator.free(allocation);
+    }
+    EXPECT_EQ(allocator.get_num_free_ranges(), 1U);
+    EXPECT_TRUE(allocator.allocate(SIZE).has_value());
+}
@@ -0,0 +1,66 @@
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+#include "../../../src/render_engine/bump_allocator.hpp"
+#include "../../../src/tasks/parallel_algorithms.hpp"
+#undef TEST
+#include <gtest/gtest.h>
+
+using namespace nova::renderer;
+
+TEST(BumpAllocator, AllocationsAreAlignedAndInOrder) {
+    bump_allocator allocator(1024);
+
+    const auto first = allocator.allocate(10);
+    const auto second = allocator.allocate(16, 64);
+    const auto third = allocator.allocate(1, 4);
+    ASSERT_TRUE(first.has_value());
+    ASSERT_TRUE(second.has_value());
+    ASSERT_TRUE(third.has_value());
+
+    EXPECT_EQ(*first, 0U);
+    EXPECT_EQ(*second, 64U);
+    EXPECT_EQ(*third, 80U);
+    EXPECT_EQ(allocator.get_used_size(), 81U);
+}
+
+TEST(BumpAllocator, FailsWhenFullUntilReset) {
+    bump_allocator allocator(256);
+
+    EXPECT_TRUE(allocator.allocate(200).has_value());
+    EXPECT_FALSE(allocator.allocate(57).has_value());
+
+    // Padding that would go past the end counts too
+    EXPECT_FALSE(allocator.allocate(1, 512).has_value());
+    EXPECT_TRUE(allocator.allocate(56).has_value());
+
+    allocator.reset();
+    EXPECT_EQ(allocator.get_used_size(), 0U);
+
+    const auto whole = allocator.allocate(256);
+    ASSERT_TRUE(whole.has_value());
+    EXPECT_EQ(*whole, 0U);
+}
+
+TEST(BumpAllocator, ParallelAllocationsNeverOverlap) {
+    nova::ttl::task_scheduler scheduler(4, nova::ttl::empty_queue_behavior::SLEEP);
+    bump_allocator allocator(1024 * 1024);
+
+    std::mutex offsets_mutex;
+    std::vector<uint64_t> offsets;
+    nova::ttl::parallel_for(&scheduler, 0, 10000, [&](const std::size_t /* i */) {
+        const auto offset = allocator.allocate(48, 16);
+        ASSERT_TRUE(offset.has_value());
+        EXPECT_EQ(*offset % 16, 0U);
+
+        std::lock_guard l(offsets_mutex);
+        offsets.push_back(*offset);
+    });
+
+    std::sort(offsets.begin(), offsets.end());
+    for(std::size_t i = 1; i < offsets.size(); i++) {
+        EXPECT_GE(offsets[i], offsets[i - 1] + 48);
+    }
+    EXPECT_EQ(allocator.get_used_size(), 10000U * 48);
+}
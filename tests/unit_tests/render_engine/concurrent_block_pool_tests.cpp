@@ -0,0 +1,100 @@
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#include "../../../src/render_engine/concurrent_block_pool.hpp"
+#include "../../../src/tasks/parallel_algorithms.hpp"
+#undef TEST
+#include <gtest/gtest.h>
+
+using namespace nova::renderer;
+using namespace nova::ttl;
+
+TEST(ConcurrentBlockPool, HandsOutEveryBlockOnce) {
+    task_scheduler scheduler(1, empty_queue_behavior::SLEEP);
+    concurrent_block_pool pool(100, &scheduler);
+
+    std::vector<concurrent_block_pool::block_index> blocks;
+    while(const auto block = pool.allocate()) {
+        blocks.push_back(*block);
+    }
+
+    ASSERT_EQ(blocks.size(), 100U);
+    std::sort(blocks.begin(), blocks.end());
+    for(uint32_t i = 0; i < blocks.size(); i++) {
+        EXPECT_EQ(blocks[i], i);
+    }
+}
+
+TEST(ConcurrentBlockPool, FreedBlocksCanBeAllocatedAgain) {
+    task_scheduler scheduler(1, empty_queue_behavior::SLEEP);
+    concurrent_block_pool pool(4, &scheduler);
+
+    std::vector<concurrent_block_pool::block_index> blocks(4);
+    ASSERT_EQ(pool.allocate(4, blocks.data()), 4U);
+    EXPECT_FALSE(pool.allocate().has_value());
+
+    pool.free(blocks[2]);
+    const auto block = pool.allocate();
+    ASSERT_TRUE(block.has_value());
+    EXPECT_EQ(*block, blocks[2]);
+}
+
+TEST(ConcurrentBlockPool, BulkOperationsMoveManyBlocks) {
+    task_scheduler scheduler(1, empty_queue_behavior::SLEEP);
+    concurrent_block_pool pool(1000, &scheduler);
+
+    std::vector<concurrent_block_pool::block_index> blocks(1200);
+    EXPECT_EQ(pool.allocate(1200, blocks.data()), 1000U);
+
+    pool.free(blocks.data(), 600);
+    EXPECT_EQ(pool.allocate(1200, blocks.data()), 600U);
+}
+
+TEST(ConcurrentBlockPool, ParallelTasksNeverShareABlock) {
+    constexpr uint32_t NUM_BLOCKS = 4096;
+    task_scheduler scheduler(4, empty_queue_behavior::SLEEP);
+    concurrent_block_pool pool(NUM_BLOCKS, &scheduler);
+
+    std::vector<std::atomic<uint32_t>> owners(NUM_BLOCKS);
+    std::atomic<uint32_t> num_conflicts = 0;
+
+    parallel_for(
+        &scheduler,
+        0,
+        20000,
+        [&](const std::size_t i) {
+            const auto owner = static_cast<uint32_t>(i + 1);
+
+            // Mix single and bulk allocations and frees, so that blocks move between the magazines and the stack
+            concurrent_block_pool::block_index blocks[8];
+            uint32_t count = 0;
+            if(i % 2 == 0) {
+                count = pool.allocate(8, blocks);
+            } else if(const auto block = pool.allocate()) {
+                blocks[0] = *block;
+                count = 1;
+            }
+
+            for(uint32_t b = 0; b < count; b++) {
+                uint32_t expected = 0;
+                if(!owners[blocks[b]].compare_exchange_strong(expected, owner)) {
+                    num_conflicts.fetch_add(1);
+                }
+            }
+            for(uint32_t b = 0; b < count; b++) {
+                owners[blocks[b]].store(0);
+            }
+
+            if(i % 4 == 0) {
+                pool.free(blocks, count);
+            } else {
+                for(uint32_t b = 0; b < count; b++) {
+                    pool.free(blocks[b]);
+                }
+            }
+        },
+        16);
+
+    EXPECT_EQ(num_conflicts.load(), 0U);
+}
@@ -0,0 +1,180 @@
+#include <vector>
+
+#include "../../../src/render_engine/defragmenting_allocator.hpp"
+#undef TEST
+#include <gtest/gtest.h>
+
+using namespace nova::renderer;
+
+namespace {
+    constexpr uint32_t MAX_IN_FLIGHT_FRAMES = 3;
+
+    struct recorded_copy {
+        uint64_t source_offset;
+        uint64_t destination_offset;
+        uint64_t size;
+    };
+
+    /*!
+     * \brief Fills a 256 byte allocator with a 64 byte hole followed by a 64 byte movable allocation, and relocates that
+     * allocation into the hole
+     */
+    class DefragmentingAllocatorTest : public ::testing::Test {
+    protected:
+        defragmenting_allocator allocator{256, 64, MAX_IN_FLIGHT_FRAMES};
+
+        defragmenting_allocator::allocation hole;
+        defragmenting_allocator::allocation moving;
+        defragmenting_allocator::allocation rest;
+
+        std::vector<recorded_copy> copies;
+
+        void SetUp() override {
+            ASSERT_TRUE(allocator.allocate(64, &hole));
+            ASSERT_TRUE(allocator.allocate(64, &moving));
+            ASSERT_TRUE(allocator.allocate(128, &rest));
+
+            allocator.free(&rest);
+            allocator.free(&hole);
+            allocator.make_movable(&moving);
+
+            const auto record_copy = [&](const uint64_t source, const uint64_t destination, const uint64_t size) {
+                copies.push_back({source, destination, size});
+            };
+            ASSERT_EQ(allocator.record_relocations(1024, record_copy), 64);
+        }
+    };
+} // namespace
+
+TEST_F(DefragmentingAllocatorTest, RecordsACopyIntoTheHole) {
+    ASSERT_EQ(copies.size(), 1);
+    EXPECT_EQ(copies[0].source_offset, 64);
+    EXPECT_EQ(copies[0].destination_offset, 0);
+    EXPECT_EQ(copies[0].size, 64);
+}
+
+TEST_F(DefragmentingAllocatorTest, PublishesOnlyAfterTheCopiesFinish) {
+    EXPECT_EQ(moving.offset, 64);
+
+    allocator.advance_frame(false);
+    EXPECT_EQ(moving.offset, 64);
+
+    allocator.advance_frame(true);
+    EXPECT_EQ(moving.offset, 0);
+    EXPECT_EQ(moving.size, 64);
+}
+
+TEST_F(DefragmentingAllocatorTest, DoesNotRecordMoreWhileUnpublished) {
+    defragmenting_allocator::allocation other;
+    ASSERT_TRUE(allocator.allocate(64, &other));
+    allocator.make_movable(&other);
+
+    const uint64_t bytes_moved = allocator.record_relocations(1024, [&](uint64_t, uint64_t, uint64_t) { ADD_FAILURE(); });
+    EXPECT_EQ(bytes_moved, 0);
+}
+
+TEST_F(DefragmentingAllocatorTest, RetiredBlocksAreNotReusedWhileFramesAreInFlight) {
+    allocator.advance_frame(true);
+
+    // The old location of the moved allocation is retired, so only the 128 bytes at the end are free
+    for(uint32_t frame = 1; frame < MAX_IN_FLIGHT_FRAMES; frame++) {
+        defragmenting_allocator::allocation too_big;
+        EXPECT_FALSE(allocator.allocate(192, &too_big));
+
+        allocator.advance_frame(false);
+    }
+
+    defragmenting_allocator::allocation reused;
+    EXPECT_FALSE(allocator.allocate(192, &reused));
+
+    allocator.advance_frame(false);
+    EXPECT_TRUE(allocator.allocate(192, &reused));
+    EXPECT_EQ(reused.offset, 64);
+}
+
+TEST_F(DefragmentingAllocatorTest, FreeingDuringARelocationRetiresBothBlocks) {
+    allocator.free(&moving);
+    EXPECT_EQ(moving.block_id, tlsf_allocator::NO_BLOCK);
+
+    // The copy may still be running, so neither its source nor its destination can be handed out
+    defragmenting_allocator::allocation other;
+    EXPECT_FALSE(allocator.allocate(192, &other));
+
+    allocator.advance_frame(true);
+    EXPECT_EQ(moving.block_id, tlsf_allocator::NO_BLOCK);
+
+    for(uint32_t frame = 0; frame < MAX_IN_FLIGHT_FRAMES; frame++) {
+        EXPECT_FALSE(allocator.allocate(192, &other));
+        allocator.advance_frame(false);
+    }
+
+    EXPECT_EQ(allocator.get_used_size(), 0);
+    EXPECT_TRUE(allocator.allocate(256, &other));
+}
+
+TEST_F(DefragmentingAllocatorTest, IsNotEmptyWhileRelocationsOrRetiredBlocksArePending) {
+    allocator.free(&moving);
+    EXPECT_FALSE(allocator.is_empty());
+
+    allocator.advance_frame(true);
+    EXPECT_FALSE(allocator.is_empty());
+
+    for(uint32_t frame = 1; frame < MAX_IN_FLIGHT_FRAMES; frame++) {
+        allocator.advance_frame(false);
+        EXPECT_FALSE(allocator.is_empty());
+    }
+
+    allocator.advance_frame(false);
+    EXPECT_TRUE(allocator.is_empty());
+}
+
+TEST(DefragmentingAllocator, ScansAgainAfterAHoleOpensUp) {
+    defragmenting_allocator allocator(256, 64, MAX_IN_FLIGHT_FRAMES);
+    const auto record_nothing = [](uint64_t, uint64_t, uint64_t) {};
+
+    defragmenting_allocator::allocation first;
+    defragmenting_allocator::allocation second;
+    ASSERT_TRUE(allocator.allocate(64, &first));
+    ASSERT_TRUE(allocator.allocate(64, &second));
+    allocator.make_movable(&second);
+
+    // There's no hole before the second allocation, so nothing can move until the first one is freed
+    EXPECT_EQ(allocator.record_relocations(1024, record_nothing), 0);
+    EXPECT_EQ(allocator.record_relocations(1024, record_nothing), 0);
+
+    allocator.free(&first);
+    EXPECT_EQ(allocator.record_relocations(1024, record_nothing), 64);
+}
+
+TEST(DefragmentingAllocator, ScansAgainAfterAnAllocationBecomesMovable) {
+    defragmenting_allocator allocator(256, 64, MAX_IN_FLIGHT_FRAMES);
+    const auto record_nothing = [](uint64_t, uint64_t, uint64_t) {};
+
+    defragmenting_allocator::allocation first;
+    defragmenting_allocator::allocation second;
+    ASSERT_TRUE(allocator.allocate(64, &first));
+    ASSERT_TRUE(allocator.allocate(64, &second));
+    allocator.free(&first);
+
+    EXPECT_EQ(allocator.record_relocations(1024, record_nothing), 0);
+
+    allocator.make_movable(&second);
+    EXPECT_EQ(allocator.record_relocations(1024, record_nothing), 64);
+}
+
+TEST(DefragmentingAllocator, BudgetSmallerThanTheGranularityMovesNothing) {
+    defragmenting_allocator allocator(256, 64, MAX_IN_FLIGHT_FRAMES);
+    const auto record_nothing = [](uint64_t, uint64_t, uint64_t) {};
+
+    defragmenting_allocator::allocation first;
+    defragmenting_allocator::allocation second;
+    ASSERT_TRUE(allocator.allocate(64, &first));
+    ASSERT_TRUE(allocator.allocate(64, &second));
+    allocator.free(&first);
+    allocator.make_movable(&second);
+
+    EXPECT_EQ(allocator.record_relocations(32, record_nothing), 0);
+
+    // Running out of budget doesn't mean nothing could move
+    EXPECT_EQ(allocator.record_relocations(64, record_nothing), 64);
+}
@@ -0,0 +1,44 @@
+#include <vector>
+
+#include "../../../src/render_engine/lru_list.hpp"
+#undef TEST
+#include <gtest/gtest.h>
+
+using namespace nova::renderer;
+
+TEST(LruList, IteratesFromLeastRecentlyUsed) {
+    lru_list<int> list;
+    list.touch(1);
+    list.touch(2);
+    list.touch(3);
+    list.touch(1);
+
+    const std::vector<int> order(list.begin(), list.end());
+    EXPECT_EQ(order, (std::vector<int>{2, 3, 1}));
+    EXPECT_EQ(list.size(), 3);
+}
+
+TEST(LruList, RemoveAndErase) {
+    lru_list<int> list;
+    list.touch(1);
+    list.touch(2);
+    list.touch(3);
+
+    list.remove(2);
+    list.remove(42);
+    EXPECT_FALSE(list.contains(2));
+    EXPECT_TRUE(list.contains(3));
+
+    auto itr = list.erase(list.begin());
+    ASSERT_NE(itr, list.end());
+    EXPECT_EQ(*itr, 3);
+    EXPECT_FALSE(list.contains(1));
+
+    list.erase(itr);
+    EXPECT_TRUE(list.empty());
+
+    // Erased keys can come back
+    list.touch(1);
+    EXPECT_TRUE(list.contains(1));
+    EXPECT_EQ(*list.begin(), 1);
+}
@@ -0,0 +1,61 @@
+#include "../../../src/render_engine/memory_budget.hpp"
+#undef TEST
+#include <gtest/gtest.h>
+
+using namespace nova::renderer;
+
+TEST(MemoryBudget, TracksEachCategorySeparately) {
+    memory_budget budget;
+
+    budget.add(memory_category::Meshes, 100);
+    budget.add(memory_category::DynamicTextures, 200);
+    budget.add(memory_category::Meshes, 50);
+    budget.remove(memory_category::DynamicTextures, 150);
+
+    EXPECT_EQ(budget.get_used(memory_category::Meshes), 150);
+    EXPECT_EQ(budget.get_used(memory_category::DynamicTextures), 50);
+    EXPECT_EQ(budget.get_used(memory_category::Staging), 0);
+    EXPECT_EQ(budget.get_total_used(), 200);
+}
+
+TEST(MemoryBudget, ZeroBudgetIsUnlimited) {
+    memory_budget budget(0);
+    budget.add(memory_category::Uniforms, 1ull << 40);
+
+    EXPECT_EQ(budget.get_budget(), memory_budget::UNLIMITED);
+    EXPECT_FALSE(budget.is_over_budget());
+    EXPECT_EQ(budget.get_amount_over_budget(), 0);
+}
+
+TEST(MemoryBudget, UsesTheSmallerOfTheConfiguredAndDeviceBudgets) {
+    memory_budget budget(1000);
+    budget.add(memory_category::Meshes, 800);
+    EXPECT_FALSE(budget.is_over_budget());
+
+    budget.set_device_budget(600);
+    EXPECT_EQ(budget.get_budget(), 600);
+    EXPECT_TRUE(budget.is_over_budget());
+    EXPECT_EQ(budget.get_amount_over_budget(), 200);
+
+    budget.set_device_budget(memory_budget::UNLIMITED);
+    EXPECT_EQ(budget.get_budget(), 1000);
+    EXPECT_FALSE(budget.is_over_budget());
+
+    budget.add(memory_category::DynamicTextures, 300);
+    EXPECT_EQ(budget.get_amount_over_budget(), 100);
+}
+
+TEST(MemoryBudget, HostVisibleMemoryDoesntCountAgainstTheBudget) {
+    memory_budget budget(1000);
+    budget.add(memory_category::Staging, 800);
+    budget.add(memory_category::Uniforms, 800);
+    budget.add(memory_category::Meshes, 500);
+
+    EXPECT_EQ(budget.get_total_used(), 2100);
+    EXPECT_EQ(budget.get_device_local_used(), 500);
+    EXPECT_FALSE(budget.is_over_budget());
+
+    budget.set_used(memory_category::Meshes, 1200);
+    EXPECT_EQ(budget.get_used(memory_category::Meshes), 1200);
+    EXPECT_EQ(budget.get_amount_over_budget(), 200);
+}
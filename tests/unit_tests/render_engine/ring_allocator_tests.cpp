@@ -0,0 +1,128 @@
+#include <random>
+#include <vector>
+
+#include "../../../src/render_engine/ring_allocator.hpp"
+#undef TEST
+#include <gtest/gtest.h>
+
+#include "allocator_test_helpers.hpp"
+
+using namespace nova::renderer;
+
+TEST(RingAllocator, AllocationsAreAligned) {
+    ring_allocator allocator(1024);
+
+    for(const uint64_t size : {1, 7, 16, 33}) {
+        const auto region = allocator.allocate(size, 16);
+        ASSERT_TRUE(region.has_value());
+        EXPECT_EQ(region->offset % 16, 0U);
+        EXPECT_EQ(region->size, size);
+    }
+}
+
+TEST(RingAllocator, FailsWhenFullAndRecoversWhenFreed) {
+    ring_allocator allocator(1024);
+
+    EXPECT_FALSE(allocator.allocate(1025).has_value());
+
+    const auto first = allocator.allocate(512);
+    const auto second = allocator.allocate(512);
+    ASSERT_TRUE(first.has_value());
+    ASSERT_TRUE(second.has_value());
+    EXPECT_EQ(allocator.get_used_size(), 1024U);
+    EXPECT_FALSE(allocator.allocate(1).has_value());
+
+    allocator.free(*first);
+    const auto third = allocator.allocate(512);
+    ASSERT_TRUE(third.has_value());
+    EXPECT_EQ(third->offset, 0U);
+}
+
+TEST(RingAllocator, RegionsWrapInsteadOfStraddlingTheEnd) {
+    ring_allocator allocator(1024);
+
+    const auto first = allocator.allocate(400);
+    const auto second = allocator.allocate(400);
+    ASSERT_TRUE(first.has_value());
+    ASSERT_TRUE(second.has_value());
+    allocator.free(*first);
+
+    // Only 224 bytes are left before the end, so this has to start at the beginning
+    const auto third = allocator.allocate(300);
+    ASSERT_TRUE(third.has_value());
+    EXPECT_EQ(third->offset, 0U);
+
+    // The skipped bytes at the end count as used until the region after them is freed...
+    EXPECT_EQ(allocator.get_used_size(), 400U + 224U + 300U);
+    EXPECT_FALSE(allocator.allocate(200).has_value());
+
+    // ...which is the region that wrapped, so freeing the second region leaves the third and the skipped bytes
+    allocator.free(*second);
+    EXPECT_EQ(allocator.get_used_size(), 224U + 300U);
+    EXPECT_TRUE(allocator.allocate(500).has_value());
+}
+
+TEST(RingAllocator, SpaceIsReclaimedInAllocationOrder) {
+    ring_allocator allocator(1024);
+
+    const auto first = allocator.allocate(256);
+    const auto second = allocator.allocate(256);
+    const auto third = allocator.allocate(256);
+    ASSERT_TRUE(first.has_value());
+    ASSERT_TRUE(second.has_value());
+    ASSERT_TRUE(third.has_value());
+
+    // Freeing a region in the middle doesn't give anything back while an older region is still in use
+    allocator.free(*second);
+    EXPECT_EQ(allocator.get_used_size(), 768U);
+
+    allocator.free(*first);
+    EXPECT_EQ(allocator.get_used_size(), 256U);
+
+    allocator.free(*third);
+    EXPECT_EQ(allocator.get_used_size(), 0U);
+}
+
+TEST(RingAllocator, AnEmptyRingFitsAWholeRingAllocation) {
+    ring_allocator allocator(1024);
+
+    const auto small = allocator.allocate(100);
+    ASSERT_TRUE(small.has_value());
+    allocator.free(*small);
+
+    const auto whole = allocator.allocate(1024);
+    ASSERT_TRUE(whole.has_value());
+    EXPECT_EQ(whole->offset, 0U);
+}
+
+TEST(RingAllocator, RandomRegionsNeverOverlapLiveOnes) {
+    constexpr uint64_t SIZE = 64 * 1024;
+    ring_allocator allocator(SIZE);
+
+    std::mt19937 rng(1234);
+    std::uniform_int_distribution<uint64_t> size_dist(1, 4096);
+
+    std::vector<ring_allocator::region> live;
+    for(uint32_t i = 0; i < 20000; i++) {
+        if(live.empty() || rng() % 2 == 0) {
+            const auto region = allocator.allocate(size_dist(rng), 16);
+            if(!region) {
+                continue;
+            }
+
+            live.push_back(*region);
+            expect_disjoint(live, SIZE);
+
+        } else {
+            // Mostly free the oldest region, like a GPU finishing work in order, but not always
+            const std::size_t victim = rng() % 4 == 0 ? rng() % live.size() : 0;
+            allocator.free(live[victim]);
+            live.erase(live.begin() + static_cast<std::ptrdiff_t>(victim));
+        }
+    }
+
+    for(const auto& region : live) {
+        allocator.free(region);
+    }
+    EXPECT_EQ(allocator.get_used_size(), 0U);
+}
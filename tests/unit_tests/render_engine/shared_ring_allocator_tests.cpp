@@ -0,0 +1,71 @@
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "../../../src/render_engine/shared_ring_allocator.hpp"
+#include "../../../src/tasks/task_scheduler.hpp"
+#undef TEST
+#include <gtest/gtest.h>
+
+using namespace nova::renderer;
+using namespace nova::ttl;
+
+TEST(SharedRingAllocator, StagingMoreThanTheRingFromOneThreadDoesntWait) {
+    task_scheduler scheduler(1, empty_queue_behavior::SLEEP);
+    shared_ring_allocator ring(1024, &scheduler, std::chrono::seconds(10));
+
+    // Nothing ever frees, like a thread that adds meshes without rendering any frames
+    uint32_t num_in_ring = 0;
+    uint32_t num_spilled = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for(uint32_t i = 0; i < 100; i++) {
+        if(ring.allocate(100, 16)) {
+            num_in_ring++;
+        } else {
+            num_spilled++;
+        }
+    }
+
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(1));
+    EXPECT_GT(num_in_ring, 0U);
+    EXPECT_EQ(num_in_ring + num_spilled, 100U);
+    EXPECT_FALSE(ring.allocate(2048).has_value());
+}
+
+TEST(SharedRingAllocator, TasksStopWaitingWhenNothingIsFreed) {
+    task_scheduler scheduler(1, empty_queue_behavior::SLEEP);
+    shared_ring_allocator ring(1024, &scheduler, std::chrono::milliseconds(20));
+
+    const auto full = ring.allocate(1024);
+    ASSERT_TRUE(full.has_value());
+
+    auto result = scheduler.add_task([&](task_scheduler* /* scheduler */) {
+        const auto first_start = std::chrono::steady_clock::now();
+        const bool first = ring.allocate(100).has_value();
+        const auto first_wait = std::chrono::steady_clock::now() - first_start;
+
+        // Nothing has been freed since the first wait ran out, so this one doesn't wait at all
+        const auto second_start = std::chrono::steady_clock::now();
+        const bool second = ring.allocate(100).has_value();
+        const auto second_wait = std::chrono::steady_clock::now() - second_start;
+
+        return !first && !second && first_wait >= std::chrono::milliseconds(20) && second_wait < std::chrono::milliseconds(20);
+    });
+
+    EXPECT_TRUE(result.get());
+}
+
+TEST(SharedRingAllocator, TasksGetSpaceThatIsFreedWhileTheyWait) {
+    task_scheduler scheduler(1, empty_queue_behavior::SLEEP);
+    shared_ring_allocator ring(1024, &scheduler, std::chrono::seconds(10));
+
+    const auto full = ring.allocate(1024);
+    ASSERT_TRUE(full.has_value());
+
+    auto result = scheduler.add_task([&](task_scheduler* /* scheduler */) { return ring.allocate(512).has_value(); });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    ring.free(*full);
+
+    EXPECT_TRUE(result.get());
+}
@@ -0,0 +1,130 @@
+#include <random>
+#include <vector>
+
+#include "../../../src/render_engine/tlsf_allocator.hpp"
+#undef TEST
+#include <gtest/gtest.h>
+
+#include "allocator_test_helpers.hpp"
+
+using namespace nova::renderer;
+
+TEST(TlsfAllocator, AllocationsAreRoundedToTheGranularity) {
+    tlsf_allocator allocator(1024 * 1024, 48);
+
+    std::vector<tlsf_allocator::allocation> allocations;
+    for(uint64_t size : {1, 47, 48, 49, 1000, 4096, 0}) {
+        const auto allocation = allocator.allocate(size);
+        ASSERT_TRUE(allocation.has_value());
+        EXPECT_GE(allocation->size, size);
+        EXPECT_EQ(allocation->size % 48, 0U);
+        EXPECT_EQ(allocation->offset % 48, 0U);
+        allocations.push_back(*allocation);
+    }
+
+    expect_disjoint(allocations, allocator.get_size());
+}
+
+TEST(TlsfAllocator, FailsWhenNoBlockIsBigEnough) {
+    tlsf_allocator allocator(1024);
+
+    EXPECT_FALSE(allocator.allocate(1025).has_value());
+
+    const auto whole = allocator.allocate(1024);
+    ASSERT_TRUE(whole.has_value());
+    EXPECT_FALSE(allocator.allocate(1).has_value());
+
+    allocator.free(whole->block);
+    EXPECT_TRUE(allocator.allocate(1).has_value());
+}
+
+TEST(TlsfAllocator, FreeingMergesNeighbours) {
+    tlsf_allocator allocator(4096);
+
+    std::vector<tlsf_allocator::allocation> quarters;
+    for(uint32_t i = 0; i < 4; i++) {
+        const auto quarter = allocator.allocate(1024);
+        ASSERT_TRUE(quarter.has_value());
+        quarters.push_back(*quarter);
+    }
+    EXPECT_EQ(allocator.get_free_size(), 0U);
+
+    // Free them out of order so that blocks get merged on both sides
+    for(const uint32_t i : {1, 3, 0, 2}) {
+        allocator.free(quarters[i].block);
+    }
+    EXPECT_EQ(allocator.get_used_size(), 0U);
+
+    const auto whole = allocator.allocate(4096);
+    ASSERT_TRUE(whole.has_value());
+    EXPECT_EQ(whole->offset, 0U);
+}
+
+TEST(TlsfAllocator, RandomAllocationsNeverOverlap) {
+    constexpr uint64_t SIZE = 16 * 1024 * 1024;
+    tlsf_allocator allocator(SIZE, 16);
+
+    std::mt19937 rng(1234);
+    std::uniform_int_distribution<uint64_t> size_dist(1, 64 * 1024);
+
+    std::vector<tlsf_allocator::allocation> live;
+    uint64_t expected_used = 0;
+    for(uint32_t i = 0; i < 20000; i++) {
+        if(live.empty() || rng() % 3 != 0) {
+            const auto allocation = allocator.allocate(size_dist(rng));
+            if(allocation) {
+                live.push_back(*allocation);
+                expected_used += allocation->size;
+            }
+
+        } else {
+            const std::size_t victim = rng() % live.size();
+            allocator.free(live[victim].block);
+            expected_used -= live[victim].size;
+            live[victim] = live.back();
+            live.pop_back();
+        }
+
+        ASSERT_EQ(allocator.get_used_size(), expected_used);
+    }
+
+    expect_disjoint(live, SIZE);
+
+    for(const auto& allocation : live) {
+        allocator.free(allocation.block);
+    }
+    EXPECT_TRUE(allocator.allocate(SIZE).has_value());
+}
+
+TEST(TlsfAllocator, BlocksCanBeWalkedFromTheEnd) {
+    tlsf_allocator allocator(4096);
+
+    std::vector<tlsf_allocator::allocation> allocations;
+    for(uint32_t i = 0; i < 3; i++) {
+        const auto allocation = allocator.allocate(1024);
+        ASSERT_TRUE(allocation.has_value());
+        allocations.push_back(*allocation);
+    }
+    allocator.free(allocations[1].block);
+
+    // A free 1 KB block at the end, the third allocation, a free hole, then the first allocation
+    tlsf_allocator::block_index block = allocator.get_last_block();
+    EXPECT_TRUE(allocator.is_free(block));
+
+    block = allocator.get_previous_block(block);
+    EXPECT_EQ(block, allocations[2].block);
+    EXPECT_FALSE(allocator.is_free(block));
+
+    block = allocator.get_previous_block(block);
+    EXPECT_TRUE(allocator.is_free(block));
+    EXPECT_EQ(allocator.get_block_offset(block), 1024U);
+
+    block = allocator.get_previous_block(block);
+    EXPECT_EQ(block, allocations[0].block);
+    EXPECT_EQ(allocator.get_previous_block(block), tlsf_allocator::NO_BLOCK);
+
+    // Freeing the third allocation merges it with both free neighbours, which makes the merged block the last one
+    allocator.free(allocations[2].block);
+    EXPECT_EQ(allocator.get_block_size(allocator.get_last_block()), 3072U);
+    EXPECT_EQ(allocator.get_previous_block(allocator.get_last_block()), allocations[0].block);
+}
@@ -0,0 +1,80 @@
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "../../../src/tasks/task_scheduler.hpp"
+#undef TEST
+#include <gtest/gtest.h>
+
+using namespace nova::ttl;
+
+TEST(ConditionCounter, SubStopsAtZero) {
+    condition_counter counter(3);
+
+    counter.sub(5);
+    EXPECT_EQ(counter.get_value(), 0U);
+
+    counter.add(2);
+    counter.sub(1);
+    EXPECT_EQ(counter.get_value(), 1U);
+}
+
+TEST(ConditionCounter, WaitingForTheCurrentValueReturnsImmediately) {
+    condition_counter counter(7);
+
+    counter.wait_for_value(7);
+
+    EXPECT_EQ(counter.get_value(), 7U);
+}
+
+TEST(ConditionCounter, WaitersOnDifferentValuesAreWokenAtTheirValue) {
+    condition_counter counter(10);
+    std::atomic<uint32_t> num_woken = 0;
+
+    std::vector<std::thread> waiters;
+    for(uint32_t target = 0; target < 10; target += 3) {
+        waiters.emplace_back([&, target] {
+            counter.wait_for_value(target);
+            num_woken.fetch_add(1);
+        });
+    }
+
+    // Give the waiters time to go to sleep, so that they're woken by sub rather than seeing their value straight away
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    EXPECT_EQ(num_woken.load(), 0U);
+
+    for(uint32_t i = 0; i < 10; i++) {
+        counter.sub(1);
+    }
+
+    for(std::thread& waiter : waiters) {
+        waiter.join();
+    }
+
+    EXPECT_EQ(num_woken.load(), 4U);
+}
+
+TEST(ConditionCounter, ManyThreadsDecrementingWakeTheWaiter) {
+    constexpr uint32_t NUM_THREADS = 4;
+    constexpr uint32_t DECREMENTS_PER_THREAD = 10000;
+
+    condition_counter counter(NUM_THREADS * DECREMENTS_PER_THREAD);
+
+    std::vector<std::thread> threads;
+    for(uint32_t i = 0; i < NUM_THREADS; i++) {
+        threads.emplace_back([&] {
+            for(uint32_t j = 0; j < DECREMENTS_PER_THREAD; j++) {
+                counter.sub(1);
+            }
+        });
+    }
+
+    counter.wait_for_value(0);
+
+    for(std::thread& thread : threads) {
+        thread.join();
+    }
+
+    EXPECT_EQ(counter.get_value(), 0U);
+}
@@ -0,0 +1,131 @@
+#include <atomic>
+
+#include "../../src/general_test_setup.hpp"
+#include "../../../src/tasks/cpu_topology.hpp"
+#include "../../../src/tasks/task_scheduler.hpp"
+#undef TEST
+#include <gtest/gtest.h>
+
+#include "nova_renderer/util/platform.hpp"
+
+#ifdef NOVA_LINUX
+#include <sched.h>
+#endif
+
+using namespace nova::ttl;
+
+namespace {
+    /*!
+     * \brief Two packages, each with two cores that share a cache, each core with two SMT siblings. CPUs are numbered
+     * the way Linux usually numbers them, with the second sibling of every core after the first sibling of all of them
+     */
+    std::vector<logical_cpu> make_dual_socket_topology() {
+        std::vector<logical_cpu> cpus;
+        for(uint32_t id = 0; id < 8; id++) {
+            logical_cpu cpu;
+            cpu.id = id;
+            cpu.core_id = id % 2;
+            cpu.package_id = (id / 2) % 2;
+            cpu.llc_id = cpu.package_id * 2;
+            cpus.push_back(cpu);
+        }
+
+        return cpus;
+    }
+} // namespace
+
+TEST(CpuTopology, ParsesCpuLists) {
+    EXPECT_EQ(parse_cpu_list("0-3,8,10-11\n"), (std::vector<uint32_t>{0, 1, 2, 3, 8, 10, 11}));
+    EXPECT_EQ(parse_cpu_list("5"), (std::vector<uint32_t>{5}));
+    EXPECT_TRUE(parse_cpu_list("").empty());
+}
+
+TEST(CpuTopology, DistanceFollowsTheCacheHierarchy) {
+    const std::vector<logical_cpu> cpus = make_dual_socket_topology();
+
+    EXPECT_EQ(get_distance(cpus[0], cpus[0]), cpu_distance::SAME_CPU);
+    EXPECT_EQ(get_distance(cpus[0], cpus[4]), cpu_distance::SMT_SIBLING);
+    EXPECT_EQ(get_distance(cpus[0], cpus[1]), cpu_distance::SAME_LLC);
+    EXPECT_EQ(get_distance(cpus[0], cpus[2]), cpu_distance::REMOTE);
+}
+
+TEST(CpuTopology, WorkersGetTheirOwnCoreBeforeSharingOne) {
+    const std::vector<logical_cpu> placement = place_workers(make_dual_socket_topology(), 6);
+    ASSERT_EQ(placement.size(), 6U);
+
+    // The first four workers get a physical core each, with the cores on the same package next to each other
+    for(std::size_t i = 0; i < 4; i++) {
+        for(std::size_t j = 0; j < i; j++) {
+            EXPECT_NE(get_distance(placement[i], placement[j]), cpu_distance::SMT_SIBLING);
+        }
+    }
+    EXPECT_EQ(placement[0].package_id, placement[1].package_id);
+    EXPECT_EQ(placement[2].package_id, placement[3].package_id);
+    EXPECT_NE(placement[0].package_id, placement[2].package_id);
+
+    // Then they double up
+    EXPECT_EQ(get_distance(placement[4], placement[0]), cpu_distance::SMT_SIBLING);
+    EXPECT_EQ(get_distance(placement[5], placement[1]), cpu_distance::SMT_SIBLING);
+}
+
+TEST(CpuTopology, MoreWorkersThanCpusReuseCpus) {
+    const std::vector<logical_cpu> placement = place_workers(make_dual_socket_topology(), 10);
+    ASSERT_EQ(placement.size(), 10U);
+    EXPECT_EQ(placement[8].id, placement[0].id);
+    EXPECT_EQ(placement[9].id, placement[1].id);
+
+    EXPECT_TRUE(place_workers({}, 4).empty());
+}
+
+TEST(CpuTopology, WorkersOnlyGoOnAllowedCpus) {
+    const std::vector<logical_cpu> allowed = filter_cpus(make_dual_socket_topology(), {1, 5, 6});
+    ASSERT_EQ(allowed.size(), 3U);
+
+    const std::vector<logical_cpu> placement = place_workers(allowed, 4);
+    ASSERT_EQ(placement.size(), 4U);
+    for(const logical_cpu& cpu : placement) {
+        EXPECT_TRUE(cpu.id == 1 || cpu.id == 5 || cpu.id == 6) << "Worker placed on CPU " << cpu.id;
+    }
+}
+
+#ifdef NOVA_LINUX
+TEST(CpuTopology, TopologyOnlyHasCpusInTheAffinityMask) {
+    cpu_set_t original_mask;
+    ASSERT_EQ(sched_getaffinity(0, sizeof(original_mask), &original_mask), 0);
+
+    const std::vector<uint32_t> allowed_cpus = get_allowed_cpus();
+    ASSERT_FALSE(allowed_cpus.empty());
+
+    // Restrict this thread to the last CPU it may run on, like `taskset` would
+    const uint32_t only_cpu = allowed_cpus.back();
+    cpu_set_t restricted_mask;
+    CPU_ZERO(&restricted_mask);
+    CPU_SET(only_cpu, &restricted_mask);
+    ASSERT_EQ(sched_setaffinity(0, sizeof(restricted_mask), &restricted_mask), 0);
+
+    const std::vector<logical_cpu> cpus = read_cpu_topology();
+
+    sched_setaffinity(0, sizeof(original_mask), &original_mask);
+
+    EXPECT_EQ(get_allowed_cpus(), std::vector<uint32_t>{only_cpu});
+    ASSERT_EQ(cpus.size(), 1U);
+    EXPECT_EQ(cpus[0].id, only_cpu);
+}
+#endif
+
+TEST(CpuTopology, PinnedSchedulerRunsTasks) {
+    // The scheduler logs where it put each worker
+    TEST_SETUP_LOGGER();
+
+    std::atomic<uint32_t> num_runs = 0;
+    condition_counter counter;
+    task_scheduler scheduler(4, empty_queue_behavior::SLEEP, worker_placement::PIN_TO_CORES);
+
+    for(uint32_t i = 0; i < 1000; i++) {
+        scheduler.add_detached_task(&counter, [&num_runs](task_scheduler* /* scheduler */) { num_runs.fetch_add(1); });
+    }
+
+    counter.wait_for_value(0);
+
+    EXPECT_EQ(num_runs.load(), 1000U);
+}
@@ -0,0 +1,49 @@
+#include <vector>
+
+#include "../../../src/tasks/fiber.hpp"
+#undef TEST
+#include <gtest/gtest.h>
+
+using namespace nova::ttl;
+
+namespace {
+    struct ping_pong_state {
+        std::vector<uint32_t> events;
+        uint32_t num_ready_calls = 0;
+    };
+
+    void ping_pong_main(fiber* self) {
+        auto* state = static_cast<ping_pong_state*>(self->get_user_data());
+
+        for(uint32_t i = 0;; i++) {
+            EXPECT_EQ(fiber::get_current(), self);
+
+            state->events.push_back(i * 2 + 1);
+            self->yield();
+        }
+    }
+
+    void count_ready_calls(fiber* self) { static_cast<ping_pong_state*>(self->get_user_data())->num_ready_calls++; }
+} // namespace
+
+TEST(Fiber, ResumeAndYieldAlternate) {
+    ping_pong_state state;
+    fiber ping_pong(ping_pong_main, count_ready_calls, &state, 64 * 1024);
+
+    for(uint32_t i = 0; i < 3; i++) {
+        state.events.push_back(i * 2);
+        ping_pong.resume();
+        EXPECT_EQ(fiber::get_current(), nullptr);
+    }
+
+    EXPECT_EQ(state.events, (std::vector<uint32_t>{0, 1, 2, 3, 4, 5}));
+}
+
+TEST(Fiber, MakeReadyCallsTheReadyFunction) {
+    ping_pong_state state;
+    fiber ping_pong(ping_pong_main, count_ready_calls, &state, 64 * 1024);
+
+    ping_pong.make_ready();
+
+    EXPECT_EQ(state.num_ready_calls, 1U);
+}
@@ -0,0 +1,83 @@
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "../../../src/tasks/injection_queue.hpp"
+#undef TEST
+#include <gtest/gtest.h>
+
+using namespace nova::ttl;
+
+TEST(InjectionQueue, PopIsFirstInFirstOut) {
+    injection_queue<uint32_t> queue(128);
+    for(uint32_t i = 0; i < 100; i++) {
+        queue.push(i);
+    }
+
+    uint32_t value = 0;
+    for(uint32_t i = 0; i < 100; i++) {
+        ASSERT_TRUE(queue.pop(&value));
+        EXPECT_EQ(value, i);
+    }
+
+    EXPECT_FALSE(queue.pop(&value));
+}
+
+TEST(InjectionQueue, OverflowKeepsTheOrder) {
+    // Pushing five times as much as the ring holds sends most of it to the overflow
+    injection_queue<uint32_t> queue(16);
+    for(uint32_t i = 0; i < 80; i++) {
+        queue.push(i);
+    }
+    EXPECT_EQ(queue.approximate_count(), 80U);
+
+    uint32_t value = 0;
+    for(uint32_t i = 0; i < 80; i++) {
+        ASSERT_TRUE(queue.pop(&value));
+        EXPECT_EQ(value, i);
+    }
+
+    EXPECT_FALSE(queue.pop(&value));
+    EXPECT_EQ(queue.approximate_count(), 0U);
+}
+
+TEST(InjectionQueue, EveryElementIsTakenExactlyOnceUnderContention) {
+    constexpr uint32_t NUM_PRODUCERS = 3;
+    constexpr uint32_t NUM_CONSUMERS = 3;
+    constexpr uint32_t ELEMENTS_PER_PRODUCER = 50000;
+    constexpr uint32_t NUM_ELEMENTS = NUM_PRODUCERS * ELEMENTS_PER_PRODUCER;
+
+    // A small ring, so that producers regularly spill into the overflow
+    injection_queue<uint32_t> queue(64);
+    std::vector<std::atomic<uint32_t>> times_taken(NUM_ELEMENTS);
+    std::atomic<uint32_t> num_taken = 0;
+
+    std::vector<std::thread> threads;
+    for(uint32_t producer = 0; producer < NUM_PRODUCERS; producer++) {
+        threads.emplace_back([&, producer] {
+            for(uint32_t i = 0; i < ELEMENTS_PER_PRODUCER; i++) {
+                queue.push(producer * ELEMENTS_PER_PRODUCER + i);
+            }
+        });
+    }
+
+    for(uint32_t consumer = 0; consumer < NUM_CONSUMERS; consumer++) {
+        threads.emplace_back([&] {
+            uint32_t value = 0;
+            while(num_taken.load() < NUM_ELEMENTS) {
+                if(queue.pop(&value)) {
+                    times_taken[value].fetch_add(1);
+                    num_taken.fetch_add(1);
+                }
+            }
+        });
+    }
+
+    for(std::thread& thread : threads) {
+        thread.join();
+    }
+
+    for(uint32_t i = 0; i < NUM_ELEMENTS; i++) {
+        ASSERT_EQ(times_taken[i].load(), 1U) << "Element " << i;
+    }
+}
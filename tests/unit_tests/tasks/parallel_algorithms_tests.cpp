@@ -0,0 +1,112 @@
+#include <atomic>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "../../../src/tasks/parallel_algorithms.hpp"
+#undef TEST
+#include <gtest/gtest.h>
+
+using namespace nova::ttl;
+
+TEST(ParallelFor, VisitsEveryIndexOnce) {
+    task_scheduler scheduler(4, empty_queue_behavior::SLEEP);
+
+    std::vector<std::atomic<uint32_t>> visits(10007);
+    parallel_for(&scheduler, 0, visits.size(), [&](const std::size_t i) { visits[i].fetch_add(1); });
+
+    for(const auto& count : visits) {
+        EXPECT_EQ(count.load(), 1U);
+    }
+}
+
+TEST(ParallelFor, RespectsTheRangeAndGrainSize) {
+    task_scheduler scheduler(2, empty_queue_behavior::SLEEP);
+
+    std::vector<uint32_t> values(100, 0);
+    parallel_for(&scheduler, 10, 90, [&](const std::size_t i) { values[i] = 1; }, 7);
+
+    for(std::size_t i = 0; i < values.size(); i++) {
+        EXPECT_EQ(values[i], (i >= 10 && i < 90) ? 1U : 0U);
+    }
+}
+
+TEST(ParallelFor, NestedLoopsInsideTasksFinish) {
+    std::atomic<uint32_t> total = 0;
+    condition_counter counter;
+    task_scheduler scheduler(1, empty_queue_behavior::SLEEP);
+
+    scheduler.add_detached_task(&counter, [&total](task_scheduler* pool) {
+        parallel_for(pool, 0, 64, [&](std::size_t /* i */) {
+            parallel_for(pool, 0, 64, [&](std::size_t /* j */) { total.fetch_add(1); }, 4);
+        });
+    });
+
+    counter.wait_for_value(0);
+
+    EXPECT_EQ(total.load(), 64U * 64U);
+}
+
+TEST(ParallelFor, RethrowsExceptionsFromHelpers) {
+    task_scheduler scheduler(2, empty_queue_behavior::SLEEP);
+
+    std::atomic<bool> helper_started = false;
+    std::atomic<uint32_t> num_finished = 0;
+    const auto body = [&](std::size_t /* i */) {
+        if(scheduler.is_worker_thread()) {
+            helper_started = true;
+            throw std::runtime_error("Helper failed");
+        }
+
+        // Hold on to the calling thread's first chunk until a helper has taken one of the others
+        while(!helper_started) {
+            std::this_thread::yield();
+        }
+        num_finished++;
+    };
+
+    EXPECT_THROW(parallel_for(&scheduler, 0, 16, body, 1), std::runtime_error);
+    EXPECT_LT(num_finished.load(), 16U);
+
+    // The scheduler is still usable afterwards
+    std::atomic<uint32_t> total = 0;
+    parallel_for(&scheduler, 0, 100, [&](std::size_t /* i */) { total++; });
+    EXPECT_EQ(total.load(), 100U);
+}
+
+TEST(ParallelReduce, SumsARange) {
+    task_scheduler scheduler(4, empty_queue_behavior::SLEEP);
+
+    const uint64_t sum = parallel_reduce(
+        &scheduler,
+        0,
+        100001,
+        uint64_t{0},
+        [](const std::size_t begin, const std::size_t end, uint64_t partial) {
+            for(std::size_t i = begin; i < end; i++) {
+                partial += i;
+            }
+            return partial;
+        },
+        [](const uint64_t a, const uint64_t b) { return a + b; });
+
+    EXPECT_EQ(sum, uint64_t{100000} * 100001 / 2);
+}
+
+TEST(ParallelSort, SortsLikeStdSort) {
+    task_scheduler scheduler(4, empty_queue_behavior::SLEEP);
+
+    std::mt19937 rng(1234);
+    std::vector<uint32_t> values(50000);
+    for(uint32_t& value : values) {
+        value = static_cast<uint32_t>(rng());
+    }
+
+    std::vector<uint32_t> expected = values;
+    std::sort(expected.begin(), expected.end());
+
+    parallel_sort(&scheduler, values.begin(), values.end(), std::less<>(), 1000);
+
+    EXPECT_EQ(values, expected);
+}
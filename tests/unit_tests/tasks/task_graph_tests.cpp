@@ -0,0 +1,68 @@
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "../../../src/tasks/task_graph.hpp"
+#include "../../../src/tasks/task_scheduler.hpp"
+#undef TEST
+#include <gtest/gtest.h>
+
+using namespace nova::ttl;
+
+TEST(TaskGraph, NodesRunAfterTheirPredecessors) {
+    task_scheduler scheduler(4, empty_queue_behavior::SLEEP);
+
+    std::mutex order_mutex;
+    std::vector<uint32_t> order;
+    auto record = [&](const uint32_t id) {
+        return [&, id](task_scheduler* /* scheduler */) {
+            std::lock_guard l(order_mutex);
+            order.push_back(id);
+        };
+    };
+
+    // A diamond: 0 before 1 and 2, which are both before 3
+    task_graph graph;
+    const auto first = graph.add_node(record(0));
+    const auto left = graph.add_node(record(1));
+    const auto right = graph.add_node(record(2));
+    const auto last = graph.add_node(record(3));
+    graph.add_edge(first, left);
+    graph.add_edge(first, right);
+    graph.add_edge(left, last);
+    graph.add_edge(right, last);
+
+    for(uint32_t run = 0; run < 100; run++) {
+        order.clear();
+        graph.run(&scheduler);
+
+        ASSERT_EQ(order.size(), 4U);
+        EXPECT_EQ(order.front(), 0U);
+        EXPECT_EQ(order.back(), 3U);
+    }
+}
+
+TEST(TaskGraph, IndependentNodesAllRun) {
+    task_scheduler scheduler(4, empty_queue_behavior::SLEEP);
+
+    std::atomic<uint32_t> num_runs = 0;
+    task_graph graph;
+    for(uint32_t i = 0; i < 64; i++) {
+        graph.add_node([&num_runs](task_scheduler* /* scheduler */) { num_runs.fetch_add(1); });
+    }
+
+    graph.run(&scheduler);
+    graph.run(&scheduler);
+
+    EXPECT_EQ(num_runs.load(), 128U);
+}
+
+TEST(TaskGraph, CyclesAreRejected) {
+    task_graph graph;
+    const auto a = graph.add_node([](task_scheduler* /* scheduler */) {});
+    const auto b = graph.add_node([](task_scheduler* /* scheduler */) {});
+    graph.add_edge(a, b);
+    graph.add_edge(b, a);
+
+    EXPECT_THROW(graph.compile(), task_graph_cycle_exception);
+}
@@ -0,0 +1,333 @@
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../../../src/tasks/task_scheduler.hpp"
+#undef TEST
+#include <gtest/gtest.h>
+
+using namespace nova::ttl;
+
+TEST(TaskScheduler, DetachedTasksRun) {
+    std::atomic<uint32_t> num_runs = 0;
+    condition_counter counter;
+    task_scheduler scheduler(4, empty_queue_behavior::YIELD);
+
+    for(uint32_t i = 0; i < 10000; i++) {
+        scheduler.add_detached_task(&counter, [&num_runs](task_scheduler* /* scheduler */) { num_runs.fetch_add(1); });
+    }
+
+    counter.wait_for_value(0);
+
+    EXPECT_EQ(num_runs.load(), 10000U);
+}
+
+TEST(TaskScheduler, DetachedTaskArgumentsAreForwarded) {
+    uint32_t result = 0;
+    condition_counter counter;
+    task_scheduler scheduler(2, empty_queue_behavior::YIELD);
+
+    scheduler.add_detached_task(
+        &counter, [](task_scheduler* /* scheduler */, uint32_t& out, const uint32_t a, const uint32_t b) { out = a + b; }, std::ref(result), 4U, 5U);
+
+    counter.wait_for_value(0);
+
+    EXPECT_EQ(result, 9U);
+}
+
+TEST(TaskScheduler, FuturesStillWork) {
+    task_scheduler scheduler(2, empty_queue_behavior::YIELD);
+
+    std::future<uint32_t> future = scheduler.add_task([](task_scheduler* /* scheduler */, const uint32_t val) { return val * 2; }, 21U);
+
+    EXPECT_EQ(future.get(), 42U);
+}
+
+TEST(TaskRecordPool, ReusesRecordsFreedByOtherThreads) {
+    task_record_pool pool(2);
+
+    task_record* first = pool.allocate();
+    task_record* second = pool.allocate();
+
+    std::thread([&] {
+        task_record_pool::free(first, nullptr);
+        task_record_pool::free(second, nullptr);
+    }).join();
+
+    task_record* reused = pool.allocate();
+    EXPECT_TRUE(reused == first || reused == second);
+
+    task_record_pool::free(reused, &pool);
+}
+
+TEST(TaskScheduler, ExternalThreadsHaveTheirOwnIndex) {
+    task_scheduler scheduler(3, empty_queue_behavior::YIELD);
+
+    EXPECT_FALSE(scheduler.is_worker_thread());
+    EXPECT_EQ(scheduler.get_current_thread_idx(), scheduler.get_external_thread_idx());
+    EXPECT_EQ(scheduler.get_external_thread_idx(), 3U);
+
+    std::future<std::size_t> worker_idx = scheduler.add_task([](task_scheduler* pool) {
+        EXPECT_TRUE(pool->is_worker_thread());
+        return pool->get_current_thread_idx();
+    });
+
+    EXPECT_LT(worker_idx.get(), 3U);
+}
+
+TEST(TaskScheduler, SleepingWorkersWakeForNewTasks) {
+    std::atomic<uint32_t> num_runs = 0;
+    condition_counter counter;
+    task_scheduler scheduler(4, empty_queue_behavior::SLEEP);
+
+    for(uint32_t round = 0; round < 10; round++) {
+        // Give the workers time to run out of work and go to sleep
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+        for(uint32_t i = 0; i < 100; i++) {
+            scheduler.add_detached_task(&counter, [&num_runs](task_scheduler* /* scheduler */) { num_runs.fetch_add(1); });
+        }
+
+        counter.wait_for_value(0);
+    }
+
+    EXPECT_EQ(num_runs.load(), 1000U);
+}
+
+TEST(TaskScheduler, SleepingSchedulerShutsDown) {
+    auto scheduler = std::make_unique<task_scheduler>(4, empty_queue_behavior::SLEEP);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+    // Hangs if the destructor doesn't wake the sleeping workers
+    scheduler.reset();
+}
+
+TEST(TaskScheduler, WaitingInsideATaskDoesNotBlockTheWorker) {
+    std::atomic<uint32_t> num_runs = 0;
+    condition_counter counter;
+
+    // With a single worker, a parent task that blocked its thread while waiting for its children would never finish
+    task_scheduler scheduler(1, empty_queue_behavior::SLEEP);
+
+    for(uint32_t i = 0; i < 4; i++) {
+        scheduler.add_detached_task(&counter, [&num_runs](task_scheduler* pool) {
+            condition_counter children;
+            for(uint32_t j = 0; j < 16; j++) {
+                pool->add_detached_task(&children, [&num_runs](task_scheduler* /* scheduler */) { num_runs.fetch_add(1); });
+            }
+
+            children.wait_for_value(0);
+            num_runs.fetch_add(1);
+        });
+    }
+
+    counter.wait_for_value(0);
+
+    EXPECT_EQ(num_runs.load(), 4U * 17U);
+}
+
+TEST(TaskScheduler, HigherPriorityLanesRunFirst) {
+    std::mutex order_mutex;
+    std::vector<task_priority> order;
+    condition_counter counter;
+    task_scheduler scheduler(1, empty_queue_behavior::SLEEP);
+
+    // Queue everything from inside a task, so that the only worker can't start on any of it until we're done
+    scheduler.add_detached_task(&counter, [&](task_scheduler* pool) {
+        for(const task_priority priority : {task_priority::BACKGROUND, task_priority::NORMAL, task_priority::FRAME_CRITICAL}) {
+            pool->add_detached_task(priority, &counter, [&, priority](task_scheduler* /* scheduler */) {
+                std::lock_guard l(order_mutex);
+                order.push_back(priority);
+            });
+        }
+
+        EXPECT_EQ(pool->get_queue_depth(task_priority::FRAME_CRITICAL), 1U);
+        EXPECT_EQ(pool->get_queue_depth(task_priority::NORMAL), 1U);
+        EXPECT_EQ(pool->get_queue_depth(task_priority::BACKGROUND), 1U);
+    });
+
+    counter.wait_for_value(0);
+
+    EXPECT_EQ(order, (std::vector<task_priority>{task_priority::FRAME_CRITICAL, task_priority::NORMAL, task_priority::BACKGROUND}));
+}
+
+TEST(TaskScheduler, BackgroundTasksAreNotStarved) {
+    std::atomic<bool> background_ran = false;
+    std::atomic<uint32_t> num_critical_after_background = 0;
+    condition_counter counter;
+    task_scheduler scheduler(1, empty_queue_behavior::SLEEP);
+
+    scheduler.add_detached_task(&counter, [&](task_scheduler* pool) {
+        pool->add_detached_task(task_priority::BACKGROUND, &counter, [&](task_scheduler* /* scheduler */) { background_ran = true; });
+
+        for(std::size_t i = 0; i < task_scheduler::STARVATION_GUARD_INTERVAL * 4; i++) {
+            pool->add_detached_task(task_priority::FRAME_CRITICAL, &counter, [&](task_scheduler* /* scheduler */) {
+                if(background_ran) {
+                    num_critical_after_background.fetch_add(1);
+                }
+            });
+        }
+    });
+
+    counter.wait_for_value(0);
+
+    // The background task must have jumped the queue before all of the frame-critical tasks had run
+    EXPECT_GT(num_critical_after_background.load(), 0U);
+}
+
+TEST(TaskScheduler, WorkerStatsCountWhatTheWorkersDid) {
+    condition_counter counter;
+    task_scheduler scheduler(1, empty_queue_behavior::SLEEP);
+
+    // Let the worker sit idle for a bit
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+    scheduler.add_detached_task(&counter, [&](task_scheduler* pool) {
+        for(uint32_t i = 0; i < 50; i++) {
+            pool->add_detached_task(&counter, [](task_scheduler* /* scheduler */) {});
+        }
+    });
+
+    counter.wait_for_value(0);
+
+    const std::vector<worker_stats> stats = scheduler.get_worker_stats();
+    ASSERT_EQ(stats.size(), 1U);
+
+    EXPECT_EQ(stats[0].tasks_executed, 51U);
+    EXPECT_EQ(stats[0].external_pops, 1U);
+    EXPECT_EQ(stats[0].pops, 50U);
+    EXPECT_EQ(stats[0].max_queue_depth, 50U);
+
+    // There's nobody to steal from
+    EXPECT_EQ(stats[0].steal_attempts, 0U);
+    EXPECT_EQ(stats[0].steals, 0U);
+
+    EXPECT_GT(stats[0].busy_time.count(), 0);
+    EXPECT_GT(stats[0].idle_time.count(), 0);
+}
+
+TEST(TaskScheduler, SeveralOutsideThreadsCanSubmitAtOnce) {
+    constexpr uint32_t NUM_SUBMITTERS = 4;
+    constexpr uint32_t TASKS_PER_SUBMITTER = 5000;
+
+    std::atomic<uint32_t> num_runs = 0;
+    condition_counter counter;
+    task_scheduler scheduler(2, empty_queue_behavior::SLEEP);
+
+    std::vector<std::thread> submitters;
+    for(uint32_t i = 0; i < NUM_SUBMITTERS; i++) {
+        submitters.emplace_back([&] {
+            for(uint32_t j = 0; j < TASKS_PER_SUBMITTER; j++) {
+                scheduler.add_detached_task(&counter, [&num_runs](task_scheduler* /* scheduler */) { num_runs.fetch_add(1); });
+            }
+        });
+    }
+
+    for(std::thread& submitter : submitters) {
+        submitter.join();
+    }
+
+    counter.wait_for_value(0);
+
+    EXPECT_EQ(num_runs.load(), NUM_SUBMITTERS * TASKS_PER_SUBMITTER);
+}
+
+TEST(TaskScheduler, BatchedIndexTasksRunEveryIndexOnce) {
+    constexpr std::size_t NUM_INDICES = 16384;
+
+    std::vector<std::atomic<uint32_t>> times_run(NUM_INDICES);
+    condition_counter counter;
+    task_scheduler scheduler(4, empty_queue_behavior::SLEEP);
+
+    scheduler.add_detached_tasks(&counter, 0, NUM_INDICES, [&times_run](task_scheduler* /* scheduler */, const std::size_t i) {
+        times_run[i].fetch_add(1);
+    });
+
+    counter.wait_for_value(0);
+
+    for(std::size_t i = 0; i < NUM_INDICES; i++) {
+        ASSERT_EQ(times_run[i].load(), 1U) << "Index " << i;
+    }
+}
+
+TEST(TaskScheduler, BatchedIndexTasksCanBeSubmittedFromATask) {
+    std::atomic<std::size_t> sum = 0;
+    condition_counter counter;
+    task_scheduler scheduler(2, empty_queue_behavior::SLEEP);
+
+    scheduler.add_detached_task(&counter, [&](task_scheduler* pool) {
+        condition_counter children;
+        pool->add_detached_tasks(task_priority::FRAME_CRITICAL, &children, 10, 110, [&sum](task_scheduler* /* scheduler */, const std::size_t i) {
+            sum.fetch_add(i);
+        });
+
+        children.wait_for_value(0);
+    });
+
+    counter.wait_for_value(0);
+
+    // 10 + 11 + ... + 109
+    EXPECT_EQ(sum.load(), 5950U);
+}
+
+TEST(TaskScheduler, BatchedCallablesAllRun) {
+    std::atomic<uint32_t> num_runs = 0;
+    condition_counter counter;
+    task_scheduler scheduler(4, empty_queue_behavior::SLEEP);
+
+    std::vector<std::function<void(task_scheduler*)>> tasks(100, [&num_runs](task_scheduler* /* scheduler */) { num_runs.fetch_add(1); });
+    scheduler.add_detached_tasks(&counter, tasks.begin(), tasks.end());
+
+    counter.wait_for_value(0);
+
+    EXPECT_EQ(num_runs.load(), 100U);
+}
+
+TEST(TaskScheduler, WaitUntilRunsOtherTasksInTheMeantime) {
+    std::atomic<bool> flag = false;
+    std::atomic<bool> waiter_finished = false;
+    condition_counter counter;
+
+    // The task that sets the flag is queued behind the task waiting for it, so with a single worker this would
+    // deadlock if waiting blocked the thread
+    task_scheduler scheduler(1, empty_queue_behavior::SLEEP);
+
+    scheduler.add_detached_task(&counter, [&](task_scheduler* pool) {
+        pool->add_detached_task([&](task_scheduler* /* scheduler */) { flag = true; });
+
+        pool->wait_until([&] { return flag.load(); });
+        waiter_finished = true;
+    });
+
+    counter.wait_for_value(0);
+
+    EXPECT_TRUE(waiter_finished.load());
+}
+
+TEST(TaskScheduler, YieldedTasksAreNotStarved) {
+    std::atomic<bool> stop = false;
+    std::atomic<uint32_t> num_polls = 0;
+    condition_counter counter;
+    task_scheduler scheduler(1, empty_queue_behavior::SLEEP);
+
+    scheduler.add_detached_task(&counter, [&](task_scheduler* pool) {
+        // Keeps the worker busy with a task that requeues itself until the poller has had a few goes
+        std::function<void(task_scheduler*)> busywork = [&](task_scheduler* inner_pool) {
+            if(!stop.load()) {
+                inner_pool->add_detached_task(&counter, busywork);
+            }
+        };
+        pool->add_detached_task(&counter, busywork);
+
+        pool->wait_until([&] { return num_polls.fetch_add(1) >= 10; });
+        stop = true;
+    });
+
+    counter.wait_for_value(0);
+
+    EXPECT_GE(num_polls.load(), 10U);
+}
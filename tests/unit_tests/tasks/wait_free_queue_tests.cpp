@@ -0,0 +1,102 @@
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "../../../src/tasks/wait_free_queue.hpp"
+#undef TEST
+#include <gtest/gtest.h>
+
+using namespace nova::ttl;
+
+TEST(WaitFreeQueue, PopIsLastInFirstOut) {
+    wait_free_queue<uint32_t> queue;
+    for(uint32_t i = 0; i < 100; i++) {
+        queue.push(i);
+    }
+
+    uint32_t value = 0;
+    for(uint32_t i = 100; i > 0; i--) {
+        ASSERT_TRUE(queue.pop(&value));
+        EXPECT_EQ(value, i - 1);
+    }
+
+    EXPECT_FALSE(queue.pop(&value));
+}
+
+TEST(WaitFreeQueue, StealIsFirstInFirstOut) {
+    wait_free_queue<uint32_t> queue;
+    for(uint32_t i = 0; i < 100; i++) {
+        queue.push(i);
+    }
+
+    uint32_t value = 0;
+    for(uint32_t i = 0; i < 100; i++) {
+        ASSERT_TRUE(queue.steal(&value));
+        EXPECT_EQ(value, i);
+    }
+
+    EXPECT_FALSE(queue.steal(&value));
+}
+
+TEST(WaitFreeQueue, ShrinksAfterABurst) {
+    wait_free_queue<uint32_t> queue;
+    for(uint32_t i = 0; i < 1000; i++) {
+        queue.push(i);
+    }
+    EXPECT_GE(queue.size(), 1000U);
+
+    uint32_t value = 0;
+    while(queue.pop(&value)) {
+    }
+
+    queue.shrink();
+    EXPECT_EQ(queue.size(), wait_free_queue<uint32_t>::INITIAL_CAPACITY);
+}
+
+TEST(WaitFreeQueue, EveryElementIsTakenExactlyOnceUnderContention) {
+    constexpr uint32_t NUM_THIEVES = 3;
+    constexpr uint32_t NUM_BURSTS = 50;
+    constexpr uint32_t BURST_SIZE = 2000;
+    constexpr uint32_t NUM_ELEMENTS = NUM_BURSTS * BURST_SIZE;
+
+    wait_free_queue<uint32_t> queue;
+    std::vector<std::atomic<uint32_t>> times_taken(NUM_ELEMENTS);
+    std::atomic<bool> done = false;
+
+    std::vector<std::thread> thieves;
+    for(uint32_t i = 0; i < NUM_THIEVES; i++) {
+        thieves.emplace_back([&] {
+            uint32_t value = 0;
+            while(!done.load()) {
+                if(queue.steal(&value)) {
+                    times_taken[value].fetch_add(1);
+                }
+            }
+        });
+    }
+
+    // Bursts make the queue grow while thieves are reading it, then popping it empty and shrinking retires the big
+    // array again
+    uint32_t next_value = 0;
+    for(uint32_t burst = 0; burst < NUM_BURSTS; burst++) {
+        for(uint32_t i = 0; i < BURST_SIZE; i++) {
+            queue.push(next_value++);
+        }
+
+        uint32_t value = 0;
+        while(queue.pop(&value)) {
+            times_taken[value].fetch_add(1);
+        }
+
+        queue.shrink();
+    }
+
+    done = true;
+    for(std::thread& thief : thieves) {
+        thief.join();
+    }
+
+    for(uint32_t i = 0; i < NUM_ELEMENTS; i++) {
+        ASSERT_EQ(times_taken[i].load(), 1U) << "Element " << i;
+    }
+}